@@ -0,0 +1,405 @@
+#include "binaryrecording.h"
+#include "recordingcodec.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+BinaryRecordingSource::~BinaryRecordingSource()
+{
+    close();
+}
+
+bool BinaryRecordingSource::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open file for reading:" << m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_data = m_size >= qint64(sizeof(RecordingHeader)) ? m_file.map(0, m_size) : nullptr;
+    if (!m_data)
+    {
+        qWarning() << "Unable to map" << fileName;
+        close();
+        return false;
+    }
+
+    memcpy(&m_header, m_data, sizeof(m_header));
+    if (memcmp(m_header.magic, RECORDING_MAGIC, sizeof(m_header.magic)) != 0
+        || m_header.version < RECORDING_VERSION_MIN || m_header.version > RECORDING_VERSION)
+    {
+        qWarning() << "Not a recording file:" << fileName;
+        close();
+        return false;
+    }
+    m_chunkHeaderSize = chunkHeaderSize(m_header.version);
+
+    // Closed recording: the footer points at the chunk index
+    if (m_size >= qint64(sizeof(RecordingHeader) + sizeof(RecordingFooter)))
+    {
+        RecordingFooter footer;
+        memcpy(&footer, m_data + m_size - sizeof(footer), sizeof(footer));
+        const quint64 indexEnd = footer.indexOffset + quint64(footer.chunkCount) * sizeof(IndexEntry);
+        if (footer.magic == FOOTER_MAGIC && footer.indexOffset >= sizeof(RecordingHeader)
+            && footer.indexOffset % sizeof(double) == 0 && indexEnd == quint64(m_size) - sizeof(footer))
+        {
+            if (indexValid(footer))
+            {
+                m_entries = reinterpret_cast<const IndexEntry*>(m_data + footer.indexOffset);
+                m_chunkCount = footer.chunkCount;
+                m_rowCount = footer.rowCount;
+                return true;
+            }
+            qWarning() << "Chunk index of" << fileName << "does not match its chunks, reading the chunks instead";
+        }
+    }
+
+    // Recording still open or cut short
+    m_recovered = walkChunks();
+    if (m_recovered)
+    {
+        qWarning() << "Recording" << fileName << "has no footer, recovered" << m_rowCount << "rows";
+    }
+    return true;
+}
+
+bool BinaryRecordingSource::chunkSizeValid(const ChunkHeader &chunk) const
+{
+    const quint32 channels = m_header.channelCount;
+    return chunk.encoding == CHUNK_RAW ? chunk.payloadSize == chunkPayloadSize(channels, chunk.rowCount)
+           : chunk.encoding == CHUNK_COMPRESSED && chunk.payloadSize >= chunkSummarySize(channels)
+                 && chunk.payloadSize % sizeof(double) == 0;
+}
+
+bool BinaryRecordingSource::indexValid(const RecordingFooter &footer) const
+{
+    // Every entry points at a chunk header that agrees with it, in file order, all before the index
+    if (footer.dataEnd < sizeof(RecordingHeader) || footer.dataEnd > footer.indexOffset)
+    {
+        return false;
+    }
+    const IndexEntry *entries = reinterpret_cast<const IndexEntry*>(m_data + footer.indexOffset);
+    quint64 end = sizeof(RecordingHeader);
+    quint64 rowCount = 0;
+    for (quint32 i = 0; i < footer.chunkCount; ++i)
+    {
+        const IndexEntry &entry = entries[i];
+        if (entry.offset < end || entry.offset % sizeof(double) != 0 || entry.offset > footer.dataEnd - m_chunkHeaderSize)
+        {
+            return false;
+        }
+        ChunkHeader chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        memcpy(&chunk, m_data + entry.offset, m_chunkHeaderSize);
+        end = entry.offset + m_chunkHeaderSize + chunk.payloadSize;
+        if (chunk.magic != CHUNK_MAGIC || chunk.rowCount != entry.rowCount || !chunkSizeValid(chunk) || end > footer.dataEnd)
+        {
+            return false;
+        }
+        rowCount += entry.rowCount;
+    }
+    return rowCount == footer.rowCount;
+}
+
+bool BinaryRecordingSource::walkChunks(void)
+{
+    quint64 offset = sizeof(RecordingHeader);
+    bool footerFound = false;
+
+    // Follow the chunk headers, stop at the footer or at the first incomplete or damaged chunk
+    while (offset + m_chunkHeaderSize <= quint64(m_size))
+    {
+        ChunkHeader chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        memcpy(&chunk, m_data + offset, m_chunkHeaderSize);
+        if (chunk.magic == FOOTER_MAGIC)
+        {
+            footerFound = true;
+            break;
+        }
+        if (chunk.magic != CHUNK_MAGIC || !chunkSizeValid(chunk) || offset + m_chunkHeaderSize + chunk.payloadSize > quint64(m_size))
+        {
+            break;
+        }
+        if (m_header.version >= 3 && recordingCrc32(m_data + offset + m_chunkHeaderSize, chunk.payloadSize) != chunk.checksum)
+        {
+            qWarning() << "Checksum mismatch in chunk" << m_walked.size() << "of" << m_file.fileName();
+            break;
+        }
+
+        m_walked.append({offset, chunk.rowCount, 0});
+        m_rowCount += chunk.rowCount;
+        offset += m_chunkHeaderSize + chunk.payloadSize;
+    }
+
+    m_entries = m_walked.constData();
+    m_chunkCount = m_walked.size();
+    return !footerFound;
+}
+
+void BinaryRecordingSource::close(void)
+{
+    if (m_data)
+    {
+        m_file.unmap(const_cast<uchar*>(m_data));
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_entries = nullptr;
+    m_walked.clear();
+    m_chunkCount = 0;
+    m_rowCount = 0;
+    m_recovered = false;
+}
+
+quint64 BinaryRecordingSource::dataEnd(void) const
+{
+    if (m_chunkCount == 0)
+    {
+        return sizeof(RecordingHeader);
+    }
+    const qint32 last = m_chunkCount - 1;
+    return chunkOffset(last) + m_chunkHeaderSize + chunkHeader(last).payloadSize;
+}
+
+const ChunkSummary &BinaryRecordingSource::chunkSummary(qint32 chunk) const
+{
+    return *reinterpret_cast<const ChunkSummary*>(chunkData(chunk));
+}
+
+const double *BinaryRecordingSource::chunkMinimum(qint32 chunk) const
+{
+    return reinterpret_cast<const double*>(chunkData(chunk) + sizeof(ChunkSummary));
+}
+
+const double *BinaryRecordingSource::chunkMaximum(qint32 chunk) const
+{
+    return chunkMinimum(chunk) + m_header.channelCount;
+}
+
+const double *BinaryRecordingSource::times(qint32 chunk) const
+{
+    return isCompressed(chunk) ? nullptr : chunkMaximum(chunk) + m_header.channelCount;
+}
+
+const double *BinaryRecordingSource::values(qint32 chunk, quint32 channel) const
+{
+    return isCompressed(chunk) ? nullptr : times(chunk) + quint64(channel + 1) * chunkRows(chunk);
+}
+
+bool BinaryRecordingSource::readChunk(qint32 chunk, RowBlock &rows, qint64 first) const
+{
+    const quint32 count = chunkRows(chunk);
+    const quint32 channels = m_header.channelCount;
+
+    // The columns must hold the whole chunk from first
+    bool fits = first >= 0 && first + count <= rows.times.size() && quint32(rows.channels.size()) >= channels;
+    for (quint32 c = 0; fits && c < channels; ++c)
+    {
+        fits = first + count <= rows.channels[c].size();
+    }
+    if (!fits)
+    {
+        qWarning() << "Chunk" << chunk << "of" << fileName() << "does not fit the rows read";
+        return false;
+    }
+
+    if (!isCompressed(chunk))
+    {
+        std::copy(times(chunk), times(chunk) + count, rows.times.begin() + first);
+        for (quint32 c = 0; c < channels; ++c)
+        {
+            std::copy(values(chunk, c), values(chunk, c) + count, rows.channels[c].begin() + first);
+        }
+        return true;
+    }
+
+    // Encoded columns follow the summary: times, then every channel
+    const char *column = reinterpret_cast<const char*>(chunkData(chunk)) + chunkSummarySize(channels);
+    qint64 left = chunkHeader(chunk).payloadSize - chunkSummarySize(channels);
+    for (quint32 c = 0; c <= channels; ++c)
+    {
+        double *out = (c == 0 ? rows.times.data() : rows.channels[c - 1].data()) + first;
+        qint64 used = decodeColumn(column, left, count, out);
+        if (used == 0)
+        {
+            qWarning() << "Corrupt chunk" << chunk << "in" << fileName();
+            return false;
+        }
+        column += used;
+        left -= used;
+    }
+    return true;
+}
+
+qint32 BinaryRecordingSource::chunkAt(double time) const
+{
+    // Chunks are in time order, only the summaries of the probed chunks are touched
+    qint32 first = 0;
+    qint32 last = m_chunkCount;
+    while (first < last)
+    {
+        qint32 middle = (first + last) / 2;
+        if (chunkSummary(middle).end < time)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+bool BinaryRecordingSource::buildIndex(RecordingIndex &index, const std::atomic_bool &cancel) const
+{
+    // One block per chunk, straight from the chunk summaries
+    const quint32 averageRows = m_chunkCount > 0 ? quint32((m_rowCount + m_chunkCount - 1) / m_chunkCount) : RecordingIndex::DEFAULT_ROWS_PER_BLOCK;
+    index.reset(m_header.channelCount, qMax<quint32>(1, averageRows));
+
+    for (qint32 chunk = 0; chunk < m_chunkCount; ++chunk)
+    {
+        if (cancel)
+        {
+            return false;
+        }
+        const ChunkSummary &summary = chunkSummary(chunk);
+        index.appendBlock(chunk, chunkRows(chunk), summary.start, summary.end, chunkMinimum(chunk), chunkMaximum(chunk));
+    }
+
+    index.buildPyramid();
+    return true;
+}
+
+bool BinaryRecordingSource::readBlock(const RecordingIndex &index, qint32 block, RowBlock &rows) const
+{
+    const qint32 chunk = qint32(index.blockOffsets[block]);
+    if (chunk < 0 || chunk >= m_chunkCount)
+    {
+        return false;
+    }
+
+    const quint32 count = chunkRows(chunk);
+    rows.clear(m_header.channelCount);
+    rows.times.resize(count);
+    for (quint32 c = 0; c < m_header.channelCount; ++c)
+    {
+        rows.channels[c].resize(count);
+    }
+    return readChunk(chunk, rows, 0);
+}
+
+bool readRecordingFile(const QString &fileName, RecordingHeader &header, RowBlock &rows, bool *recovered)
+{
+    const std::atomic_bool cancel(false);
+    return readRecordingFile(fileName, header, rows, cancel, nullptr, recovered);
+}
+
+bool readRecordingFile(const QString &fileName, RecordingHeader &header, RowBlock &rows, const std::atomic_bool &cancel,
+                       const std::function<void(int)> &progress, bool *recovered)
+{
+    BinaryRecordingSource source;
+    if (!source.open(fileName))
+    {
+        return false;
+    }
+
+    header = source.header();
+    const quint32 channels = header.channelCount;
+    rows.clear(channels);
+    rows.times.resize(source.rowCount());
+    for (quint32 c = 0; c < channels; ++c)
+    {
+        rows.channels[c].resize(source.rowCount());
+    }
+
+    // One copy (or decode) from the mapping into the columns
+    qint64 first = 0;
+    qint32 reported = -1;
+    for (qint32 chunk = 0; chunk < source.chunkCount(); ++chunk)
+    {
+        if (cancel || !source.readChunk(chunk, rows, first))
+        {
+            return false;
+        }
+        first += source.chunkRows(chunk);
+
+        const qint32 percent = qint32(first * 100 / qMax<qint64>(1, source.rowCount()));
+        if (progress && percent != reported)
+        {
+            progress(percent);
+            reported = percent;
+        }
+    }
+
+    if (recovered)
+    {
+        *recovered = source.isRecovered();
+    }
+    return true;
+}
+
+bool repairRecordingFile(const QString &fileName)
+{
+    RecordingHeader header;
+    QVector<IndexEntry> index;
+    RecordingFooter footer;
+    {
+        BinaryRecordingSource source;
+        if (!source.open(fileName))
+        {
+            return false;
+        }
+        if (!source.isRecovered())
+        {
+            return true;
+        }
+
+        header = source.header();
+        for (qint32 chunk = 0; chunk < source.chunkCount(); ++chunk)
+        {
+            index.append({source.chunkOffset(chunk), source.chunkRows(chunk), 0});
+        }
+
+        // Sample rate the writer would have measured on close
+        if (header.sampleRate <= 0 && source.rowCount() > 1)
+        {
+            const double span = source.chunkSummary(source.chunkCount() - 1).end - source.chunkSummary(0).start;
+            header.sampleRate = span > 0 ? (source.rowCount() - 1) / span : 0;
+        }
+
+        footer.magic = FOOTER_MAGIC;
+        footer.chunkCount = index.size();
+        footer.rowCount = source.rowCount();
+        footer.dataEnd = source.dataEnd();
+        footer.indexOffset = footer.dataEnd;
+    }
+
+    // The mapping is released before the file is written
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadWrite))
+    {
+        qWarning() << "Unable to open file for writing:" << file.errorString();
+        return false;
+    }
+    const qint64 indexSize = index.size() * sizeof(IndexEntry);
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+              && file.seek(footer.indexOffset)
+              && file.write(reinterpret_cast<const char*>(index.constData()), indexSize) == indexSize
+              && file.write(reinterpret_cast<const char*>(&footer), sizeof(footer)) == sizeof(footer)
+              && file.resize(footer.indexOffset + indexSize + sizeof(footer));
+    if (!ok)
+    {
+        qWarning() << "Unable to repair" << fileName << ":" << file.errorString();
+        return false;
+    }
+    qInfo() << "Recording" << fileName << "closed with" << footer.rowCount << "rows";
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef BINARYRECORDING_H
+#define BINARYRECORDING_H
+
+#include <QFile>
+#include <QVector>
+#include <functional>
+#include "recording.h"
+#include "recordingformat.h"
+
+/**
+ * @brief Recording stored in the native .armb format, read through a memory mapping.
+ *
+ * open() maps the file and, for a closed recording, only reads the header, the
+ * footer, the chunk index and the chunk headers it points at, which must all
+ * agree or the chunks are walked as for a recording cut short. For raw
+ * chunks the sample accessors return pointers into the mapping and never
+ * copy; compressed chunks are decoded by readChunk(). The mapping is
+ * read-only, so it is shared by all threads.
+ */
+class BinaryRecordingSource : public RecordingSource
+{
+public:
+    ~BinaryRecordingSource();
+
+    // Maps fileName, returns false if it is not a recording
+    bool open(const QString &fileName);
+    void close(void);
+
+    QString fileName(void) const override { return m_file.fileName(); }
+    quint32 channelCount(void) const override { return m_header.channelCount; }
+    const RecordingHeader &header(void) const { return m_header; }
+    qint64 rowCount(void) const { return m_rowCount; }
+    // True if the file had no chunk index and was opened by walking its chunks
+    bool isRecovered(void) const { return m_recovered; }
+    // End of the last chunk, where the index of a closed recording starts
+    quint64 dataEnd(void) const;
+
+    qint32 chunkCount(void) const { return m_chunkCount; }
+    quint32 chunkRows(qint32 chunk) const { return m_entries[chunk].rowCount; }
+    quint64 chunkOffset(qint32 chunk) const { return m_entries[chunk].offset; }
+    const ChunkSummary &chunkSummary(qint32 chunk) const;
+    // channelCount values each
+    const double *chunkMinimum(qint32 chunk) const;
+    const double *chunkMaximum(qint32 chunk) const;
+    bool isCompressed(qint32 chunk) const { return chunkHeader(chunk).encoding == CHUNK_COMPRESSED; }
+    // Samples in place, nullptr for compressed chunks
+    const double *times(qint32 chunk) const;
+    const double *values(qint32 chunk, quint32 channel) const;
+    // Copies or decodes a chunk into rows, which already hold room for it from row first
+    bool readChunk(qint32 chunk, RowBlock &rows, qint64 first) const;
+
+    // First chunk that ends at or after time
+    qint32 chunkAt(double time) const;
+
+    bool buildIndex(RecordingIndex &index, const std::atomic_bool &cancel) const override;
+    bool readBlock(const RecordingIndex &index, qint32 block, RowBlock &rows) const override;
+
+private:
+    bool chunkSizeValid(const ChunkHeader &chunk) const;
+    bool indexValid(const RecordingFooter &footer) const;
+    bool walkChunks(void);
+    const ChunkHeader &chunkHeader(qint32 chunk) const { return *reinterpret_cast<const ChunkHeader*>(m_data + m_entries[chunk].offset); }
+    const uchar *chunkData(qint32 chunk) const { return m_data + m_entries[chunk].offset + m_chunkHeaderSize; }
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    RecordingHeader m_header;
+    quint64 m_chunkHeaderSize = sizeof(ChunkHeader); // Depends on the file version
+    const IndexEntry *m_entries = nullptr; // Index in the mapping, or m_walked
+    QVector<IndexEntry> m_walked;
+    qint32 m_chunkCount = 0;
+    qint64 m_rowCount = 0;
+    bool m_recovered = false;
+};
+
+/**
+ * @brief Reads a whole recording file into rows.
+ *
+ * @param recovered Set to true if the file had no chunk index and was recovered from its chunks.
+ * @return false if the file cannot be opened or has no valid header.
+ */
+bool readRecordingFile(const QString &fileName, RecordingHeader &header, RowBlock &rows, bool *recovered = nullptr);
+
+/**
+ * @brief Reads a whole recording file into rows, chunk by chunk until cancel is set.
+ *
+ * @param progress Called on the calling thread with the percentage of rows read.
+ * @return false if the file cannot be opened, has no valid header or cancel is set.
+ */
+bool readRecordingFile(const QString &fileName, RecordingHeader &header, RowBlock &rows, const std::atomic_bool &cancel,
+                       const std::function<void(int)> &progress = nullptr, bool *recovered = nullptr);
+
+/**
+ * @brief Closes a recording that was cut short.
+ *
+ * Drops whatever follows the last complete chunk and appends the chunk index
+ * and footer, as RecordingWriter::close() would have. Does nothing to a
+ * recording that is already closed.
+ *
+ * @return false if the file is not a recording or cannot be written.
+ */
+bool repairRecordingFile(const QString &fileName);
+
+#endif // BINARYRECORDING_H
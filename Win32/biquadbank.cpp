@@ -0,0 +1,392 @@
+#include "biquadbank.h"
+#include <QtMath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BIQUAD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BIQUAD_SSE2
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define BIQUAD_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit AVX in functions that ask for it, MSVC always can
+#if defined(BIQUAD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+static const quint32 LANE_ALIGN = 4; // Doubles in the widest vector (AVX)
+static const qint32 TILE_ROWS = 256; // Rows interleaved at a time, the tile stays in L1/L2 up to 128 channels
+
+BiquadCoefficients BiquadCoefficients::lowPass(double sampleRate, double frequency, double q)
+{
+    const double w0 = 2 * M_PI * frequency / sampleRate;
+    const double alpha = qSin(w0) / (2 * q);
+    const double cosW0 = qCos(w0);
+    const double a0 = 1 + alpha;
+
+    BiquadCoefficients k;
+    k.b0 = (1 - cosW0) / 2 / a0;
+    k.b1 = (1 - cosW0) / a0;
+    k.b2 = k.b0;
+    k.a1 = -2 * cosW0 / a0;
+    k.a2 = (1 - alpha) / a0;
+    return k;
+}
+
+BiquadCoefficients BiquadCoefficients::highPass(double sampleRate, double frequency, double q)
+{
+    const double w0 = 2 * M_PI * frequency / sampleRate;
+    const double alpha = qSin(w0) / (2 * q);
+    const double cosW0 = qCos(w0);
+    const double a0 = 1 + alpha;
+
+    BiquadCoefficients k;
+    k.b0 = (1 + cosW0) / 2 / a0;
+    k.b1 = -(1 + cosW0) / a0;
+    k.b2 = k.b0;
+    k.a1 = -2 * cosW0 / a0;
+    k.a2 = (1 - alpha) / a0;
+    return k;
+}
+
+BiquadCoefficients BiquadCoefficients::notch(double sampleRate, double frequency, double q)
+{
+    const double w0 = 2 * M_PI * frequency / sampleRate;
+    const double alpha = qSin(w0) / (2 * q);
+    const double cosW0 = qCos(w0);
+    const double a0 = 1 + alpha;
+
+    BiquadCoefficients k;
+    k.b0 = 1 / a0;
+    k.b1 = -2 * cosW0 / a0;
+    k.b2 = k.b0;
+    k.a1 = k.b1;
+    k.a2 = (1 - alpha) / a0;
+    return k;
+}
+
+BiquadCoefficients BiquadCoefficients::firstOrderHighPass(double sampleRate, double frequency)
+{
+    // y[n] = g (x[n] - x[n-1]) + r y[n-1], unity gain at Nyquist
+    const double r = qExp(-2 * M_PI * frequency / sampleRate);
+    const double g = (1 + r) / 2;
+
+    BiquadCoefficients k;
+    k.b0 = g;
+    k.b1 = -g;
+    k.b2 = 0;
+    k.a1 = -r;
+    k.a2 = 0;
+    return k;
+}
+
+/*
+ * Kernels: run sections over rows interleaved rows of lanes values. Per
+ * sample, in this order:
+ *   y  = b0 x + z1
+ *   z1 = (b1 x - a1 y) + z2
+ *   z2 = b2 x - a2 y
+ * and the state only moves where x is not NaN. The vector kernels keep the
+ * delay elements of one vector of lanes in registers over the whole tile and
+ * run all sections on a row before the next, so the out-of-order core
+ * overlaps the sections of consecutive rows instead of waiting on the
+ * recursion of a single section.
+ */
+typedef void (*KernelFunction)(const BiquadCoefficients *sections, qint32 sectionCount, double *state,
+                               double *tile, qint32 rows, quint32 lanes);
+
+static const qint32 KERNEL_SECTIONS = 8; // Most sections per kernel call, longer cascades take several passes
+
+static void runScalar(const BiquadCoefficients *sections, qint32 sectionCount, double *state,
+                      double *tile, qint32 rows, quint32 lanes)
+{
+    for (qint32 s = 0; s < sectionCount; ++s)
+    {
+        const BiquadCoefficients &k = sections[s];
+        double *z = state + 2 * s * lanes;
+        for (quint32 lane = 0; lane < lanes; ++lane)
+        {
+            double z1 = z[lane];
+            double z2 = z[lanes + lane];
+            for (double *x = tile + lane, *end = x + qint64(rows) * lanes; x != end; x += lanes)
+            {
+                if (qIsNaN(*x))
+                    continue;
+                const double y = k.b0 * *x + z1;
+                z1 = (k.b1 * *x - k.a1 * y) + z2;
+                z2 = k.b2 * *x - k.a2 * y;
+                *x = y;
+            }
+            z[lane] = z1;
+            z[lanes + lane] = z2;
+        }
+    }
+}
+
+#ifdef BIQUAD_SSE2
+static void runSse2(const BiquadCoefficients *sections, qint32 sectionCount, double *state,
+                    double *tile, qint32 rows, quint32 lanes)
+{
+    for (quint32 lane = 0; lane < lanes; lane += 2)
+    {
+        __m128d z1[KERNEL_SECTIONS], z2[KERNEL_SECTIONS];
+        for (qint32 s = 0; s < sectionCount; ++s)
+        {
+            z1[s] = _mm_loadu_pd(state + 2 * s * lanes + lane);
+            z2[s] = _mm_loadu_pd(state + 2 * s * lanes + lanes + lane);
+        }
+        for (double *p = tile + lane, *end = p + qint64(rows) * lanes; p != end; p += lanes)
+        {
+            __m128d x = _mm_loadu_pd(p);
+            const __m128d valid = _mm_cmpord_pd(x, x);
+            for (qint32 s = 0; s < sectionCount; ++s)
+            {
+                const BiquadCoefficients &k = sections[s];
+                const __m128d y = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(k.b0), x), z1[s]);
+                const __m128d n1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(k.b1), x), _mm_mul_pd(_mm_set1_pd(k.a1), y)), z2[s]);
+                const __m128d n2 = _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(k.b2), x), _mm_mul_pd(_mm_set1_pd(k.a2), y));
+                z1[s] = _mm_or_pd(_mm_and_pd(valid, n1), _mm_andnot_pd(valid, z1[s]));
+                z2[s] = _mm_or_pd(_mm_and_pd(valid, n2), _mm_andnot_pd(valid, z2[s]));
+                x = y;
+            }
+            _mm_storeu_pd(p, x);
+        }
+        for (qint32 s = 0; s < sectionCount; ++s)
+        {
+            _mm_storeu_pd(state + 2 * s * lanes + lane, z1[s]);
+            _mm_storeu_pd(state + 2 * s * lanes + lanes + lane, z2[s]);
+        }
+    }
+}
+#endif
+
+#ifdef BIQUAD_X86
+TARGET_AVX static void runAvx(const BiquadCoefficients *sections, qint32 sectionCount, double *state,
+                              double *tile, qint32 rows, quint32 lanes)
+{
+    for (quint32 lane = 0; lane < lanes; lane += 4)
+    {
+        __m256d z1[KERNEL_SECTIONS], z2[KERNEL_SECTIONS];
+        for (qint32 s = 0; s < sectionCount; ++s)
+        {
+            z1[s] = _mm256_loadu_pd(state + 2 * s * lanes + lane);
+            z2[s] = _mm256_loadu_pd(state + 2 * s * lanes + lanes + lane);
+        }
+        for (double *p = tile + lane, *end = p + qint64(rows) * lanes; p != end; p += lanes)
+        {
+            __m256d x = _mm256_loadu_pd(p);
+            const __m256d valid = _mm256_cmp_pd(x, x, _CMP_ORD_Q);
+            for (qint32 s = 0; s < sectionCount; ++s)
+            {
+                const BiquadCoefficients &k = sections[s];
+                const __m256d y = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(k.b0), x), z1[s]);
+                const __m256d n1 = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(k.b1), x), _mm256_mul_pd(_mm256_set1_pd(k.a1), y)), z2[s]);
+                const __m256d n2 = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(k.b2), x), _mm256_mul_pd(_mm256_set1_pd(k.a2), y));
+                z1[s] = _mm256_blendv_pd(z1[s], n1, valid);
+                z2[s] = _mm256_blendv_pd(z2[s], n2, valid);
+                x = y;
+            }
+            _mm256_storeu_pd(p, x);
+        }
+        for (qint32 s = 0; s < sectionCount; ++s)
+        {
+            _mm256_storeu_pd(state + 2 * s * lanes + lane, z1[s]);
+            _mm256_storeu_pd(state + 2 * s * lanes + lanes + lane, z2[s]);
+        }
+    }
+}
+
+static bool cpuHasAvx(void)
+{
+#ifdef _MSC_VER
+    // CPU support and OS saving of the YMM registers
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = info[2] & (1 << 27);
+    const bool avx = info[2] & (1 << 28);
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+#ifdef BIQUAD_NEON
+static void runNeon(const BiquadCoefficients *sections, qint32 sectionCount, double *state,
+                    double *tile, qint32 rows, quint32 lanes)
+{
+    for (quint32 lane = 0; lane < lanes; lane += 2)
+    {
+        float64x2_t z1[KERNEL_SECTIONS], z2[KERNEL_SECTIONS];
+        for (qint32 s = 0; s < sectionCount; ++s)
+        {
+            z1[s] = vld1q_f64(state + 2 * s * lanes + lane);
+            z2[s] = vld1q_f64(state + 2 * s * lanes + lanes + lane);
+        }
+        for (double *p = tile + lane, *end = p + qint64(rows) * lanes; p != end; p += lanes)
+        {
+            float64x2_t x = vld1q_f64(p);
+            const uint64x2_t valid = vceqq_f64(x, x);
+            for (qint32 s = 0; s < sectionCount; ++s)
+            {
+                const BiquadCoefficients &k = sections[s];
+                const float64x2_t y = vaddq_f64(vmulq_f64(vdupq_n_f64(k.b0), x), z1[s]);
+                const float64x2_t n1 = vaddq_f64(vsubq_f64(vmulq_f64(vdupq_n_f64(k.b1), x), vmulq_f64(vdupq_n_f64(k.a1), y)), z2[s]);
+                const float64x2_t n2 = vsubq_f64(vmulq_f64(vdupq_n_f64(k.b2), x), vmulq_f64(vdupq_n_f64(k.a2), y));
+                z1[s] = vbslq_f64(valid, n1, z1[s]);
+                z2[s] = vbslq_f64(valid, n2, z2[s]);
+                x = y;
+            }
+            vst1q_f64(p, x);
+        }
+        for (qint32 s = 0; s < sectionCount; ++s)
+        {
+            vst1q_f64(state + 2 * s * lanes + lane, z1[s]);
+            vst1q_f64(state + 2 * s * lanes + lanes + lane, z2[s]);
+        }
+    }
+}
+#endif
+
+BiquadBank::Kernel BiquadBank::bestKernel(void)
+{
+    static const Kernel best = isSupported(KernelAvx) ? KernelAvx
+                               : isSupported(KernelSse2) ? KernelSse2
+                               : isSupported(KernelNeon) ? KernelNeon
+                                                         : KernelScalar;
+    return best;
+}
+
+bool BiquadBank::isSupported(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case KernelScalar:
+        return true;
+#ifdef BIQUAD_SSE2
+    case KernelSse2:
+        return true;
+#endif
+#ifdef BIQUAD_X86
+    case KernelAvx:
+    {
+        static const bool avx = cpuHasAvx();
+        return avx;
+    }
+#endif
+#ifdef BIQUAD_NEON
+    case KernelNeon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+QString BiquadBank::kernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case KernelSse2:
+        return "SSE2";
+    case KernelAvx:
+        return "AVX";
+    case KernelNeon:
+        return "NEON";
+    default:
+        return "scalar";
+    }
+}
+
+void BiquadBank::configure(const QVector<BiquadCoefficients> &sections, quint32 channelCount)
+{
+    m_sections = sections;
+    m_channelCount = channelCount;
+    m_lanes = (channelCount + LANE_ALIGN - 1) / LANE_ALIGN * LANE_ALIGN;
+    m_tile = QVector<double>(qint64(TILE_ROWS) * m_lanes, 0.0);
+    reset();
+}
+
+void BiquadBank::reset(void)
+{
+    m_state = QVector<double>(2 * m_sections.size() * m_lanes, 0.0);
+}
+
+void BiquadBank::setKernel(Kernel kernel)
+{
+    if (isSupported(kernel))
+    {
+        m_kernel = kernel;
+    }
+}
+
+void BiquadBank::process(QVector<QVector<double>> &columns, qint32 rowCount)
+{
+    if (m_sections.isEmpty() || rowCount <= 0)
+        return;
+
+    KernelFunction run = runScalar;
+    switch (m_kernel)
+    {
+#ifdef BIQUAD_SSE2
+    case KernelSse2:
+        run = runSse2;
+        break;
+#endif
+#ifdef BIQUAD_X86
+    case KernelAvx:
+        run = runAvx;
+        break;
+#endif
+#ifdef BIQUAD_NEON
+    case KernelNeon:
+        run = runNeon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    // Padding lanes stay zero, so their state never moves
+    const quint32 channels = qMin<quint32>(m_channelCount, columns.size());
+    double *tile = m_tile.data();
+    for (qint32 first = 0; first < rowCount; first += TILE_ROWS)
+    {
+        const qint32 rows = qMin(TILE_ROWS, rowCount - first);
+        for (quint32 c = 0; c < channels; ++c)
+        {
+            const double *column = columns[c].constData() + first;
+            for (qint32 r = 0; r < rows; ++r)
+            {
+                tile[r * m_lanes + c] = column[r];
+            }
+        }
+
+        for (qint32 s = 0; s < m_sections.size(); s += KERNEL_SECTIONS)
+        {
+            run(m_sections.constData() + s, qMin(KERNEL_SECTIONS, m_sections.size() - s),
+                m_state.data() + 2 * s * m_lanes, tile, rows, m_lanes);
+        }
+
+        for (quint32 c = 0; c < channels; ++c)
+        {
+            double *column = columns[c].data() + first;
+            for (qint32 r = 0; r < rows; ++r)
+            {
+                column[r] = tile[r * m_lanes + c];
+            }
+        }
+    }
+}
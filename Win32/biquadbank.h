@@ -0,0 +1,82 @@
+#ifndef BIQUADBANK_H
+#define BIQUADBANK_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Coefficients of one second-order IIR section, normalised so a0 = 1.
+ *
+ * The designs follow the RBJ audio EQ cookbook.
+ */
+struct BiquadCoefficients
+{
+    double b0 = 1;
+    double b1 = 0;
+    double b2 = 0;
+    double a1 = 0;
+    double a2 = 0;
+
+    static BiquadCoefficients lowPass(double sampleRate, double frequency, double q);
+    static BiquadCoefficients highPass(double sampleRate, double frequency, double q);
+    static BiquadCoefficients notch(double sampleRate, double frequency, double q);
+    // First-order high-pass written as a biquad (b2 = a2 = 0)
+    static BiquadCoefficients firstOrderHighPass(double sampleRate, double frequency);
+};
+
+/**
+ * @brief The same cascade of biquad sections run over many channels at once.
+ *
+ * Blocks are copied, a tile of rows at a time, into a channel-interleaved
+ * buffer (row-major, one lane per channel) so a vector register holds the
+ * same row of several channels and every section is applied to all of them
+ * with one instruction stream. The delay elements are kept per section as
+ * contiguous lanes too. The kernel is picked at run time from what the CPU
+ * supports (AVX, SSE2, NEON) with a scalar fallback; all kernels perform the
+ * same operations in the same order.
+ *
+ * NaN samples are passed through and leave the state of their channel
+ * untouched, so a missing value does not poison the filter.
+ */
+class BiquadBank
+{
+public:
+    enum Kernel
+    {
+        KernelScalar,
+        KernelSse2,
+        KernelAvx,
+        KernelNeon
+    };
+
+    // Fastest kernel supported by this CPU
+    static Kernel bestKernel(void);
+    static bool isSupported(Kernel kernel);
+    static QString kernelName(Kernel kernel);
+
+    BiquadBank() : m_kernel(bestKernel()) {}
+
+    // Sets the sections and the number of channels, clears the state
+    void configure(const QVector<BiquadCoefficients> &sections, quint32 channelCount);
+    void reset(void);
+
+    // Unsupported kernels are ignored
+    void setKernel(Kernel kernel);
+    Kernel kernel(void) const { return m_kernel; }
+
+    qint32 sectionCount(void) const { return m_sections.size(); }
+    quint32 channelCount(void) const { return m_channelCount; }
+
+    // Filters the first rowCount values of every column in place, one column per channel
+    void process(QVector<QVector<double>> &columns, qint32 rowCount);
+
+private:
+    QVector<BiquadCoefficients> m_sections;
+    quint32 m_channelCount = 0;
+    quint32 m_lanes = 0; // Channels rounded up to the widest vector
+    QVector<double> m_state; // Per section: z1 of every lane, then z2 of every lane
+    QVector<double> m_tile; // Interleaved rows being filtered
+    Kernel m_kernel;
+};
+
+#endif // BIQUADBANK_H
@@ -0,0 +1,96 @@
+#ifndef CLOCKTIME_H
+#define CLOCKTIME_H
+
+#include <QString>
+#include <QDateTime>
+
+// Time stamps are displayed and saved as "hh:mm:ss.zzz"
+#define CLOCK_TIME_FORMAT "hh:mm:ss.zzz"
+#define CLOCK_TIME_SIZE 12
+#define MSECS_PER_DAY 86400000
+
+/**
+ * @brief Writes a time of day as "hh:mm:ss.zzz" using integer arithmetic only.
+ *
+ * @param msecsOfDay Milliseconds since midnight, wrapped into a single day.
+ * @param out Destination of at least CLOCK_TIME_SIZE chars (not null-terminated).
+ */
+inline void formatClockTime(qint64 msecsOfDay, char *out)
+{
+    msecsOfDay %= MSECS_PER_DAY;
+    if (msecsOfDay < 0) msecsOfDay += MSECS_PER_DAY;
+
+    const int ms = int(msecsOfDay % 1000);
+    const int totalSeconds = int(msecsOfDay / 1000);
+    const int s = totalSeconds % 60;
+    const int m = (totalSeconds / 60) % 60;
+    const int h = totalSeconds / 3600;
+
+    out[0] = char('0' + h / 10);
+    out[1] = char('0' + h % 10);
+    out[2] = ':';
+    out[3] = char('0' + m / 10);
+    out[4] = char('0' + m % 10);
+    out[5] = ':';
+    out[6] = char('0' + s / 10);
+    out[7] = char('0' + s % 10);
+    out[8] = '.';
+    out[9] = char('0' + ms / 100);
+    out[10] = char('0' + (ms / 10) % 10);
+    out[11] = char('0' + ms % 10);
+}
+
+/**
+ * @brief Returns a time of day formatted as "hh:mm:ss.zzz".
+ */
+inline QString clockTimeToString(qint64 msecsOfDay)
+{
+    char text[CLOCK_TIME_SIZE];
+    formatClockTime(msecsOfDay, text);
+    return QString::fromLatin1(text, CLOCK_TIME_SIZE);
+}
+
+/**
+ * @brief Parses "hh:mm:ss.zzz" without going through QDateTime.
+ *
+ * @param text Characters of the field, exactly CLOCK_TIME_SIZE long.
+ * @param length Number of characters in text.
+ * @param msecsOfDay Receives the milliseconds since midnight.
+ * @return false if text is not a valid time of day.
+ */
+inline bool parseClockTime(const char *text, qint32 length, qint64 *msecsOfDay)
+{
+    if (length != CLOCK_TIME_SIZE || text[2] != ':' || text[5] != ':' || text[8] != '.')
+        return false;
+
+    static const int digitPositions[] = {0, 1, 3, 4, 6, 7, 9, 10, 11};
+    for (int position : digitPositions)
+    {
+        if (text[position] < '0' || text[position] > '9')
+            return false;
+    }
+
+    const int h = (text[0] - '0') * 10 + (text[1] - '0');
+    const int m = (text[3] - '0') * 10 + (text[4] - '0');
+    const int s = (text[6] - '0') * 10 + (text[7] - '0');
+    const int ms = (text[9] - '0') * 100 + (text[10] - '0') * 10 + (text[11] - '0');
+    if (h > 23 || m > 59 || s > 59)
+        return false;
+
+    *msecsOfDay = ((h * 60 + m) * 60 + s) * 1000LL + ms;
+    return true;
+}
+
+/**
+ * @brief Converts a parsed time of day into a plot key in seconds.
+ *
+ * Gives the same key as QDateTime::fromString(text, CLOCK_TIME_FORMAT), which
+ * places a time without date on 1900-01-01 local time.
+ */
+inline double clockTimeToKey(qint64 msecsOfDay)
+{
+    static const qint64 base = QDateTime(QDate(1900, 1, 1), QTime(0, 0)).toMSecsSinceEpoch();
+    return (base + msecsOfDay) / 1000.0;
+}
+
+#endif // CLOCKTIME_H
@@ -12,6 +12,7 @@
 #define MOTOR_HANDLE 'm'
 #define MOTOR_STATUS_SIZE 2
 #define VOLTAGE_COEFFICIENT 1
+#define VOLTAGE_UNIT "uV" // Unit of the EMG values once scaled by VOLTAGE_COEFFICIENT
 #define PACKET_KEYWORD "armb"
 #define DEVICE_ID_START 4
 #define DEVICE_ID_SIZE 4
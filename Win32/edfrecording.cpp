@@ -0,0 +1,423 @@
+#include "edfrecording.h"
+#include "definitions.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+#include <cstring>
+
+static const qint32 ANNOTATION_BYTES = 60; // Room for the time-keeping annotation of a record
+static const qint64 NUMBER_OF_RECORDS_OFFSET = 236; // Position of the number of records in the header
+
+// Fixed-width, space padded header field
+static void putField(QByteArray &header, const QString &text, qint32 width)
+{
+    QByteArray field = text.toLatin1().left(width);
+    header.append(field);
+    header.append(width - field.size(), ' ');
+}
+
+// Decimal number that fits an 8 character field
+static QString edfNumber(double value)
+{
+    for (qint32 decimals = 6; decimals >= 0; --decimals)
+    {
+        QString text = QString::number(value, 'f', decimals);
+        if (text.contains('.'))
+        {
+            while (text.endsWith('0'))
+                text.chop(1);
+            if (text.endsWith('.'))
+                text.chop(1);
+        }
+        if (text.size() <= 8)
+            return text;
+    }
+    return QString::number(value, 'g', 3);
+}
+
+static QString readField(const uchar *data, qint64 offset, qint32 width)
+{
+    return QString::fromLatin1(reinterpret_cast<const char*>(data + offset), width).trimmed();
+}
+
+EdfWriter::~EdfWriter()
+{
+    close();
+}
+
+bool EdfWriter::open(const QString &fileName, bool bdf, quint32 channelCount, double sampleRate, double startTime,
+                     const QString &deviceId, double physicalMinimum, double physicalMaximum)
+{
+    if (channelCount == 0 || !(sampleRate > 0))
+    {
+        qWarning() << "EDF export needs at least one channel and a sample rate";
+        return false;
+    }
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Unable to open file for writing:" << m_file.errorString();
+        return false;
+    }
+
+    m_bdf = bdf;
+    m_channelCount = channelCount;
+    m_samplesPerRecord = qMax(1, qRound(sampleRate * EDF_RECORD_SECONDS));
+    m_digitalMinimum = bdf ? -8388608 : -32768;
+    m_digitalMaximum = bdf ? 8388607 : 32767;
+    if (!(physicalMaximum > physicalMinimum))
+        physicalMaximum = physicalMinimum + 1;
+    m_physicalMinimum = physicalMinimum;
+    m_gain = (double(m_digitalMaximum) - m_digitalMinimum) / (physicalMaximum - physicalMinimum);
+    m_pending = QVector<QVector<double>>(channelCount);
+    m_held = QVector<double>(channelCount, qQNaN());
+    m_recordCount = 0;
+    m_missingSamples = 0;
+
+    // Whole seconds in the header, the rest in the record onsets
+    const qint64 startMsecs = qRound64(startTime * 1000);
+    const QDateTime start = QDateTime::fromMSecsSinceEpoch(startMsecs - startMsecs % 1000);
+    m_startFraction = (startMsecs % 1000) / 1000.0;
+
+    const qint32 signalCount = channelCount + 1;
+    const qint32 bytesPerSample = bdf ? 3 : 2;
+    QString equipment = "ArmBionics_" + QString(deviceId).replace(' ', '_');
+
+    QByteArray header;
+    if (bdf)
+    {
+        header.append(char(0xFF));
+        putField(header, "BIOSEMI", 7);
+    }
+    else
+    {
+        putField(header, "0", 8);
+    }
+    putField(header, "X X X X", 80);
+    putField(header, "Startdate " + start.date().toString("dd-MMM-yyyy").toUpper() + " X X " + equipment, 80);
+    putField(header, start.toString("dd.MM.yy"), 8);
+    putField(header, start.toString("hh.mm.ss"), 8);
+    putField(header, QString::number(256 * (signalCount + 1)), 8);
+    putField(header, bdf ? "BDF+C" : "EDF+C", 44);
+    putField(header, "-1", 8); // Patched on close
+    putField(header, QString::number(EDF_RECORD_SECONDS), 8);
+    putField(header, QString::number(signalCount), 4);
+
+    // Signal fields are stored field by field, each for every signal
+    auto perSignal = [&](const QString &emg, const QString &annotation, qint32 width) {
+        for (quint32 c = 0; c < channelCount; ++c)
+            putField(header, emg, width);
+        putField(header, annotation, width);
+    };
+    for (quint32 c = 0; c < channelCount; ++c)
+        putField(header, "EMG" + QString::number(c + 1), 16);
+    putField(header, bdf ? "BDF Annotations" : "EDF Annotations", 16);
+    perSignal("", "", 80);
+    perSignal(VOLTAGE_UNIT, "", 8);
+    perSignal(edfNumber(physicalMinimum), "-1", 8);
+    perSignal(edfNumber(physicalMaximum), "1", 8);
+    perSignal(QString::number(m_digitalMinimum), QString::number(m_digitalMinimum), 8);
+    perSignal(QString::number(m_digitalMaximum), QString::number(m_digitalMaximum), 8);
+    perSignal("", "", 80);
+    perSignal(QString::number(m_samplesPerRecord), QString::number(ANNOTATION_BYTES / bytesPerSample), 8);
+    perSignal("", "", 32);
+
+    m_record.resize(qint64(channelCount) * m_samplesPerRecord * bytesPerSample + ANNOTATION_BYTES);
+    return m_file.write(header) == header.size();
+}
+
+bool EdfWriter::append(const RowBlock &rows)
+{
+    if (!m_file.isOpen())
+        return false;
+
+    qint32 row = 0;
+    while (row < rows.rowCount())
+    {
+        const qint32 take = qMin<qint32>(m_samplesPerRecord - m_pending[0].size(), rows.rowCount() - row);
+        for (quint32 c = 0; c < m_channelCount; ++c)
+        {
+            if (c < quint32(rows.channels.size()) && rows.channels[c].size() == rows.rowCount())
+                m_pending[c].append(rows.channels[c].mid(row, take));
+            else
+                m_pending[c].append(QVector<double>(take, qQNaN()));
+        }
+        row += take;
+
+        if (quint32(m_pending[0].size()) == m_samplesPerRecord && !writeRecord(m_samplesPerRecord))
+            return false;
+    }
+    return true;
+}
+
+bool EdfWriter::writeRecord(quint32 rows)
+{
+    const qint32 bytesPerSample = m_bdf ? 3 : 2;
+    char *out = m_record.data();
+
+    for (quint32 c = 0; c < m_channelCount; ++c)
+    {
+        // A missing value holds the previous one, or the first of the record before any, EDF has no gaps
+        double &held = m_held[c];
+        if (qIsNaN(held))
+        {
+            for (double value : std::as_const(m_pending[c]))
+            {
+                if (!qIsNaN(value))
+                {
+                    held = value;
+                    break;
+                }
+            }
+        }
+
+        for (quint32 i = 0; i < m_samplesPerRecord; ++i)
+        {
+            const double value = m_pending[c][i];
+            if (!qIsNaN(value))
+                held = value;
+            else if (i < rows)
+                ++m_missingSamples;
+
+            // A channel without any value yet stays at the lowest physical value
+            qint32 digital = m_digitalMinimum;
+            if (!qIsNaN(held))
+                digital = qBound<qint64>(m_digitalMinimum, qRound64((held - m_physicalMinimum) * m_gain) + m_digitalMinimum, m_digitalMaximum);
+
+            *out++ = char(digital & 0xFF);
+            *out++ = char((digital >> 8) & 0xFF);
+            if (bytesPerSample == 3)
+                *out++ = char((digital >> 16) & 0xFF);
+        }
+        m_pending[c].clear();
+    }
+
+    // Time-keeping annotation: "+onset\x14\x14\0", zero padded
+    QByteArray annotation = "+" + QByteArray::number(m_recordCount * EDF_RECORD_SECONDS + m_startFraction, 'f', 3) + "\x14\x14";
+    memset(out, 0, ANNOTATION_BYTES);
+    memcpy(out, annotation.constData(), qMin<qint64>(annotation.size(), ANNOTATION_BYTES - 1));
+
+    if (m_file.write(m_record) != m_record.size())
+    {
+        qWarning() << "EDF write failed:" << m_file.errorString();
+        return false;
+    }
+    ++m_recordCount;
+    return true;
+}
+
+bool EdfWriter::close(void)
+{
+    if (!m_file.isOpen())
+        return false;
+
+    // The last record is padded with the last value of each channel, held as any missing one
+    bool ok = true;
+    if (!m_pending[0].isEmpty())
+    {
+        const quint32 rows = m_pending[0].size();
+        for (quint32 c = 0; c < m_channelCount; ++c)
+        {
+            m_pending[c].resize(m_samplesPerRecord, qQNaN());
+        }
+        ok = writeRecord(rows);
+    }
+    if (m_missingSamples > 0)
+    {
+        qInfo() << "EDF export:" << m_missingSamples << "missing samples held at the previous value of their channel in" << m_file.fileName();
+    }
+
+    QByteArray count;
+    putField(count, QString::number(m_recordCount), 8);
+    ok = ok && m_file.seek(NUMBER_OF_RECORDS_OFFSET) && m_file.write(count) == count.size();
+    m_file.close();
+    return ok;
+}
+
+EdfRecordingSource::~EdfRecordingSource()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+}
+
+bool EdfRecordingSource::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open file for reading:" << m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    m_data = m_size >= 256 ? m_file.map(0, m_size) : nullptr;
+    if (!m_data)
+    {
+        qWarning() << "Not an EDF/BDF file:" << fileName;
+        return false;
+    }
+
+    const bool bdf = m_data[0] == 0xFF && readField(m_data, 1, 7) == "BIOSEMI";
+    if (!bdf && readField(m_data, 0, 8) != "0")
+    {
+        qWarning() << "Not an EDF/BDF file:" << fileName;
+        return false;
+    }
+    m_bytesPerSample = bdf ? 3 : 2;
+
+    m_headerSize = readField(m_data, 184, 8).toLongLong();
+    m_recordSeconds = readField(m_data, 244, 8).toDouble();
+    const qint32 signalCount = readField(m_data, 252, 4).toInt();
+    if (signalCount <= 0 || m_headerSize != 256LL * (signalCount + 1) || m_headerSize > m_size || !(m_recordSeconds > 0))
+    {
+        qWarning() << "Invalid EDF/BDF header:" << fileName;
+        return false;
+    }
+
+    // Signal fields, each stored for every signal in turn
+    auto signalField = [this, signalCount](qint32 fieldOffset, qint32 width, qint32 signal) {
+        return readField(m_data, 256 + qint64(signalCount) * fieldOffset + qint64(signal) * width, width);
+    };
+
+    m_signals.clear();
+    m_recordSize = 0;
+    qint64 annotationOffset = -1;
+    for (qint32 i = 0; i < signalCount; ++i)
+    {
+        const QString label = signalField(0, 16, i);
+        const quint32 samples = signalField(216, 8, i).toUInt();
+        if (label.endsWith("Annotations"))
+        {
+            if (annotationOffset < 0)
+                annotationOffset = m_recordSize;
+        }
+        else
+        {
+            if (!m_signals.isEmpty() && samples != m_samplesPerRecord)
+            {
+                qWarning() << "Signals with different sample rates are not supported:" << fileName;
+                return false;
+            }
+            m_samplesPerRecord = samples;
+
+            const double physicalMinimum = signalField(104, 8, i).toDouble();
+            const double physicalMaximum = signalField(112, 8, i).toDouble();
+            const double digitalMinimum = signalField(120, 8, i).toDouble();
+            const double digitalMaximum = signalField(128, 8, i).toDouble();
+            Signal signal;
+            signal.label = label;
+            signal.offset = m_recordSize;
+            signal.gain = digitalMaximum > digitalMinimum ? (physicalMaximum - physicalMinimum) / (digitalMaximum - digitalMinimum) : 1;
+            signal.offsetValue = physicalMinimum - digitalMinimum * signal.gain;
+            m_signals.append(signal);
+        }
+        m_recordSize += qint64(samples) * m_bytesPerSample;
+    }
+    if (m_signals.isEmpty() || m_samplesPerRecord == 0)
+    {
+        qWarning() << "No data signals in" << fileName;
+        return false;
+    }
+
+    // -1 while the file was being written, the file size decides
+    const qint64 available = (m_size - m_headerSize) / m_recordSize;
+    m_recordCount = readField(m_data, 236, 8).toLongLong();
+    if (m_recordCount < 0 || m_recordCount > available)
+        m_recordCount = available;
+
+    // Start time to the second from the header, sub-second part from the first record onset (EDF+)
+    const QString date = readField(m_data, 168, 8);
+    const QString time = readField(m_data, 176, 8);
+    qint32 year = date.mid(6, 2).toInt();
+    year += year >= 85 ? 1900 : 2000;
+    QDateTime start(QDate(year, date.mid(3, 2).toInt(), date.left(2).toInt()),
+                    QTime(time.left(2).toInt(), time.mid(3, 2).toInt(), time.mid(6, 2).toInt()));
+    m_startTime = start.toMSecsSinceEpoch() / 1000.0;
+    if (annotationOffset >= 0 && m_recordCount > 0)
+    {
+        const char *tal = reinterpret_cast<const char*>(m_data + m_headerSize + annotationOffset);
+        const qint64 length = qstrnlen(tal, uint(m_recordSize - annotationOffset));
+        const QByteArray onset = QByteArray(tal, length).split('\x14').value(0);
+        m_startTime += onset.toDouble();
+    }
+
+    qInfo() << (bdf ? "BDF" : "EDF") << "file:" << m_signals.size() << "channels," << m_recordCount << "records at" << sampleRate() << "Hz";
+    return true;
+}
+
+QStringList EdfRecordingSource::labels(void) const
+{
+    QStringList labels;
+    for (const Signal &signal : m_signals)
+        labels.append(signal.label);
+    return labels;
+}
+
+void EdfRecordingSource::readRecords(qint64 first, qint32 count, RowBlock &rows) const
+{
+    const qint32 rowCount = count * m_samplesPerRecord;
+    const double interval = m_recordSeconds / m_samplesPerRecord;
+    rows.clear(m_signals.size());
+    rows.times.resize(rowCount);
+    for (qint32 i = 0; i < rowCount; ++i)
+    {
+        rows.times[i] = m_startTime + first * m_recordSeconds + i * interval;
+    }
+
+    for (qint32 c = 0; c < m_signals.size(); ++c)
+    {
+        const Signal &signal = m_signals[c];
+        QVector<double> &values = rows.channels[c];
+        values.resize(rowCount);
+        double *out = values.data();
+        for (qint32 r = 0; r < count; ++r)
+        {
+            const uchar *in = m_data + m_headerSize + (first + r) * m_recordSize + signal.offset;
+            for (quint32 i = 0; i < m_samplesPerRecord; ++i, in += m_bytesPerSample)
+            {
+                qint32 digital = m_bytesPerSample == 3 ? qint32(quint32(in[0] | in[1] << 8 | in[2] << 16) << 8) >> 8
+                                                       : qint32(qint16(in[0] | in[1] << 8));
+                *out++ = digital * signal.gain + signal.offsetValue;
+            }
+        }
+    }
+}
+
+bool EdfRecordingSource::buildIndex(RecordingIndex &index, const std::atomic_bool &cancel) const
+{
+    // Blocks are whole records
+    const qint32 recordsPerBlock = qMax<qint32>(1, RecordingIndex::DEFAULT_ROWS_PER_BLOCK / m_samplesPerRecord);
+    const quint32 channels = m_signals.size();
+    index.reset(channels, recordsPerBlock * m_samplesPerRecord);
+
+    RowBlock rows;
+    QVector<double> minimum(channels), maximum(channels);
+    for (qint64 first = 0; first < m_recordCount; first += recordsPerBlock)
+    {
+        if (cancel)
+            return false;
+
+        const qint32 count = qMin<qint64>(recordsPerBlock, m_recordCount - first);
+        readRecords(first, count, rows);
+        for (quint32 c = 0; c < channels; ++c)
+        {
+            const auto range = std::minmax_element(rows.channels[c].constBegin(), rows.channels[c].constEnd());
+            minimum[c] = *range.first;
+            maximum[c] = *range.second;
+        }
+        index.appendBlock(first, rows.rowCount(), rows.times.first(), rows.times.last(), minimum.constData(), maximum.constData());
+    }
+
+    index.buildPyramid();
+    return true;
+}
+
+bool EdfRecordingSource::readBlock(const RecordingIndex &index, qint32 block, RowBlock &rows) const
+{
+    if (block < 0 || block >= index.blockCount())
+        return false;
+
+    readRecords(index.blockOffsets[block], index.blockRows[block] / m_samplesPerRecord, rows);
+    return true;
+}
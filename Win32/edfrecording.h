@@ -0,0 +1,120 @@
+#ifndef EDFRECORDING_H
+#define EDFRECORDING_H
+
+#include <QFile>
+#include <QStringList>
+#include <QVector>
+#include "recording.h"
+
+/*
+ * EDF+ (16-bit samples) and BDF+ (24-bit samples) files, continuous variant.
+ * Data records last EDF_RECORD_SECONDS and hold the same number of samples
+ * for every EMG channel, followed by an annotation signal that only carries
+ * the time-keeping annotation (record onset) required by EDF+.
+ */
+
+#define EDF_EXTENSION ".edf"
+#define BDF_EXTENSION ".bdf"
+#define EDF_RECORD_SECONDS 1
+
+/**
+ * @brief Writes an EDF+/BDF+ file record by record.
+ *
+ * Rows are buffered until a data record is full and then written in one go,
+ * so memory does not depend on the length of the recording. The number of
+ * records in the header is patched on close(); a partial last record is
+ * padded with the last value of each channel. EDF has no missing values, a
+ * NaN sample holds the previous value of its channel (a dropout, not a
+ * full-scale spike) and the count of them is logged on close().
+ */
+class EdfWriter
+{
+public:
+    ~EdfWriter();
+
+    /**
+     * @brief Creates the file and writes the header.
+     *
+     * @param bdf Writes BDF+ (24-bit) instead of EDF+ (16-bit).
+     * @param startTime Time of the first row in seconds since epoch (plot key).
+     * @param physicalMinimum Lowest value that can be stored, same for every channel.
+     * @param physicalMaximum Highest value that can be stored.
+     */
+    bool open(const QString &fileName, bool bdf, quint32 channelCount, double sampleRate, double startTime,
+              const QString &deviceId, double physicalMinimum, double physicalMaximum);
+    bool append(const RowBlock &rows);
+    bool close(void);
+
+    quint32 samplesPerRecord(void) const { return m_samplesPerRecord; }
+
+private:
+    // The first rows samples of each channel were appended, the rest pads the record
+    bool writeRecord(quint32 rows);
+
+    QFile m_file;
+    bool m_bdf = false;
+    quint32 m_channelCount = 0;
+    quint32 m_samplesPerRecord = 0;
+    double m_startFraction = 0; // Sub-second part of the start time, in the record onsets
+    double m_gain = 1; // Digital units per physical unit
+    double m_physicalMinimum = 0;
+    qint32 m_digitalMinimum = 0;
+    qint32 m_digitalMaximum = 0;
+    QVector<QVector<double>> m_pending; // Rows of the record being filled, per channel
+    QVector<double> m_held; // Last value written per channel, stands in for missing ones
+    qint64 m_missingSamples = 0;
+    QByteArray m_record;
+    qint64 m_recordCount = 0;
+};
+
+/**
+ * @brief EDF/EDF+ or BDF/BDF+ file read lazily through a memory mapping.
+ *
+ * Every data signal must have the same number of samples per record, they
+ * become the channels of the recording. Annotation signals are skipped. Row
+ * times are derived from the start time and the sample rate, blocks are runs
+ * of whole data records.
+ */
+class EdfRecordingSource : public RecordingSource
+{
+public:
+    ~EdfRecordingSource();
+
+    // Maps fileName and reads its header, returns false if it is not a supported EDF/BDF file
+    bool open(const QString &fileName);
+
+    QString fileName(void) const override { return m_file.fileName(); }
+    quint32 channelCount(void) const override { return m_signals.size(); }
+    double sampleRate(void) const { return m_samplesPerRecord / m_recordSeconds; }
+    double startTime(void) const { return m_startTime; }
+    QStringList labels(void) const;
+
+    bool buildIndex(RecordingIndex &index, const std::atomic_bool &cancel) const override;
+    bool readBlock(const RecordingIndex &index, qint32 block, RowBlock &rows) const override;
+
+private:
+    struct Signal
+    {
+        QString label;
+        qint64 offset; // Byte position of the signal in a data record
+        double gain; // Physical units per digital unit
+        double offsetValue; // Physical value of digital 0
+    };
+
+    // Decodes records [first, first + count) into rows
+    void readRecords(qint64 first, qint32 count, RowBlock &rows) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    qint32 m_bytesPerSample = 2;
+    qint64 m_headerSize = 0;
+    qint64 m_recordSize = 0;
+    qint64 m_recordCount = 0;
+    double m_recordSeconds = 1;
+    quint32 m_samplesPerRecord = 0;
+    double m_startTime = 0;
+    QVector<Signal> m_signals;
+};
+
+#endif // EDFRECORDING_H
@@ -6,14 +6,116 @@
 #include <QRandomGenerator>
 #include <QColorDialog>
 #include <QInputDialog>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QThread>
+#include <QFileInfo>
+#include <QDir>
+#include <QLockFile>
+#include <QStandardPaths>
+#include <QLabel>
+#include <QStatusBar>
+#include <algorithm>
 #include "definitions.h"
+#include "tracerasterizer.h"
+#include "renderquality.h"
+#include "fastdatetimeticker.h"
+#include "clocktime.h"
+#include "spectrogram.h"
+#include "recordingviewer.h"
+#include "textrecording.h"
+#include "binaryrecording.h"
+#include "recordingwriter.h"
+#include "edfrecording.h"
+#include "featureextractor.h"
+#include "gestureclassifier.h"
+#include "fft.h"
+#include "powerspectrum.h"
+#include "resampler.h"
 
 const qint16 SECONDS_SHOW_ON_GRAPH = 50;  // Display N seconds on the graph
+const double FRAME_BUDGET_MS = 33.0;  // Drop render quality when replots take longer than this
+const qint64 LAZY_LOAD_THRESHOLD = 64 * 1024 * 1024;  // Larger files are opened in the recording viewer
+const double ONSET_CALIBRATION_SECONDS = 2.0;  // Envelope at rest that sets the onset thresholds
+const qint32 MAX_ONSET_MARKERS = 200;  // Older onset markers are removed from the plot
+const qint64 INFERENCE_BUDGET_NS = 5000000;  // Gesture inference time allowed per read
+const qint32 SESSION_RETENTION_DAYS = 30;  // Session files older than this are deleted when a session starts
+const qint64 SESSION_RETENTION_BYTES = qint64(2) * 1024 * 1024 * 1024;  // Oldest session files go beyond this total
+const double EMG_FULL_SCALE = (qPow(10, EMG_VALUE_SIZE) - 1) * VOLTAGE_COEFFICIENT;  // Largest value the EMG_VALUE_SIZE digits decode to
 QList<double> time_axis;
 QList<QString> time_axis_string; // To save the data and for displaying purposes
 static qint64 voltage_data_idx = 0;   // Used for x-axis range setting
 static qint64 startTime;
 
+// Where acquired sessions are recorded
+static QString sessionDirectory(void)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/sessions";
+}
+
+// Files every session leaves in the session directory, by prefix
+static const QStringList SESSION_FILE_PATTERNS = {"session-*", "filtered-*", "uniform-*", "events-*", "features-*"};
+
+// Milliseconds in the name, and a counter if a file of that stamp exists anyway (clock set back, two instances)
+static QString uniqueSessionStamp(const QString &dir)
+{
+    const QString base = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz");
+    QString stamp = base;
+    for (qint32 n = 2; !QDir(dir).entryList({"*-" + stamp + ".*"}, QDir::Files).isEmpty(); ++n)
+    {
+        stamp = QString("%1-%2").arg(base).arg(n);
+    }
+    return stamp;
+}
+
+// Deletes session files past the age limit, then the oldest ones past the size limit; files in keep stay
+static void pruneSessionDirectory(const QString &dir, const QStringList &keep)
+{
+    const QFileInfoList files = QDir(dir).entryInfoList(SESSION_FILE_PATTERNS, QDir::Files, QDir::Time);
+    const QDateTime oldest = QDateTime::currentDateTime().addDays(-SESSION_RETENTION_DAYS);
+    qint64 total = 0;
+    qint32 removed = 0;
+    qint64 freed = 0;
+    for (const QFileInfo &file : files)
+    {
+        if (file.fileName().endsWith(".lock"))
+        {
+            continue;
+        }
+        if (keep.contains(file.absoluteFilePath()))
+        {
+            total += file.size();
+            continue;
+        }
+        if (file.lastModified() >= oldest && total + file.size() <= SESSION_RETENTION_BYTES)
+        {
+            total += file.size();
+            continue;
+        }
+
+        // Still being written by another instance
+        QLockFile lock(RecordingWriter::lockFileName(file.absoluteFilePath()));
+        if (!lock.tryLock(0))
+        {
+            total += file.size();
+            continue;
+        }
+        if (QFile::remove(file.absoluteFilePath()))
+        {
+            ++removed;
+            freed += file.size();
+        }
+        else
+        {
+            qWarning() << "Cannot delete old session file" << file.absoluteFilePath();
+        }
+    }
+    if (removed > 0)
+    {
+        qInfo() << QString("Deleted %1 old session files (%2 MB)").arg(removed).arg(freed / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+}
+
 EMGWidget::EMGWidget(QWidget *parent) : QMainWindow(parent) , ui(new Ui::EMGWidget)
 {
     ui->setupUi(this);
@@ -30,8 +132,31 @@ EMGWidget::EMGWidget(QWidget *parent) : QMainWindow(parent) , ui(new Ui::EMGWidg
     // Initial population of the serial ports in the combo box
     updateAvailablePorts();
 
+    // Rasterise channel traces on the worker pool
+    traceRasterizer = new TraceRasterizer(ui->customPlot);
+
+    // Lower antialiasing while panning/zooming or when frames are over budget
+    renderQuality = new RenderQualityController(ui->customPlot);
+    renderQuality->setFrameBudget(FRAME_BUDGET_MS);
+
     // Plot the EMG graph
     plotEMGGraph();
+
+    // Spectrogram pane, hidden until enabled from the Tools menu
+    spectrogram = new SpectrogramView(ui->customPlot, ui->customPlot->xAxis);
+
+    // DC removal, band-pass and mains notch on the live stream
+    setupFilterChain();
+
+    // Onset latency is measured from the serial read to the replot that draws the marker
+    arrivalClock.start();
+    connect(ui->customPlot, &QCustomPlot::afterReplot, this, &EMGWidget::onsetMarkersRendered);
+
+    // Span dragged on the plot for the power spectrum
+    connect(ui->customPlot->selectionRect(), &QCPSelectionRect::accepted, this, &EMGWidget::powerSpectrumSpanSelected);
+
+    // Once the window is up, offer the session a crash left behind
+    QTimer::singleShot(0, this, &EMGWidget::offerSessionRecovery);
 }
 
 EMGWidget::~EMGWidget()
@@ -116,6 +241,23 @@ void EMGWidget::portConnect(void)
     portOpened = true;
     dataSaved = false;
     saveDialogShown = false;
+
+    // Fresh filter, envelope and onset state, configured once the sample rate is known
+    setupFilterChain();
+    setupEnvelope();
+    featureExtractor = FeatureExtractor();
+    featureTable = FeatureTable();
+    qualityMonitor = SignalQualityMonitor();
+    gestureText.clear();
+    inferenceTotal = 0;
+    inferenceMax = 0;
+    inferenceCount = 0;
+    inferenceOverBudget = 0;
+    inferenceSkipped = 0;
+    pendingOnsetArrivals.clear();
+    onsetLatencyTotal = 0;
+    onsetLatencyMax = 0;
+    onsetLatencyCount = 0;
 }
 
 void EMGWidget::portDisconnect(void)
@@ -126,6 +268,29 @@ void EMGWidget::portDisconnect(void)
     disconnect(&m_serial, SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this, SLOT(handleSerialPortError(QSerialPort::SerialPortError)));
     m_serial.close();
 
+    // Finish the session file
+    stopSessionRecording();
+    for (const QString &line : filterChain.costReport())
+    {
+        qInfo() << "Filter cost" << line;
+    }
+    if (onsetLatencyCount > 0)
+    {
+        qInfo() << QString("Onset latency: mean %1 ms, max %2 ms over %3 events")
+                       .arg(onsetLatencyTotal / 1e6 / onsetLatencyCount, 0, 'f', 2)
+                       .arg(onsetLatencyMax / 1e6, 0, 'f', 2)
+                       .arg(onsetLatencyCount);
+    }
+    if (inferenceCount > 0)
+    {
+        qInfo() << QString("Gesture inference: mean %1 us, max %2 us over %3 windows, %4 over budget, %5 skipped")
+                       .arg(inferenceTotal / 1e3 / inferenceCount, 0, 'f', 1)
+                       .arg(inferenceMax / 1e3, 0, 'f', 1)
+                       .arg(inferenceCount)
+                       .arg(inferenceOverBudget)
+                       .arg(inferenceSkipped);
+    }
+
     // Chage connection status
     connect_status = false;
 
@@ -161,6 +326,8 @@ void EMGWidget::read_data()
 
     // Fill the buffer with serial port data
     buffer.append(m_serial.readAll());
+    qint64 arrival = arrivalClock.nsecsElapsed();
+    qint32 firstSample = time_axis.size();
 
     while (buffer.size() >= PACKET_SIZE)
     {
@@ -185,6 +352,9 @@ void EMGWidget::read_data()
             buffer.remove(0, 1);
         }
     }
+
+    // Hand the new samples to the stream consumers
+    dispatchSamples(firstSample, arrival);
 }
 
 bool EMGWidget::isPacketValid(const QByteArray &buffer)
@@ -267,18 +437,26 @@ quint8 EMGWidget::findNextEMGHandle(const QByteArray &packet, quint32 startPos)
 void EMGWidget::processEMGData(const QByteArray &packet, quint32 emg_handle_pos, QStringList &emg_values)
 {
     QByteArray emg_bytes = packet.mid(emg_handle_pos + HANDLE_SIZE, EMG_VALUE_SIZE);
-    quint32 emg = VOLTAGE_COEFFICIENT * QByteArrayToInt(emg_bytes);
+    bool ok;
+    qint32 digits = QByteArrayToInt(emg_bytes, &ok);
+
+    // An undecodable value is missing, not a 0 that would read as a clipped sample and two jumps
+    double emg = ok ? double(quint32(VOLTAGE_COEFFICIENT * digits)) : qQNaN();
     emg_data[emg_handle_pos / (HANDLE_SIZE + EMG_VALUE_SIZE)].append(emg);
     emg_values << QString("EMG%1: %2").arg(emg_handle_pos / (HANDLE_SIZE + EMG_VALUE_SIZE) + 1).arg(emg);
 }
 
-qint32 EMGWidget::QByteArrayToInt(const QByteArray& bytes)
+qint32 EMGWidget::QByteArrayToInt(const QByteArray& bytes, bool *ok)
 {
     // Ensure the byte array represents a valid ASCII number
     QString str = QString::fromUtf8(bytes); // Convert bytes to QString (UTF-8)
-    bool ok;
-    quint32 number = str.toInt(&ok); // Convert QString to integer
-    return ok ? number : 0; // Return 0 if conversion fails
+    bool valid;
+    quint32 number = str.toInt(&valid); // Convert QString to integer
+    if (ok)
+    {
+        *ok = valid;
+    }
+    return valid ? number : 0; // Return 0 if conversion fails
 }
 
 void EMGWidget::plotEMGGraph(void)
@@ -289,7 +467,7 @@ void EMGWidget::plotEMGGraph(void)
     // Add graph for each EMG sensor
     for (quint8 i = 0; i < num_emg; i++)
     {
-        ui->customPlot->addGraph();
+        new TraceGraph(ui->customPlot->xAxis, ui->customPlot->yAxis, traceRasterizer);
 
         // Set color for each graph
         QColor color;
@@ -305,8 +483,8 @@ void EMGWidget::plotEMGGraph(void)
     ui->customPlot->yAxis->setLabel("Voltage");
 
     // Add x-axis ticks (time)
-    QSharedPointer<QCPAxisTickerDateTime> date_time_ticker(new QCPAxisTickerDateTime);
-    date_time_ticker->setDateTimeFormat("hh:mm:ss.zzz");
+    QSharedPointer<FastDateTimeTicker> date_time_ticker(new FastDateTimeTicker);
+    date_time_ticker->setDateTimeFormat(CLOCK_TIME_FORMAT);
     ui->customPlot->xAxis->setTicker(date_time_ticker);
 
     // Allow zooming in/out from axes and dragging
@@ -327,356 +505,2258 @@ void EMGWidget::plotEMGGraph(void)
     timer->start(updateIntervalMs);  // Use the update interval
 }
 
-void EMGWidget::setUpdateInterval(quint8 intervalMs)
+double EMGWidget::estimatedSampleRate(void) const
 {
-    if (intervalMs > 0)
+    // Average over the last samples, host time stamps arrive in bursts
+    qint32 count = qMin<qint32>(time_axis.size(), 1000);
+    if (count < 2)
     {
-        updateIntervalMs = intervalMs;
+        return 0;
+    }
+    double span = time_axis.last() - time_axis[time_axis.size() - count];
+    return span > 0 ? (count - 1) / span : 0;
+}
 
-        // If the timer is running, restart it with the new interval
-        QTimer *timer = findChild<QTimer*>();
-        if (timer)
+void EMGWidget::dispatchSamples(qint32 firstSample, qint64 arrival)
+{
+    qint32 count = time_axis.size() - firstSample;
+    if (count <= 0)
+    {
+        return;
+    }
+
+    // New rows of this read, a channel that missed a value is padded with NaN
+    RowBlock rows;
+    rows.clear(num_emg);
+    rows.times = time_axis.mid(firstSample);
+    for (quint8 c = 0; c < num_emg && c < emg_data.size(); ++c)
+    {
+        rows.channels[c] = emg_data[c].mid(firstSample, count);
+        while (rows.channels[c].size() < count)
         {
-            timer->stop();
-            timer->start(updateIntervalMs);
+            rows.channels[c].append(qQNaN());
         }
-
-        qDebug() << "Update interval set to:" << updateIntervalMs << "ms";
     }
-    else
+
+    // Continuous recording of the session
+    if (portOpened)
     {
-        qWarning() << "Invalid update interval:" << intervalMs;
+        if (!recorder)
+        {
+            startSessionRecording(firstSample == 0);
+        }
+        if (recorder)
+        {
+            recorder->append(rows);
+        }
     }
-}
-
-void EMGWidget::updateDeviceInfo(void)
-{
-    // Create a string with the device information
-    QString infoText = QString("Device ID: %1\nBattery: %2%\nMotor: %3")
-                           .arg(deviceID)
-                           .arg(batteryStatus)
-                           .arg(motorStatus ? "On" : "Off");
 
-    // Find or create the text element for displaying the information
-    QCPTextElement *infoElement = nullptr;
-    if (ui->customPlot->plotLayout()->elementCount() > 1)
+    // Uniform-rate copy of the session, rows come out once the board clock is fitted
+    if (uniformRecorder)
     {
-        infoElement = qobject_cast<QCPTextElement*>(ui->customPlot->plotLayout()->element(1, 0));
+        RowBlock uniform;
+        liveResampler.process(rows, uniform);
+        if (uniform.rowCount() > 0)
+        {
+            uniformRecorder->append(uniform);
+        }
     }
 
-    if (!infoElement)
+    // Saturation, flat line, line noise and loose electrodes, on the raw values
+    qualitySamples(rows);
+
+    // Filtered stream, kept next to the raw one for the plot and the recorder
+    RowBlock filtered;
+    filterSamples(rows, firstSample, filtered);
+    if (filteredRecorder)
     {
-        infoElement = new QCPTextElement(ui->customPlot, infoText, QFont("Helvetica", 10));
-        ui->customPlot->plotLayout()->insertRow(1); // Add a new row for the text
-        ui->customPlot->plotLayout()->addElement(1, 0, infoElement);
+        filteredRecorder->append(filtered);
     }
 
-    // Update the text with the latest information
-    infoElement->setText(infoText);
+    // Envelope of the filtered stream, computed once per sample as it arrives
+    RowBlock envelopeRows;
+    envelopeSamples(filtered, firstSample, envelopeRows);
 
-    // Refresh the plot
-    ui->customPlot->replot();
+    // Muscle activation onsets on the envelope
+    onsetSamples(envelopeRows, arrival);
+
+    // Classifier features of the filtered stream
+    featureSamples(filtered);
+
+    // Spectrogram of the selected channel
+    quint8 channel = spectrogram->channel();
+    if (spectrogram->isVisible() && channel < rows.channels.size())
+    {
+        spectrogram->setSampleRate(estimatedSampleRate());
+        spectrogram->appendSamples(rows.channels[channel].constData(), rows.times.constData(), count);
+    }
 }
 
+void EMGWidget::setupFilterChain(void)
+{
+    filterChain.clear();
+    filterChain.append(new DcRemovalStage);
+    if (bandPassEnabled)
+    {
+        filterChain.append(new BandPassStage(20, 450));
+    }
+    if (mainsFrequency > 0)
+    {
+        filterChain.append(new NotchStage(mainsFrequency));
+    }
+}
 
-void EMGWidget::refreshGraph(void)
+void EMGWidget::filterSamples(const RowBlock &rows, qint32 firstSample, RowBlock &filtered)
 {
-    double now = QDateTime::currentMSecsSinceEpoch() / 1000.0;  // Convert to seconds
-    if (connect_status)
+    // The filters need the sample rate, which is only measured after a few reads
+    if (!filterChain.isConfigured() || filterChain.channelCount() != num_emg)
     {
-        for (quint8 i = 0; i < num_emg; i++)
+        double sampleRate = estimatedSampleRate();
+        if (sampleRate > 0)
         {
-            ui->customPlot->graph(i)->setData(time_axis, emg_data[i]);
+            filterChain.configure(num_emg, sampleRate);
         }
+    }
 
-        if (((qint64)(now * 1000) - startTime) > SECONDS_SHOW_ON_GRAPH * 1000)
+    filtered = rows;
+    if (filterChain.isConfigured())
+    {
+        filterChain.process(filtered);
+    }
+    else
+    {
+        for (QVector<double> &column : filtered.channels)
         {
-            ui->customPlot->xAxis->setRange(now, SECONDS_SHOW_ON_GRAPH, Qt::AlignRight);
+            column.fill(qQNaN());
         }
-        ui->customPlot->replot();
     }
+
+    // Rows from before the acquisition (or before a channel appeared) have no filtered value
+    filteredData.resize(num_emg);
+    for (quint8 c = 0; c < num_emg; ++c)
+    {
+        QList<double> &column = filteredData[c];
+        if (column.size() != firstSample)
+        {
+            column.resize(firstSample, qQNaN());
+        }
+        column.append(filtered.channels[c]);
+    }
+}
+
+const QVector<QList<double>> &EMGWidget::plottedData(void) const
+{
+    // Falls back to the raw rows when there is no filtered copy of them (loaded files)
+    bool filteredValid = showFiltered && filteredData.size() == emg_data.size();
+    for (qint32 c = 0; filteredValid && c < filteredData.size(); ++c)
+    {
+        filteredValid = filteredData[c].size() == emg_data[c].size();
+    }
+    return filteredValid ? filteredData : emg_data;
 }
 
-void EMGWidget::saveDataToFile(const QString &filename)
+void EMGWidget::setupEnvelope(void)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    // The window is set in time, so it needs the sample rate measured by the filter chain
+    if (!filterChain.isConfigured())
     {
-        qWarning() << "Unable to open file for writing:" << file.errorString();
+        envelope = EnvelopeProcessor();
+        onsetDetector = OnsetDetector();
         return;
     }
+    quint32 windowSize = qMax(1, qRound(envelopeWindowMs * filterChain.sampleRate() / 1000));
+    envelope.configure(envelopeMethod, num_emg, windowSize);
+    qDebug() << "Envelope:" << EnvelopeProcessor::methodName(envelopeMethod) << "over" << windowSize << "samples";
 
-    QTextStream out(&file);
+    // A new envelope changes the rest level, so the detector calibrates again
+    setupOnsetDetector();
+}
 
-    out << "Time";
-    for (quint32 i = 0; i < num_emg; ++i)
+void EMGWidget::envelopeSamples(const RowBlock &filtered, qint32 firstSample, RowBlock &envelopeRows)
+{
+    if (!envelope.isConfigured() || envelope.channelCount() != num_emg)
     {
-        out << (filename.endsWith(".csv", Qt::CaseInsensitive) ? "," : "\t") << "EMG" << (i + 1);
+        setupEnvelope();
     }
-    out << "\n";
 
-    for (quint32 i = 0; i < time_axis.size(); ++i)
+    envelope.process(filtered, envelopeRows);
+    envelopeData.resize(num_emg);
+    for (quint8 c = 0; c < num_emg; ++c)
     {
-        out << time_axis_string[i];
-        for (quint32 j = 0; j < num_emg; ++j)
+        QList<double> &column = envelopeData[c];
+        if (column.size() != firstSample)
         {
-            out << (filename.endsWith(".csv", Qt::CaseInsensitive) ? "," : "\t") << emg_data[j][i];
+            column.resize(firstSample, qQNaN());
         }
-        out << "\n";
+        column.append(envelopeRows.channels[c]);
     }
-
-    file.close();
-    qInfo() << "Data saved to" << filename;
-
-    dataSaved = true;
-    portOpened = false;
-    saveDialogShown = false;
 }
 
-void EMGWidget::loadDataFromFile(const QString& filename)
+void EMGWidget::updateEnvelopeGraphs(void)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    // Only rows acquired while the envelope ran have one
+    bool valid = showEnvelope && envelopeData.size() == num_emg;
+    for (qint32 c = 0; valid && c < envelopeData.size(); ++c)
     {
-        qWarning() << "Unable to open file for reading:" << file.errorString();
-        return;
-    }
-
-    QTextStream in(&file);
-
-    // Clear previous data
-    time_axis.clear();
-    time_axis_string.clear();
-    for (quint32 i = 0; i < num_emg; ++i) {
-        emg_data[i].clear();
+        valid = envelopeData[c].size() == time_axis.size();
     }
 
-    QString line;
-
-    // Read and parse data from file
-    QString delimiter = filename.endsWith(".csv", Qt::CaseInsensitive) ? "," : "\t";
-
-    // Skip the header line
-    in.readLine();
-
-    while (!in.atEnd())
+    envelopeGraphs.removeAll(QPointer<QCPGraph>());
+    if (!valid)
     {
-        line = in.readLine();
-        QStringList fields = line.split(delimiter);
-        if (fields.size() >= (num_emg + 1))
+        for (QCPGraph *graph : std::as_const(envelopeGraphs))
         {
-            bool timeOk;
-            double time = QDateTime::fromString(fields[0], "hh:mm:ss.zzz").toMSecsSinceEpoch() / 1000.0;
-            if (time != -1)  // Check if time conversion was successful
-            {
-                time_axis.append(time);
-                time_axis_string.append(fields[0]);
-
-                bool allEmgOk = true;
-                QVector<double> emg_values(num_emg);
-                for (quint32 i = 0; i < num_emg; ++i) {
-                    bool emgOk;
-                    emg_values[i] = fields[i + 1].toDouble(&emgOk);
-                    allEmgOk = allEmgOk && emgOk;
-                }
-
-                if (allEmgOk) {
-                    for (quint32 i = 0; i < num_emg; ++i) {
-                        emg_data[i].append(emg_values[i]);
-                    }
-                }
-            }
+            ui->customPlot->removeGraph(graph);
         }
+        envelopeGraphs.clear();
+        return;
     }
 
-    file.close();
-
-    // Update the graph with the new data
-    updateGraph();
+    // Same hue as the channel, darker and thicker
+    while (envelopeGraphs.size() < num_emg)
+    {
+        qint32 c = envelopeGraphs.size();
+        QColor color = c < ui->customPlot->graphCount() ? ui->customPlot->graph(c)->pen().color().darker(150) : QColor(Qt::black);
+        TraceGraph *graph = new TraceGraph(ui->customPlot->xAxis, ui->customPlot->yAxis, traceRasterizer);
+        graph->setName(QString("EMG %1 envelope").arg(c + 1));
+        graph->setPen(QPen(color, 2));
+        graph->setBrush(Qt::NoBrush);
+        envelopeGraphs.append(graph);
+    }
+    for (quint8 c = 0; c < num_emg; ++c)
+    {
+        envelopeGraphs[c]->setData(time_axis, envelopeData[c]);
+    }
 }
 
-void EMGWidget::updateGraph()
+void EMGWidget::setupOnsetDetector(void)
 {
-    // Ensure the plot is cleared before adding new data
-    ui->customPlot->clearGraphs();
-
-    // Add a graph for each EMG channel and set the data
-    for (quint32 i = 0; i < num_emg; ++i)
+    // Window and calibration are set in time, like the envelope
+    if (!filterChain.isConfigured())
     {
-        ui->customPlot->addGraph();
-        ui->customPlot->graph(i)->setData(time_axis, emg_data[i]);
-
-        // Set different colors for each channel, for example:
-        QColor color;
-        color.setHsv(360/(i+1), 255, 255); // Saturation and value set to max (255) for full color
+        onsetDetector = OnsetDetector();
+        return;
+    }
+    double sampleRate = filterChain.sampleRate();
+    quint32 windowSize = qMax(1, qRound(onsetWindowMs * sampleRate / 1000));
+    quint32 calibration = qMax(2, qRound(ONSET_CALIBRATION_SECONDS * sampleRate));
+    onsetDetector.configure(num_emg, calibration, windowSize, (windowSize + 1) / 2, onsetThresholdSd);
+    qDebug() << "Onset detector:" << onsetThresholdSd << "SD over" << windowSize << "samples, calibrating on" << calibration << "samples";
+}
 
-        ui->customPlot->graph(i)->setPen(QPen(color));
+void EMGWidget::onsetSamples(const RowBlock &envelopeRows, qint64 arrival)
+{
+    if (!onsetEnabled || !onsetDetector.isConfigured())
+    {
+        return;
     }
 
-    // Adjust the axes ranges based on the new data
-    if (!time_axis.isEmpty())
+    QVector<OnsetEvent> events;
+    onsetDetector.process(envelopeRows, arrival, events);
+    if (events.isEmpty())
     {
-        ui->customPlot->xAxis->setRange(time_axis.first(), time_axis.last());
+        return;
+    }
 
-        double minY = std::numeric_limits<double>::max();
-        double maxY = std::numeric_limits<double>::min();
-        for (const auto& channelData : emg_data)
+    for (const OnsetEvent &event : std::as_const(events))
+    {
+        QString time = QDateTime::fromMSecsSinceEpoch(qRound64(event.time * 1000)).toString(CLOCK_TIME_FORMAT);
+        QString kind = event.onset ? "onset" : "offset";
+        qInfo() << QString("EMG%1 %2 at %3").arg(event.channel + 1).arg(kind, time);
+        if (onsetLog.isOpen())
         {
-            double channelMin = *std::min_element(channelData.begin(), channelData.end());
-            double channelMax = *std::max_element(channelData.begin(), channelData.end());
-            if (channelMin < minY) minY = channelMin;
-            if (channelMax > maxY) maxY = channelMax;
+            onsetLog.write(QString("%1,%2,%3\n").arg(time).arg(event.channel + 1).arg(kind).toLatin1());
         }
-        ui->customPlot->yAxis->setRange(minY, maxY);
+        addOnsetMarker(event);
+        pendingOnsetArrivals.append(event.arrival);
     }
+    onsetLog.flush();
 
-    // Replot the graph
-    ui->customPlot->replot();
+    // Draw the markers on the next event loop pass instead of waiting for the graph update
+    ui->customPlot->replot(QCustomPlot::rpQueuedReplot);
 }
 
-void EMGWidget::on_btn_ConnectDisconnect_clicked(void)
+void EMGWidget::addOnsetMarker(const OnsetEvent &event)
 {
-    double now;
-    // Connect if not-connected, disconnect if connected.
-    if(!connect_status)
+    // Vertical line in the channel colour, solid for an onset and dashed for an offset
+    QColor color = qint32(event.channel) < ui->customPlot->graphCount() ? ui->customPlot->graph(event.channel)->pen().color() : QColor(Qt::black);
+    QCPItemStraightLine *marker = new QCPItemStraightLine(ui->customPlot);
+    marker->point1->setCoords(event.time, 0);
+    marker->point2->setCoords(event.time, 1);
+    marker->setPen(QPen(color, 1, event.onset ? Qt::SolidLine : Qt::DashLine));
+    marker->setSelectable(false);
+    onsetMarkers.append(marker);
+
+    onsetMarkers.removeAll(QPointer<QCPAbstractItem>());
+    while (onsetMarkers.size() > MAX_ONSET_MARKERS)
     {
-        qInfo() << "Connecting...";
-
-        // Port configuration
-        portConfig();
-
-        // Select the COM Port from Combo Box
-        m_serial.setPortName(ui->cb_COMP->currentText());
-        if(m_serial.open(QIODevice::ReadWrite))
-        {
-            portConnect();
+        ui->customPlot->removeItem(onsetMarkers.takeFirst());
+    }
+}
 
-            startTime = QDateTime::currentSecsSinceEpoch();
-            now = startTime;
-            // set axes ranges, so we see all data:
-            ui->customPlot->xAxis->setRange(now, now+SECONDS_SHOW_ON_GRAPH*1000);
-            ui->customPlot->yAxis->setRange(0, 60);
-        }
-        else
+void EMGWidget::clearOnsetMarkers(void)
+{
+    for (QCPAbstractItem *marker : std::as_const(onsetMarkers))
+    {
+        if (marker)
         {
-            qDebug() << "Unable to open the Selected Serial Port" << m_serial.error();
-            QMessageBox::critical(this, "Error", "Unable to open the selected serial port. Please check if the device is connected and the port is available.");
+            ui->customPlot->removeItem(marker);
         }
     }
-    else
-    {
-        portDisconnect();
-    }
+    onsetMarkers.clear();
+    pendingOnsetArrivals.clear();
 }
 
-void EMGWidget::on_actionDevice_info_triggered()
+void EMGWidget::onsetMarkersRendered(void)
 {
-    if(deviceID.isEmpty()){
-        QMessageBox::information(this, "Device Info", "Device ID: Unavailable");
+    if (pendingOnsetArrivals.isEmpty())
+    {
+        return;
     }
-    else{
-    QMessageBox::information(this, "Device Info", "Device ID: " + deviceID);
+
+    // The replot has drawn every pending marker
+    qint64 now = arrivalClock.nsecsElapsed();
+    for (qint64 arrival : std::as_const(pendingOnsetArrivals))
+    {
+        qint64 latency = now - arrival;
+        onsetLatencyTotal += latency;
+        onsetLatencyMax = qMax(onsetLatencyMax, latency);
+        ++onsetLatencyCount;
     }
+    pendingOnsetArrivals.clear();
 }
 
-void EMGWidget::on_actionSave_triggered()
+FeatureSettings EMGWidget::featureSettings(double sampleRate) const
 {
-    if(connect_status){
-    portDisconnect();
+    FeatureSettings settings;
+    settings.windowSize = qMax(1, qRound(featureWindowMs * sampleRate / 1000));
+    settings.hop = qMax(1, qRound(featureHopMs * sampleRate / 1000));
+    settings.sampleRate = sampleRate;
+    settings.threshold = featureThreshold;
+    return settings;
+}
+
+void EMGWidget::featureSamples(const RowBlock &filtered)
+{
+    if (!featuresEnabled || !filterChain.isConfigured())
+    {
+        return;
     }
-    QString filename = QFileDialog::getSaveFileName(this, "Save Data", "", "Text Files (*.txt);;CSV Files (*.csv);;All Files (*)");
-    if (!filename.isEmpty())
+    if (!featureExtractor.isConfigured() || featureExtractor.channelCount() != num_emg)
     {
-        // Ensure the file has the correct extension
-        if (!filename.endsWith(".txt", Qt::CaseInsensitive) && !filename.endsWith(".csv", Qt::CaseInsensitive))
+        // Windows set in time, so they wait for the sample rate like the envelope
+        featureExtractor.configure(featureSettings(filterChain.sampleRate()), num_emg);
+        featureTable.clear(num_emg, featureExtractor.settings());
+        qDebug() << "Features over" << featureExtractor.settings().windowSize << "samples every" << featureExtractor.settings().hop;
+        if (classifier.isLoaded())
         {
-            // Default to .txt if no extension is provided
-            filename.append(".txt");
+            classifier.bind(featureTable.columnNames());
         }
-        saveDataToFile(filename);
     }
+    qint32 firstRow = featureTable.rowCount();
+    featureExtractor.process(filtered, featureTable);
+    classifyWindows(firstRow);
 }
 
-void EMGWidget::on_actionOpen_triggered(void)
+void EMGWidget::classifyWindows(qint32 firstRow)
 {
-    if(connect_status){
-        portDisconnect();
-    }
-
-    QString filename = QFileDialog::getOpenFileName(this, "Open Data", "", "Text Files (*.txt);;CSV Files (*.csv);;All Files (*)");
-    if (!filename.isEmpty())
+    const qint32 rowCount = featureTable.rowCount();
+    if (!classifier.isBound() || firstRow >= rowCount)
     {
-        loadDataFromFile(filename);
+        return;
     }
-}
+
+    // Every new window while the read is within budget, the newest one always
+    QElapsedTimer timer;
+    timer.start();
+    qint32 gesture = -1;
+    double confidence = 0;
+    for (qint32 row = firstRow; row < rowCount; ++row)
+    {
+        if (row < rowCount - 1 && timer.nsecsElapsed() > INFERENCE_BUDGET_NS)
+        {
+            ++inferenceSkipped;
+            continue;
+        }
+
+        qint64 start = timer.nsecsElapsed();
+        gesture = classifier.classify(featureTable.values.constData() + qsizetype(row) * featureTable.columnCount(), &confidence);
+        qint64 elapsed = timer.nsecsElapsed() - start;
+        inferenceTotal += elapsed;
+        inferenceMax = qMax(inferenceMax, elapsed);
+        ++inferenceCount;
+        if (elapsed > INFERENCE_BUDGET_NS)
+        {
+            ++inferenceOverBudget;
+        }
+    }
+
+    // Shown by the next device info update
+    QString text = gesture >= 0 ? QString("%1 (%2%)").arg(classifier.classes()[gesture]).arg(qRound(confidence * 100)) : QString();
+    if (gesture >= 0 && !gestureText.startsWith(classifier.classes()[gesture] + " "))
+    {
+        qDebug() << "Gesture:" << text;
+    }
+    gestureText = text;
+}
+
+void EMGWidget::qualitySamples(const RowBlock &rows)
+{
+    // Windows are set in time, so the checks start once the sample rate is measured
+    if (!qualityMonitor.isConfigured() || qualityMonitor.channelCount() != num_emg)
+    {
+        double sampleRate = estimatedSampleRate();
+        if (sampleRate > 0)
+        {
+            QualitySettings settings;
+            settings.fullScale = EMG_FULL_SCALE;
+            settings.varianceFloor = VOLTAGE_COEFFICIENT * VOLTAGE_COEFFICIENT;
+            settings.mainsFrequency = mainsFrequency;
+            qualityMonitor.configure(num_emg, sampleRate, settings);
+        }
+    }
+
+    // Only the running sums of the current window are touched, never the history
+    qualityMonitor.process(rows);
+}
+
+void EMGWidget::updateQualityIndicator(void)
+{
+    // One label per channel, restyled only when its verdict changes
+    while (qualityLabels.size() < num_emg)
+    {
+        QLabel *label = new QLabel(this);
+        statusBar()->addPermanentWidget(label);
+        qualityLabels.append(label);
+        shownQuality.append(-1);
+    }
+    while (qualityLabels.size() > num_emg)
+    {
+        delete qualityLabels.takeLast();
+        shownQuality.removeLast();
+    }
+
+    for (quint8 c = 0; c < num_emg; ++c)
+    {
+        SignalQualityMonitor::Verdict verdict;
+        if (qualityMonitor.isConfigured() && c < qualityMonitor.channelCount())
+        {
+            verdict = qualityMonitor.verdict(c);
+        }
+        QLabel *label = qualityLabels[c];
+        label->setToolTip(QString("RMS %1 %2\nClipped %3%\nLine noise %4% of the power\nJumps %5")
+                              .arg(verdict.rms, 0, 'f', 1)
+                              .arg(VOLTAGE_UNIT)
+                              .arg(verdict.clippedFraction * 100, 0, 'f', 1)
+                              .arg(verdict.lineRatio * 100, 0, 'f', 0)
+                              .arg(verdict.jumps));
+        if (shownQuality[c] == verdict.status)
+        {
+            continue;
+        }
+
+        QString color;
+        switch (verdict.status)
+        {
+        case SignalQualityMonitor::Good:
+            color = "#2e7d32";
+            break;
+        case SignalQualityMonitor::LineNoise:
+            color = "#ef6c00";
+            break;
+        case SignalQualityMonitor::Flat:
+            color = "#616161";
+            break;
+        case SignalQualityMonitor::Clipping:
+        case SignalQualityMonitor::ElectrodeOff:
+            color = "#c62828";
+            break;
+        default:
+            color = "#9e9e9e";
+            break;
+        }
+        QString status = SignalQualityMonitor::statusName(verdict.status);
+        label->setText(QString("EMG%1 %2").arg(c + 1).arg(status));
+        label->setStyleSheet(QString("QLabel { background: %1; color: white; padding: 1px 4px; }").arg(color));
+        if (shownQuality[c] > SignalQualityMonitor::Unknown || verdict.status != SignalQualityMonitor::Good)
+        {
+            if (verdict.status == SignalQualityMonitor::Good)
+            {
+                qInfo() << QString("EMG%1 signal: %2").arg(c + 1).arg(status);
+            }
+            else if (verdict.status != SignalQualityMonitor::Unknown)
+            {
+                qWarning() << QString("EMG%1 signal: %2").arg(c + 1).arg(status);
+            }
+        }
+        shownQuality[c] = verdict.status;
+    }
+}
+
+void EMGWidget::startSessionRecording(bool coversAll)
+{
+    QString dir = sessionDirectory();
+    QDir().mkpath(dir);
+
+    // The newest session may still be offered for recovery, the last one may still be saved from
+    QStringList keep;
+    const QFileInfoList sessions = QDir(dir).entryInfoList({QString("session-*") + RECORDING_EXTENSION}, QDir::Files, QDir::Time);
+    if (!sessions.isEmpty())
+    {
+        keep.append(sessions.first().absoluteFilePath());
+    }
+    if (!sessionFile.isEmpty())
+    {
+        keep.append(QFileInfo(sessionFile).absoluteFilePath());
+    }
+    pruneSessionDirectory(dir, keep);
+
+    // Every file of the session is named after the same stamp
+    const QString stamp = uniqueSessionStamp(dir);
+    QString filename = dir + "/session-" + stamp + RECORDING_EXTENSION;
+
+    recorder = new RecordingWriter(this);
+    if (!recorder->open(filename, num_emg, deviceID))
+    {
+        delete recorder;
+        recorder = nullptr;
+        return;
+    }
+
+    // Save can only move the file if nothing was acquired before the recording started
+    sessionFile = filename;
+    sessionCoversAll = coversAll;
+    qInfo() << "Recording session to" << filename;
+
+    // Not named session-*, so recovery only ever offers the raw stream
+    QString filteredName = dir + "/filtered-" + stamp + RECORDING_EXTENSION;
+    filteredRecorder = new RecordingWriter(this);
+    if (!filteredRecorder->open(filteredName, num_emg, deviceID))
+    {
+        delete filteredRecorder;
+        filteredRecorder = nullptr;
+    }
+
+    if (uniformRecording)
+    {
+        startUniformRecording();
+    }
+
+    // Onset events of the session, as time, channel, onset/offset, and its feature table once it ends
+    featureFile = dir + "/features-" + stamp + FEATURE_EXTENSION;
+    onsetLog.setFileName(dir + "/events-" + stamp + ".csv");
+    if (onsetLog.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        onsetLog.write("time,channel,event\n");
+    }
+    else
+    {
+        qWarning() << "Cannot write onset events to" << onsetLog.fileName();
+    }
+}
+
+void EMGWidget::stopSessionRecording(void)
+{
+    if (!recorder)
+    {
+        return;
+    }
+
+    recorder->close();
+    qInfo() << "Session recorded:" << recorder->rowsWritten() << "rows in" << recorder->fileName();
+    delete recorder;
+    recorder = nullptr;
+
+    if (filteredRecorder)
+    {
+        filteredRecorder->close();
+        qInfo() << "Filtered session recorded in" << filteredRecorder->fileName();
+        delete filteredRecorder;
+        filteredRecorder = nullptr;
+    }
+
+    stopUniformRecording();
+
+    if (onsetLog.isOpen())
+    {
+        onsetLog.close();
+        qInfo() << "Onset events recorded in" << onsetLog.fileName();
+    }
+
+    if (featureTable.rowCount() > 0 && writeFeatureFile(featureFile, featureTable))
+    {
+        qInfo() << "Session features:" << featureTable.rowCount() << "windows in" << featureFile;
+    }
+    featureTable.clear(featureTable.channelCount, featureTable.settings);
+}
+
+void EMGWidget::startUniformRecording(void)
+{
+    if (!recorder || uniformRecorder)
+    {
+        return;
+    }
+
+    // The cut-off follows the measured rate when there is one yet
+    double inputRate = estimatedSampleRate();
+    liveResampler.configure(num_emg, inputRate > 0 ? inputRate : uniformRate, uniformRate);
+
+    QFileInfo session(recorder->fileName());
+    QString filename = session.path() + "/uniform-" + session.fileName().mid(QString("session-").size());
+    uniformRecorder = new RecordingWriter(this);
+    if (!uniformRecorder->open(filename, num_emg, deviceID, uniformRate))
+    {
+        delete uniformRecorder;
+        uniformRecorder = nullptr;
+        return;
+    }
+    qInfo() << "Recording the session at" << uniformRate << "Hz to" << filename;
+}
+
+void EMGWidget::stopUniformRecording(void)
+{
+    if (!uniformRecorder)
+    {
+        return;
+    }
+
+    uniformRecorder->close();
+    const DriftClock &clock = liveResampler.clock();
+    qInfo() << QString("Uniform-rate session: %1 rows at %2 Hz in %3, board clock %4 Hz")
+                   .arg(uniformRecorder->rowsWritten())
+                   .arg(uniformRate)
+                   .arg(uniformRecorder->fileName())
+                   .arg(clock.rate(), 0, 'f', 3);
+    delete uniformRecorder;
+    uniformRecorder = nullptr;
+}
+
+void EMGWidget::forgetSessionRecording(void)
+{
+    // The recording no longer matches the data in memory, it stays on disk
+    sessionFile.clear();
+    sessionCoversAll = false;
+}
+
+void EMGWidget::offerSessionRecovery(void)
+{
+    // Only the last session can have been interrupted, older ones were closed when the next one started
+    const QFileInfoList sessions = QDir(sessionDirectory()).entryInfoList({QString("session-*") + RECORDING_EXTENSION}, QDir::Files, QDir::Time);
+    if (sessions.isEmpty())
+    {
+        return;
+    }
+    const QString filename = sessions.first().absoluteFilePath();
+    const QString recorded = sessions.first().lastModified().toString("yyyy-MM-dd hh:mm:ss");
+
+    // Another instance may be recording it right now, its lock is held until it closes the file
+    QLockFile lock(RecordingWriter::lockFileName(filename));
+    if (!lock.tryLock(0))
+    {
+        qInfo() << "Session" << filename << "is being recorded by another instance";
+        return;
+    }
+
+    qint64 rowCount;
+    {
+        BinaryRecordingSource source;
+        if (!source.open(filename) || !source.isRecovered())
+        {
+            return;
+        }
+        rowCount = source.rowCount();
+    }
+
+    // Closed whatever the answer, so it is only offered once and then opens from its index
+    if (!repairRecordingFile(filename) || rowCount == 0)
+    {
+        return;
+    }
+
+    auto reply = QMessageBox::question(this, "Recover Session",
+                                       QString("The session recorded until %1 was not closed properly. Recover its %2 rows?")
+                                           .arg(recorded).arg(rowCount),
+                                       QMessageBox::Yes | QMessageBox::No);
+    if (reply == QMessageBox::Yes)
+    {
+        loadRecordingFile(filename);
+    }
+    else
+    {
+        qInfo() << "Interrupted session kept in" << filename;
+    }
+}
+
+void EMGWidget::setUpdateInterval(quint8 intervalMs)
+{
+    if (intervalMs > 0)
+    {
+        updateIntervalMs = intervalMs;
+
+        // If the timer is running, restart it with the new interval
+        QTimer *timer = findChild<QTimer*>();
+        if (timer)
+        {
+            timer->stop();
+            timer->start(updateIntervalMs);
+        }
+
+        qDebug() << "Update interval set to:" << updateIntervalMs << "ms";
+    }
+    else
+    {
+        qWarning() << "Invalid update interval:" << intervalMs;
+    }
+}
+
+void EMGWidget::updateDeviceInfo(void)
+{
+    // Create a string with the device information
+    QString infoText = QString("Device ID: %1\nBattery: %2%\nMotor: %3")
+                           .arg(deviceID)
+                           .arg(batteryStatus)
+                           .arg(motorStatus ? "On" : "Off");
+    if (classifier.isLoaded())
+    {
+        infoText += "\nGesture: " + (gestureText.isEmpty() ? QString("-") : gestureText);
+    }
+
+    // Find or create the text element for displaying the information
+    QCPTextElement *infoElement = nullptr;
+    if (ui->customPlot->plotLayout()->elementCount() > 1)
+    {
+        infoElement = qobject_cast<QCPTextElement*>(ui->customPlot->plotLayout()->element(1, 0));
+    }
+
+    if (!infoElement)
+    {
+        infoElement = new QCPTextElement(ui->customPlot, infoText, QFont("Helvetica", 10));
+        ui->customPlot->plotLayout()->insertRow(1); // Add a new row for the text
+        ui->customPlot->plotLayout()->addElement(1, 0, infoElement);
+    }
+
+    // Update the text with the latest information
+    infoElement->setText(infoText);
+
+    // Refresh the plot
+    ui->customPlot->replot();
+}
+
+
+void EMGWidget::refreshGraph(void)
+{
+    double now = QDateTime::currentMSecsSinceEpoch() / 1000.0;  // Convert to seconds
+    if (connect_status)
+    {
+        const QVector<QList<double>> &data = plottedData();
+        for (quint8 i = 0; i < num_emg; i++)
+        {
+            ui->customPlot->graph(i)->setData(time_axis, data[i]);
+        }
+        updateEnvelopeGraphs();
+        updateQualityIndicator();
+
+        if (((qint64)(now * 1000) - startTime) > SECONDS_SHOW_ON_GRAPH * 1000)
+        {
+            ui->customPlot->xAxis->setRange(now, SECONDS_SHOW_ON_GRAPH, Qt::AlignRight);
+        }
+        ui->customPlot->replot();
+    }
+}
+
+bool EMGWidget::saveDataToFile(const QString &filename)
+{
+    // Snapshot of the rows (shared, not copied), acquisition goes on while the file is written
+    QList<QString> times = time_axis_string;
+    QVector<QList<double>> channels = emg_data;
+    quint32 channelCount = num_emg;
+
+    QElapsedTimer timer;
+    timer.start();
+    return startFileJob("Saving " + QFileInfo(filename).fileName(), true,
+        [filename, times, channels, channelCount](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            return writeTextRecording(filename, times, channels, channelCount, cancel, progress);
+        },
+        [this, filename, timer](bool ok) {
+            if (!ok)
+            {
+                qInfo() << "Saving" << filename << "cancelled or failed";
+                return;
+            }
+            qInfo() << "Data saved to" << filename << "in" << timer.elapsed() << "ms";
+            markDataSaved();
+        });
+}
+
+void EMGWidget::loadDataFromFile(const QString& filename)
+{
+    closeRecording();
+    forgetSessionRecording();
+
+    // Parsed on the thread pool, the plot keeps its data until the whole file is loaded
+    QSharedPointer<TextImport> import(new TextImport);
+    QElapsedTimer timer;
+    timer.start();
+    startFileJob("Loading " + QFileInfo(filename).fileName(), false,
+        [filename, import](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            return readTextRecording(filename, *import, cancel, progress);
+        },
+        [this, filename, import, timer](bool ok) {
+            if (!ok)
+            {
+                qInfo() << "Loading" << filename << "cancelled or failed";
+                return;
+            }
+            if (connect_status)
+            {
+                qWarning() << "Acquisition started while loading, discarding" << filename;
+                return;
+            }
+
+            if (import->channelCount() > UINT8_MAX)
+            {
+                qWarning() << "Too many channels in" << filename << ":" << import->channelCount();
+                return;
+            }
+
+            // Published in one step, with the channels of the file
+            num_emg = import->channelCount();
+            time_axis = import->rows.times;
+            time_axis_string = import->timeStrings;
+            emg_data = QVector<QList<double>>(num_emg);
+            for (quint32 i = 0; i < num_emg; ++i)
+            {
+                emg_data[i] = import->rows.channels[i];
+            }
+            filteredData.clear();
+            envelopeData.clear();
+            clearOnsetMarkers();
+            qInfo() << "Loaded" << time_axis.size() << "rows of" << num_emg << "channels from" << filename << "in" << timer.elapsed() << "ms";
+            if (!import->invalidRows.isEmpty())
+            {
+                qInfo() << "First row with invalid values:" << import->invalidRows.first();
+            }
+
+            // Update the graph with the new data
+            updateGraph();
+        });
+}
+
+bool EMGWidget::startFileJob(const QString &label, bool isSave, const FileJob::Work &work, const std::function<void(bool)> &done)
+{
+    if (fileJob)
+    {
+        qWarning() << "Another file operation is still running";
+        return false;
+    }
+
+    // Saves are completed even if the window closes, loads are cancelled
+    fileJob = new FileJob(label, isSave, this);
+    connect(fileJob, &FileJob::finished, this, [this, done](bool ok) {
+        fileJob->deleteLater();
+        fileJob = nullptr;
+        done(ok);
+    });
+    fileJob->start(work);
+    return true;
+}
+
+void EMGWidget::markDataSaved(void)
+{
+    // Rows acquired while saving are not in the file
+    if (connect_status)
+    {
+        return;
+    }
+
+    dataSaved = true;
+    portOpened = false;
+    saveDialogShown = false;
+}
+
+void EMGWidget::updateGraph()
+{
+    // Ensure the plot is cleared before adding new data
+    ui->customPlot->clearGraphs();
+
+    // Add a graph for each EMG channel and set the data
+    for (quint32 i = 0; i < num_emg; ++i)
+    {
+        new TraceGraph(ui->customPlot->xAxis, ui->customPlot->yAxis, traceRasterizer);
+        ui->customPlot->graph(i)->setData(time_axis, plottedData()[i]);
+
+        // Set different colors for each channel, for example:
+        QColor color;
+        color.setHsv(360/(i+1), 255, 255); // Saturation and value set to max (255) for full color
+
+        ui->customPlot->graph(i)->setPen(QPen(color));
+    }
+
+    // Adjust the axes ranges based on the new data
+    if (!time_axis.isEmpty())
+    {
+        ui->customPlot->xAxis->setRange(time_axis.first(), time_axis.last());
+
+        double minY = std::numeric_limits<double>::max();
+        double maxY = std::numeric_limits<double>::min();
+        for (const auto& channelData : emg_data)
+        {
+            double channelMin = *std::min_element(channelData.begin(), channelData.end());
+            double channelMax = *std::max_element(channelData.begin(), channelData.end());
+            if (channelMin < minY) minY = channelMin;
+            if (channelMax > maxY) maxY = channelMax;
+        }
+        ui->customPlot->yAxis->setRange(minY, maxY);
+    }
+
+    // Replot the graph
+    ui->customPlot->replot();
+}
+
+void EMGWidget::on_btn_ConnectDisconnect_clicked(void)
+{
+    double now;
+    // Connect if not-connected, disconnect if connected.
+    if(!connect_status)
+    {
+        qInfo() << "Connecting...";
+
+        // Port configuration
+        portConfig();
+
+        // Select the COM Port from Combo Box
+        m_serial.setPortName(ui->cb_COMP->currentText());
+        if(m_serial.open(QIODevice::ReadWrite))
+        {
+            closeRecording();
+            portConnect();
+
+            startTime = QDateTime::currentSecsSinceEpoch();
+            now = startTime;
+            // set axes ranges, so we see all data:
+            ui->customPlot->xAxis->setRange(now, now+SECONDS_SHOW_ON_GRAPH*1000);
+            ui->customPlot->yAxis->setRange(0, 60);
+        }
+        else
+        {
+            qDebug() << "Unable to open the Selected Serial Port" << m_serial.error();
+            QMessageBox::critical(this, "Error", "Unable to open the selected serial port. Please check if the device is connected and the port is available.");
+        }
+    }
+    else
+    {
+        portDisconnect();
+    }
+}
+
+void EMGWidget::on_actionDevice_info_triggered()
+{
+    if(deviceID.isEmpty()){
+        QMessageBox::information(this, "Device Info", "Device ID: Unavailable");
+    }
+    else{
+    QMessageBox::information(this, "Device Info", "Device ID: " + deviceID);
+    }
+}
+
+void EMGWidget::on_actionSave_triggered()
+{
+    saveData();
+}
+
+bool EMGWidget::saveData(void)
+{
+    if (fileJob)
+    {
+        qWarning() << "Another file operation is still running";
+        return false;
+    }
+
+    // Acquisition is not stopped, the file holds the rows up to now
+    const QString compressedFilter = "Compressed ArmBionics Recordings (*.armb)";
+    QString selectedFilter;
+    QString filename = QFileDialog::getSaveFileName(this, "Save Data", "", "Text Files (*.txt);;CSV Files (*.csv);;ArmBionics Recordings (*.armb);;"
+                                                    + compressedFilter + ";;EDF+ Files (*.edf);;BDF+ Files (*.bdf);;All Files (*)", &selectedFilter);
+    if (!filename.isEmpty())
+    {
+        // Ensure the file has the correct extension
+        if (!filename.endsWith(".txt", Qt::CaseInsensitive) && !filename.endsWith(".csv", Qt::CaseInsensitive)
+            && !filename.endsWith(RECORDING_EXTENSION, Qt::CaseInsensitive)
+            && !filename.endsWith(EDF_EXTENSION, Qt::CaseInsensitive) && !filename.endsWith(BDF_EXTENSION, Qt::CaseInsensitive))
+        {
+            // Default to .txt if no extension is provided
+            filename.append(".txt");
+        }
+
+        if (filename.endsWith(RECORDING_EXTENSION, Qt::CaseInsensitive))
+        {
+            return saveRecordingFile(filename, selectedFilter == compressedFilter);
+        }
+        else if (filename.endsWith(EDF_EXTENSION, Qt::CaseInsensitive) || filename.endsWith(BDF_EXTENSION, Qt::CaseInsensitive))
+        {
+            return saveEdfFile(filename, filename.endsWith(BDF_EXTENSION, Qt::CaseInsensitive));
+        }
+        else
+        {
+            return saveDataToFile(filename);
+        }
+    }
+    return false;
+}
+
+bool EMGWidget::saveRecordingFile(const QString &filename, bool compressed)
+{
+    // The session file is raw, a compressed copy is written from memory
+    if (!compressed && sessionCoversAll && !recorder && QFile::exists(sessionFile))
+    {
+        // The session is already on disk, move it instead of writing it again
+        QFile::remove(filename);
+        if (QFile::rename(sessionFile, filename) || QFile::copy(sessionFile, filename))
+        {
+            qInfo() << "Session moved to" << filename;
+            forgetSessionRecording();
+            markDataSaved();
+            return true;
+        }
+        qWarning() << "Unable to move the session file, writing it again";
+    }
+
+    // Snapshot of the rows held in memory
+    RowBlock rows;
+    rows.clear(num_emg);
+    rows.times = time_axis;
+    for (quint32 c = 0; c < num_emg && c < quint32(emg_data.size()); ++c)
+    {
+        rows.channels[c] = emg_data[c];
+    }
+    quint32 channelCount = num_emg;
+    QString device = deviceID;
+
+    return startFileJob("Saving " + QFileInfo(filename).fileName(), true,
+        [filename, rows, channelCount, device, compressed](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            RecordingWriter writer;
+            writer.setCompressed(compressed);
+            if (!writer.open(filename, channelCount, device))
+            {
+                return false;
+            }
+
+            // Handed over block by block, at most two ahead of the writer, so progress follows what is on disk
+            const qint32 blockRows = 65536;
+            const qint32 rowCount = rows.rowCount();
+            for (qint32 first = 0; first < rowCount && !cancel; first += blockRows)
+            {
+                RowBlock block;
+                block.times = rows.times.mid(first, blockRows);
+                for (const QVector<double> &channel : rows.channels)
+                {
+                    block.channels.append(channel.mid(first, blockRows));
+                }
+                writer.append(block);
+                while (!cancel && writer.rowsWritten() + 2 * blockRows < first + block.rowCount())
+                {
+                    QThread::msleep(5);
+                }
+                progress(int(writer.rowsWritten() * 100 / qMax(1, rowCount)));
+            }
+            writer.close();
+            if (cancel || writer.rowsWritten() != rowCount)
+            {
+                QFile::remove(filename);
+                return false;
+            }
+            return true;
+        },
+        [this, filename](bool ok) {
+            if (!ok)
+            {
+                qInfo() << "Saving" << filename << "cancelled or failed";
+                return;
+            }
+            qInfo() << "Data saved to" << filename;
+            markDataSaved();
+        });
+}
+
+bool EMGWidget::saveEdfFile(const QString &filename, bool bdf)
+{
+    if (time_axis.size() < 2 || time_axis.last() <= time_axis.first())
+    {
+        qWarning() << "Not enough data for an EDF/BDF export";
+        return false;
+    }
+
+    // Snapshot of the rows, EDF has a fixed sample rate so the time stamps only give the start and the rate
+    QVector<QList<double>> channels = emg_data;
+    channels.resize(num_emg);
+    quint32 channelCount = num_emg;
+    QString device = deviceID;
+    double startTime = time_axis.first();
+    double sampleRate = (time_axis.size() - 1) / (time_axis.last() - time_axis.first());
+    qint32 rowCount = time_axis.size();
+
+    return startFileJob("Exporting " + QFileInfo(filename).fileName(), true,
+        [filename, bdf, channels, channelCount, device, startTime, sampleRate, rowCount](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            // Range of the device, widened to the data if needed
+            double minimum = 0;
+            double maximum = EMG_FULL_SCALE;
+            for (const QList<double> &channel : channels)
+            {
+                for (double value : channel)
+                {
+                    if (value < minimum) minimum = value;
+                    if (value > maximum) maximum = value;
+                }
+            }
+
+            EdfWriter writer;
+            if (!writer.open(filename, bdf, channelCount, sampleRate, startTime, device, minimum, maximum))
+            {
+                return false;
+            }
+
+            const qint32 blockRows = 65536;
+            for (qint32 first = 0; first < rowCount; first += blockRows)
+            {
+                RowBlock rows;
+                rows.clear(channelCount);
+                rows.times.resize(qMin(blockRows, rowCount - first));
+                for (quint32 c = 0; c < channelCount; ++c)
+                {
+                    rows.channels[c] = channels[c].mid(first, rows.rowCount());
+                }
+                if (!writer.append(rows) || cancel)
+                {
+                    writer.close();
+                    QFile::remove(filename);
+                    return false;
+                }
+                progress(int((first + rows.rowCount()) * 100LL / rowCount));
+            }
+            return writer.close();
+        },
+        [this, filename, sampleRate](bool ok) {
+            if (!ok)
+            {
+                qInfo() << "Exporting" << filename << "cancelled or failed";
+                return;
+            }
+            qInfo() << "Data exported to" << filename << "at" << sampleRate << "Hz";
+            markDataSaved();
+        });
+}
+
+void EMGWidget::loadRecordingFile(const QString &filename)
+{
+    closeRecording();
+    forgetSessionRecording();
+
+    struct Loaded
+    {
+        RecordingHeader header;
+        RowBlock rows;
+        QList<QString> timeStrings;
+    };
+    QSharedPointer<Loaded> loaded(new Loaded);
+
+    startFileJob("Loading " + QFileInfo(filename).fileName(), false,
+        [filename, loaded](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            // Reading is the first half of the work
+            if (!readRecordingFile(filename, loaded->header, loaded->rows, cancel, [&progress](int percent) { progress(percent / 2); }))
+            {
+                return false;
+            }
+
+            // Time strings for text export, local offset taken once for the whole recording
+            const QVector<double> &times = loaded->rows.times;
+            loaded->timeStrings.reserve(times.size());
+            if (!times.isEmpty())
+            {
+                qint64 offset = qint64(QDateTime::fromMSecsSinceEpoch(qRound64(times.first() * 1000)).offsetFromUtc()) * 1000;
+                for (double time : times)
+                {
+                    loaded->timeStrings.append(clockTimeToString(qRound64(time * 1000) + offset));
+                }
+            }
+            return !cancel;
+        },
+        [this, filename, loaded](bool ok) {
+            if (!ok)
+            {
+                qInfo() << "Loading" << filename << "cancelled or failed";
+                return;
+            }
+            if (connect_status)
+            {
+                qWarning() << "Acquisition started while loading, discarding" << filename;
+                return;
+            }
+
+            // Published in one step
+            const RecordingHeader &header = loaded->header;
+            num_emg = header.channelCount;
+            emg_data = QVector<QList<double>>(num_emg);
+            for (quint32 c = 0; c < num_emg; ++c)
+            {
+                emg_data[c] = loaded->rows.channels[c];
+            }
+            filteredData.clear();
+            envelopeData.clear();
+            clearOnsetMarkers();
+            time_axis = loaded->rows.times;
+            time_axis_string = loaded->timeStrings;
+            deviceID = QString::fromLatin1(header.deviceId, qstrnlen(header.deviceId, sizeof(header.deviceId)));
+
+            qInfo() << "Loaded" << time_axis.size() << "rows from" << filename;
+            updateGraph();
+        });
+}
+
+void EMGWidget::on_actionOpen_triggered(void)
+{
+    if (fileJob)
+    {
+        qWarning() << "Another file operation is still running";
+        return;
+    }
+
+    if(connect_status){
+        portDisconnect();
+    }
+
+    QString filename = QFileDialog::getOpenFileName(this, "Open Data", "", "Text Files (*.txt);;CSV Files (*.csv);;ArmBionics Recordings (*.armb);;"
+                                                    "EDF/BDF Files (*.edf *.bdf);;All Files (*)");
+    if (!filename.isEmpty())
+    {
+        // Big or already indexed recordings and EDF/BDF files are streamed from disk instead of loaded
+        if (QFileInfo(filename).size() > LAZY_LOAD_THRESHOLD || QFile::exists(RecordingIndex::sidecarFileName(filename))
+            || filename.endsWith(EDF_EXTENSION, Qt::CaseInsensitive) || filename.endsWith(BDF_EXTENSION, Qt::CaseInsensitive))
+        {
+            openRecording(filename);
+        }
+        else if (filename.endsWith(RECORDING_EXTENSION, Qt::CaseInsensitive))
+        {
+            loadRecordingFile(filename);
+        }
+        else
+        {
+            loadDataFromFile(filename);
+        }
+    }
+}
+
+void EMGWidget::openRecording(const QString &filename)
+{
+    closeRecording();
+
+    // Native recordings and EDF/BDF files are mapped, text files are indexed line by line
+    RecordingSource *source = nullptr;
+    if (filename.endsWith(RECORDING_EXTENSION, Qt::CaseInsensitive))
+    {
+        BinaryRecordingSource *binary = new BinaryRecordingSource;
+        if (binary->open(filename))
+        {
+            source = binary;
+        }
+        else
+        {
+            delete binary;
+        }
+    }
+    else if (filename.endsWith(EDF_EXTENSION, Qt::CaseInsensitive) || filename.endsWith(BDF_EXTENSION, Qt::CaseInsensitive))
+    {
+        EdfRecordingSource *edf = new EdfRecordingSource;
+        if (edf->open(filename))
+        {
+            source = edf;
+        }
+        else
+        {
+            delete edf;
+        }
+    }
+    else
+    {
+        TextRecordingSource *text = new TextRecordingSource;
+        if (text->open(filename))
+        {
+            source = text;
+        }
+        else
+        {
+            delete text;
+        }
+    }
+
+    if (!source)
+    {
+        qWarning() << "Unable to open recording:" << filename;
+        return;
+    }
+
+    // Graph i shows channel i of the recording
+    num_emg = source->channelCount();
+    emg_data.resize(num_emg);
+    on_actionClear_plot_triggered();
+
+    recordingViewer = new RecordingViewer(ui->customPlot, source, this);
+    recordingViewer->open();
+    qInfo() << "Opened" << filename << "in viewer mode," << num_emg << "channels";
+}
+
+void EMGWidget::closeRecording(void)
+{
+    if (recordingViewer)
+    {
+        delete recordingViewer;
+        recordingViewer = nullptr;
+        qDebug() << "Recording viewer closed.";
+    }
+}
 
 void EMGWidget::on_sensorNumber_triggered()
 {
-    auto_num = false;
+    auto_num = false;
+
+    // Do not allow changes in connected state
+    portDisconnect();
+
+    // Clear data before changing dimensions
+    on_actionClear_plot_triggered();
+
+    bool ok;
+    quint8 numSensors = QInputDialog::getInt(this, tr("Set Number of Sensors"),
+                                             tr("Number of Sensors:"), num_emg, 1, 100, 1, &ok);
+
+    if (numSensors != num_emg)
+    {
+        num_emg = numSensors;
+
+        // Clear previous data
+        emg_data.resize(num_emg);
+        for (quint32 i = 0; i < num_emg; ++i) {
+            emg_data[i].clear();
+        }
+        plotEMGGraph();
+    }
+}
+
+void EMGWidget::on_actionPlot_color_triggered()
+{
+    // Create a dialog to select the graph to change the color
+    bool ok;
+    QStringList graphNames;
+    for (quint32 i = 0; i < ui->customPlot->graphCount() && i < num_emg; ++i) { // Envelope graphs follow the channels
+        graphNames << QString("EMG %1").arg(i + 1);
+    }
+
+    QString selectedGraphName = QInputDialog::getItem(this, "Select Graph", "Choose the graph to change color:", graphNames, 0, false, &ok);
+    if (!ok || selectedGraphName.isEmpty()) {
+        qDebug() << "Color change canceled.";
+        return;
+    }
+
+    // Determine the index of the selected graph
+    quint32 graphIndex = graphNames.indexOf(selectedGraphName);
+
+    // Open a color dialog and get the selected color
+    QColor newColor = QColorDialog::getColor(Qt::black, this, "Select Plot Color"); // Default color is black
+
+    // Check if the user clicked "OK" and a valid color was selected
+    if (newColor.isValid())
+    {
+        // Update the plot color for the selected graph
+        if (graphIndex >= 0 && graphIndex < ui->customPlot->graphCount())
+        {
+            ui->customPlot->graph(graphIndex)->setPen(QPen(newColor));
+            ui->customPlot->replot(); // Refresh the plot
+            qDebug() << QString("Graph %1 color changed to: %2").arg(graphIndex + 1).arg(newColor.name()); // Log the new color
+        }
+        else
+        {
+            qWarning() << "Invalid graph index:" << graphIndex;
+        }
+    }
+    else
+    {
+        qDebug() << "Color change canceled or invalid color selected.";
+    }
+}
+
+void EMGWidget::on_actionBenchmark_rendering_triggered(void)
+{
+    const quint32 frames = 20;
+    const quint32 samples = 100000;
+
+    // Use synthetic traces if nothing has been acquired or loaded yet
+    bool synthetic = time_axis.isEmpty();
+    if (synthetic)
+    {
+        QVector<double> keys(samples);
+        double start = QDateTime::currentMSecsSinceEpoch() / 1000.0;
+        for (quint32 i = 0; i < samples; ++i)
+        {
+            keys[i] = start + i / 1000.0;
+        }
+        for (quint32 j = 0; j < ui->customPlot->graphCount(); ++j)
+        {
+            QVector<double> values(samples);
+            for (quint32 i = 0; i < samples; ++i)
+            {
+                values[i] = 30 + 20 * qSin(i * 0.05 + j) + QRandomGenerator::global()->bounded(10.0);
+            }
+            ui->customPlot->graph(j)->setData(keys, values, true);
+        }
+        ui->customPlot->xAxis->setRange(keys.first(), keys.last());
+        ui->customPlot->yAxis->setRange(0, 60);
+    }
+
+    // Average time of a full replot with the serial or the parallel trace path
+    auto measure = [this, frames](bool parallel) {
+        traceRasterizer->setEnabled(parallel);
+        QElapsedTimer timer;
+        timer.start();
+        for (quint32 i = 0; i < frames; ++i)
+        {
+            ui->customPlot->replot(QCustomPlot::rpImmediateRefresh);
+        }
+        return timer.nsecsElapsed() / 1e6 / frames;
+    };
+
+    double serialMs = measure(false);
+    double parallelMs = measure(true);
+
+    qInfo() << QString("Render benchmark (%1 channels, %2 threads): serial %3 ms/frame, parallel %4 ms/frame, speedup x%5")
+                   .arg(ui->customPlot->graphCount())
+                   .arg(QThreadPool::globalInstance()->maxThreadCount())
+                   .arg(serialMs, 0, 'f', 2)
+                   .arg(parallelMs, 0, 'f', 2)
+                   .arg(serialMs / qMax(parallelMs, 1e-6), 0, 'f', 2);
+
+    if (synthetic)
+    {
+        on_actionClear_plot_triggered();
+    }
+}
+
+void EMGWidget::on_actionBenchmark_file_formats_triggered(void)
+{
+    // Snapshot of the current data (shared, not copied), the benchmark runs on the thread pool
+    QList<QString> times = time_axis_string;
+    QVector<QList<double>> channels = emg_data;
+    QList<double> timeAxis = time_axis;
+    quint32 channelCount = num_emg;
+    QString device = deviceID;
+
+    startFileJob("Benchmarking file formats", false,
+        [times, channels, timeAxis, channelCount, device](const std::atomic_bool &cancel, const std::function<void(int)> &progress) mutable {
+            const quint32 samples = 200000;
+
+            // Current data, or synthetic traces with the resolution of the device
+            channels.resize(channelCount);
+            RowBlock rows;
+            rows.clear(channelCount);
+            rows.times = timeAxis;
+            if (timeAxis.isEmpty())
+            {
+                qint64 start = QDateTime::currentMSecsSinceEpoch();
+                qint64 offset = qint64(QDateTime::currentDateTime().offsetFromUtc()) * 1000;
+                for (quint32 i = 0; i < samples; ++i)
+                {
+                    rows.times.append((start + i) / 1000.0);
+                    times.append(clockTimeToString(start + i + offset));
+                }
+                for (quint32 j = 0; j < channelCount; ++j)
+                {
+                    channels[j].clear();
+                    for (quint32 i = 0; i < samples; ++i)
+                    {
+                        channels[j].append(qRound(300 + 200 * qSin(i * 0.05 + j) + QRandomGenerator::global()->bounded(100.0)));
+                    }
+                }
+            }
+            for (quint32 j = 0; j < channelCount; ++j)
+            {
+                rows.channels[j] = channels[j];
+            }
+
+            const QString dir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+            const double rawMB = rows.rowCount() * (channelCount + 1) * sizeof(double) / 1e6;
+
+            // Size, write and read speed (MB/s of raw samples) of one format
+            auto report = [rawMB](const QString &name, const QString &file, double writeMs, double readMs) {
+                const qint64 size = QFileInfo(file).size();
+                qInfo() << QString("%1: %2 MB, ratio x%3 vs raw, write %4 MB/s, read %5 MB/s")
+                               .arg(name)
+                               .arg(size / 1e6, 0, 'f', 2)
+                               .arg(rawMB * 1e6 / qMax<qint64>(size, 1), 0, 'f', 2)
+                               .arg(rawMB / qMax(writeMs, 1e-3) * 1000, 0, 'f', 0)
+                               .arg(rawMB / qMax(readMs, 1e-3) * 1000, 0, 'f', 0);
+                QFile::remove(file);
+            };
+
+            QElapsedTimer timer;
+            const QString text = dir + "/armbionics-benchmark.txt";
+            timer.start();
+            bool ok = writeTextRecording(text, times, channels, channelCount, cancel);
+            double writeMs = timer.nsecsElapsed() / 1e6;
+            TextImport import;
+            timer.restart();
+            ok = ok && readTextRecording(text, import, cancel);
+            if (!ok)
+            {
+                QFile::remove(text);
+                return false;
+            }
+            report("Text", text, writeMs, timer.nsecsElapsed() / 1e6);
+            progress(34);
+
+            for (bool compressed : {false, true})
+            {
+                const QString binary = dir + (compressed ? "/armbionics-benchmark-compressed" : "/armbionics-benchmark") + RECORDING_EXTENSION;
+                timer.restart();
+                RecordingWriter writer;
+                writer.setCompressed(compressed);
+                writer.open(binary, channelCount, device);
+                writer.append(rows);
+                writer.close();
+                writeMs = timer.nsecsElapsed() / 1e6;
+
+                RecordingHeader header;
+                RowBlock loaded;
+                timer.restart();
+                if (!readRecordingFile(binary, header, loaded, cancel))
+                {
+                    QFile::remove(binary);
+                    return false;
+                }
+                report(compressed ? "Compressed .armb" : "Raw .armb", binary, writeMs, timer.nsecsElapsed() / 1e6);
+                progress(compressed ? 100 : 67);
+            }
+
+            qInfo() << "File format benchmark:" << rows.rowCount() << "rows," << channelCount << "channels," << rawMB << "MB of raw samples";
+            return true;
+        },
+        [](bool ok) {
+            if (!ok)
+            {
+                qInfo() << "File format benchmark cancelled";
+            }
+        });
+}
+
+void EMGWidget::on_actionBenchmark_filters_triggered(void)
+{
+    // The default chain (DC removal, band-pass, notch) as one cascade, on one thread
+    const double sampleRate = 2000;
+    QVector<BiquadCoefficients> sections = {BiquadCoefficients::firstOrderHighPass(sampleRate, 0.5)};
+    for (double q : {0.54119610, 1.30656296})
+    {
+        sections.append(BiquadCoefficients::highPass(sampleRate, 20, q));
+        sections.append(BiquadCoefficients::lowPass(sampleRate, 450, q));
+    }
+    sections.append(BiquadCoefficients::notch(sampleRate, 50, 30));
+
+    const qint64 samplesPerRun = 4000000;
+    const qint32 blockRows = 200; // About what one serial read delivers
+    for (quint32 channelCount : {8, 32, 128})
+    {
+        const qint32 rowCount = samplesPerRun / channelCount;
+        QVector<QVector<double>> input(channelCount, QVector<double>(rowCount));
+        for (QVector<double> &column : input)
+        {
+            for (double &value : column)
+            {
+                value = QRandomGenerator::global()->bounded(100.0);
+            }
+        }
+
+        QStringList results;
+        for (BiquadBank::Kernel kernel : {BiquadBank::KernelScalar, BiquadBank::KernelSse2, BiquadBank::KernelAvx, BiquadBank::KernelNeon})
+        {
+            if (!BiquadBank::isSupported(kernel))
+            {
+                continue;
+            }
+            BiquadBank bank;
+            bank.setKernel(kernel);
+            bank.configure(sections, channelCount);
+
+            // Streamed block by block like the acquisition does
+            QVector<QVector<double>> block(channelCount, QVector<double>(blockRows));
+            QElapsedTimer timer;
+            timer.start();
+            for (qint32 first = 0; first + blockRows <= rowCount; first += blockRows)
+            {
+                for (quint32 c = 0; c < channelCount; ++c)
+                {
+                    std::copy(input[c].constBegin() + first, input[c].constBegin() + first + blockRows, block[c].begin());
+                }
+                bank.process(block, blockRows);
+            }
+            const double seconds = timer.nsecsElapsed() / 1e9;
+            results << QString("%1 %2 M samples/s").arg(BiquadBank::kernelName(kernel)).arg(rowCount / blockRows * blockRows * channelCount / seconds / 1e6, 0, 'f', 1);
+        }
+        qInfo() << QString("Filter benchmark (%1 channels, %2 sections, one core): %3")
+                       .arg(channelCount).arg(sections.size()).arg(results.join(", "));
+    }
+}
+
+void EMGWidget::on_actionBenchmark_FFT_triggered(void)
+{
+    for (quint32 size : {64, 256, 1024, 4096})
+    {
+        QVector<double> input(size);
+        for (double &value : input)
+        {
+            value = QRandomGenerator::global()->bounded(2.0) - 1.0;
+        }
+
+        // Accuracy against the direct DFT, relative to the largest bin
+        const FftPlan &plan = FftPlan::plan(size);
+        QVector<double> re(plan.binCount()), im(plan.binCount()), refRe(plan.binCount()), refIm(plan.binCount());
+        QElapsedTimer timer;
+        timer.start();
+        naiveDft(input.constData(), size, refRe.data(), refIm.data());
+        const double naiveUs = timer.nsecsElapsed() / 1e3;
+        plan.realForward(input.constData(), re.data(), im.data());
+        double error = 0;
+        double peak = 0;
+        for (quint32 k = 0; k < plan.binCount(); ++k)
+        {
+            error = qMax(error, std::hypot(re[k] - refRe[k], im[k] - refIm[k]));
+            peak = qMax(peak, std::hypot(refRe[k], refIm[k]));
+        }
+
+        // Real-input plan against the complex transform it replaces
+        const qint32 runs = qMax<qint32>(100, 4000000 / size);
+        timer.restart();
+        for (qint32 r = 0; r < runs; ++r)
+        {
+            plan.realForward(input.constData(), re.data(), im.data());
+        }
+        const double realUs = timer.nsecsElapsed() / 1e3 / runs;
+        QVector<Complex> frame(size);
+        timer.restart();
+        for (qint32 r = 0; r < runs; ++r)
+        {
+            for (quint32 i = 0; i < size; ++i)
+            {
+                frame[i] = Complex(input[i], 0.0);
+            }
+            fftInPlace(frame);
+        }
+        const double complexUs = timer.nsecsElapsed() / 1e3 / runs;
+
+        // One window of every channel of a 32-channel block, as one batch
+        QVector<QVector<double>> channels(32, input);
+        QVector<double> window;
+        hannWindow(window, size);
+        ChannelSpectra spectra;
+        const qint32 batchRuns = qMax(1, runs / 32);
+        timer.restart();
+        for (qint32 r = 0; r < batchRuns; ++r)
+        {
+            channelSpectra(channels, 0, window, size, spectra);
+        }
+        const double batchUs = timer.nsecsElapsed() / 1e3 / batchRuns;
+
+        qInfo() << QString("FFT %1: error %2 (relative), naive DFT %3 us, complex FFT %4 us, real FFT %5 us, 32 channels %6 us")
+                       .arg(size)
+                       .arg(peak > 0 ? error / peak : error, 0, 'e', 1)
+                       .arg(naiveUs, 0, 'f', 1)
+                       .arg(complexUs, 0, 'f', 2)
+                       .arg(realUs, 0, 'f', 2)
+                       .arg(batchUs, 0, 'f', 1);
+    }
+}
+
+void EMGWidget::on_actionBenchmark_resampler_triggered(void)
+{
+    // Two boards off their nominal 1000 Hz, stamped like the acquisition: epoch seconds, whole ms, at the end of a read
+    const double start = QDateTime::currentMSecsSinceEpoch() / 1000.0;
+    const double rates[] = {1003, 997};
+    const double frequency = 37;
+    QVector<RowBlock> streams(2);
+    for (qint32 s = 0; s < 2; ++s)
+    {
+        RowBlock &rows = streams[s];
+        rows.clear(1);
+        const qint32 count = qRound(20 * rates[s]);
+        for (qint32 i = 0; i < count; ++i)
+        {
+            const double sampled = s * 0.4 + double(i) / rates[s];
+            const double arrival = s * 0.4 + double(i / 20 * 20 + 19) / rates[s] + 0.005;
+            rows.times.append(std::floor((start + arrival) * 1000) / 1000);
+            rows.channels[0].append(1000 * std::sin(2 * M_PI * frequency * sampled));
+        }
+    }
+
+    std::atomic_bool cancel(false);
+    RowBlock aligned;
+    QVector<DriftClock> clocks;
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = alignStreams(streams, 500, aligned, cancel, &clocks);
+    const double alignMs = timer.nsecsElapsed() / 1e6;
+
+    // Both channels carry the same sine, so once aligned they agree up to the clock fits
+    double error = 0;
+    bool complete = ok && aligned.rowCount() > 0;
+    for (qint32 c = 0; complete && c < aligned.channels.size(); ++c)
+    {
+        complete = aligned.channels[c].size() == aligned.rowCount();
+    }
+    for (qint32 i = 0; complete && i < aligned.rowCount(); ++i)
+    {
+        const double difference = aligned.channels[0][i] - aligned.channels[1][i];
+        complete = !qIsNaN(difference);
+        error = qMax(error, qAbs(difference));
+    }
+    if (!complete || error > 50)
+    {
+        qWarning() << "Resampler check failed:" << aligned.rowCount() << "rows, largest difference" << error;
+        return;
+    }
+    qInfo() << QString("Resampler: clocks %1 and %2 Hz, %3 aligned rows in %4 ms, largest difference %5 of 1000")
+                   .arg(clocks[0].rate(), 0, 'f', 3)
+                   .arg(clocks[1].rate(), 0, 'f', 3)
+                   .arg(aligned.rowCount())
+                   .arg(alignMs, 0, 'f', 1)
+                   .arg(error, 0, 'f', 1);
+}
+
+void EMGWidget::on_actionIndex_recordings_triggered(void)
+{
+    if (fileJob)
+    {
+        qWarning() << "Another file operation is still running";
+        return;
+    }
 
-    // Do not allow changes in connected state
-    portDisconnect();
+    QStringList filenames = QFileDialog::getOpenFileNames(this, "Index Recordings", "", "Text Files (*.txt);;CSV Files (*.csv);;All Files (*)");
+    if (filenames.isEmpty())
+    {
+        return;
+    }
 
-    // Clear data before changing dimensions
-    on_actionClear_plot_triggered();
+    // One scan per file, later opens read the sidecar and parse only what is shown
+    startFileJob(QString("Indexing %1 recordings").arg(filenames.size()), false,
+        [filenames](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            for (qint32 i = 0; i < filenames.size() && !cancel; ++i)
+            {
+                TextRecordingSource source;
+                RecordingIndex index;
+                if (!source.open(filenames[i]) || !source.buildIndex(index, cancel))
+                {
+                    qWarning() << "Unable to index" << filenames[i];
+                }
+                progress((i + 1) * 100 / filenames.size());
+            }
+            return true;
+        },
+        [filenames](bool ok) {
+            qInfo() << (ok ? "Indexed" : "Indexing cancelled after some of") << filenames.size() << "recordings";
+        });
+}
+
+void EMGWidget::on_actionSpectrogram_triggered(bool checked)
+{
+    spectrogram->setVisible(checked);
+    qDebug() << "Spectrogram" << (checked ? "shown" : "hidden");
+}
 
+void EMGWidget::on_actionSpectrogram_settings_triggered(void)
+{
     bool ok;
-    quint8 numSensors = QInputDialog::getInt(this, tr("Set Number of Sensors"),
-                                             tr("Number of Sensors:"), num_emg, 1, 100, 1, &ok);
+    quint8 channel = QInputDialog::getInt(this, tr("Spectrogram"), tr("EMG channel:"),
+                                          spectrogram->channel() + 1, 1, num_emg, 1, &ok);
+    if (!ok)
+    {
+        return;
+    }
 
-    if (numSensors != num_emg)
+    QStringList sizes = {"64", "128", "256", "512", "1024", "2048"};
+    QString size = QInputDialog::getItem(this, tr("Spectrogram"), tr("FFT size:"), sizes,
+                                         sizes.indexOf(QString::number(spectrogram->fftSize())), false, &ok);
+    if (!ok)
     {
-        num_emg = numSensors;
+        return;
+    }
 
-        // Clear previous data
-        emg_data.resize(num_emg);
-        for (quint32 i = 0; i < num_emg; ++i) {
-            emg_data[i].clear();
-        }
-        plotEMGGraph();
+    quint32 fftSize = size.toUInt();
+    quint32 hop = QInputDialog::getInt(this, tr("Spectrogram"), tr("Hop (samples):"),
+                                       qMin(spectrogram->hop(), fftSize), 1, fftSize, 1, &ok);
+    if (!ok)
+    {
+        return;
     }
+
+    spectrogram->setChannel(channel - 1);
+    spectrogram->configure(fftSize, hop);
+    qDebug() << QString("Spectrogram: EMG%1, FFT size %2, hop %3").arg(channel).arg(fftSize).arg(hop);
 }
 
-void EMGWidget::on_actionPlot_color_triggered()
+void EMGWidget::on_actionFiltered_signal_triggered(bool checked)
+{
+    showFiltered = checked;
+
+    // Only rows acquired with the filters running have a filtered copy
+    const QVector<QList<double>> &data = plottedData();
+    for (qint32 i = 0; i < ui->customPlot->graphCount() && i < data.size(); ++i)
+    {
+        ui->customPlot->graph(i)->setData(time_axis, data[i]);
+    }
+    ui->customPlot->replot();
+    qDebug() << (checked ? "Showing filtered signal" : "Showing raw signal");
+}
+
+void EMGWidget::on_actionFilter_settings_triggered(void)
 {
-    // Create a dialog to select the graph to change the color
     bool ok;
-    QStringList graphNames;
-    for (quint32 i = 0; i < ui->customPlot->graphCount(); ++i) {
-        graphNames << QString("EMG %1").arg(i + 1);
+    QStringList mains = {"Off", "50 Hz", "60 Hz"};
+    QString notch = QInputDialog::getItem(this, tr("Filters"), tr("Mains notch:"), mains,
+                                          mains.indexOf(mainsFrequency ? QString("%1 Hz").arg(mainsFrequency) : "Off"), false, &ok);
+    if (!ok)
+    {
+        return;
     }
 
-    QString selectedGraphName = QInputDialog::getItem(this, "Select Graph", "Choose the graph to change color:", graphNames, 0, false, &ok);
-    if (!ok || selectedGraphName.isEmpty()) {
-        qDebug() << "Color change canceled.";
+    QStringList bands = {"20-450 Hz", "Off"};
+    QString band = QInputDialog::getItem(this, tr("Filters"), tr("Band-pass:"), bands, bandPassEnabled ? 0 : 1, false, &ok);
+    if (!ok)
+    {
         return;
     }
 
-    // Determine the index of the selected graph
-    quint32 graphIndex = graphNames.indexOf(selectedGraphName);
+    mainsFrequency = notch == "Off" ? 0 : notch.left(2).toUInt();
+    bandPassEnabled = band != "Off";
 
-    // Open a color dialog and get the selected color
-    QColor newColor = QColorDialog::getColor(Qt::black, this, "Select Plot Color"); // Default color is black
+    // Takes effect on the next block, with cleared filter state
+    setupFilterChain();
+    qDebug() << "Filter chain:" << filterChain.stageCount() << "stages, notch" << notch << "band-pass" << band;
+}
 
-    // Check if the user clicked "OK" and a valid color was selected
-    if (newColor.isValid())
+void EMGWidget::on_actionEnvelope_triggered(bool checked)
+{
+    showEnvelope = checked;
+    updateEnvelopeGraphs();
+    ui->customPlot->replot();
+    qDebug() << "Envelope" << (checked ? "shown" : "hidden");
+}
+
+void EMGWidget::on_actionEnvelope_settings_triggered(void)
+{
+    bool ok;
+    QStringList methods;
+    for (EnvelopeProcessor::Method method : {EnvelopeProcessor::RectifiedAverage, EnvelopeProcessor::Rms, EnvelopeProcessor::TeagerKaiser})
     {
-        // Update the plot color for the selected graph
-        if (graphIndex >= 0 && graphIndex < ui->customPlot->graphCount())
-        {
-            ui->customPlot->graph(graphIndex)->setPen(QPen(newColor));
-            ui->customPlot->replot(); // Refresh the plot
-            qDebug() << QString("Graph %1 color changed to: %2").arg(graphIndex + 1).arg(newColor.name()); // Log the new color
-        }
-        else
-        {
-            qWarning() << "Invalid graph index:" << graphIndex;
-        }
+        methods << EnvelopeProcessor::methodName(method);
+    }
+    QString method = QInputDialog::getItem(this, tr("Envelope"), tr("Method:"), methods, envelopeMethod, false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    quint16 windowMs = QInputDialog::getInt(this, tr("Envelope"), tr("Window (ms):"), envelopeWindowMs, 5, 5000, 5, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    envelopeMethod = EnvelopeProcessor::Method(methods.indexOf(method));
+    envelopeWindowMs = windowMs;
+
+    // Takes effect on the next block
+    setupEnvelope();
+}
+
+void EMGWidget::on_actionOnset_detection_triggered(bool checked)
+{
+    onsetEnabled = checked;
+    if (checked)
+    {
+        // Thresholds come from the envelope at rest right after enabling
+        setupOnsetDetector();
+        qInfo() << "Onset detection enabled, keep the muscles at rest for" << ONSET_CALIBRATION_SECONDS << "s";
     }
     else
     {
-        qDebug() << "Color change canceled or invalid color selected.";
+        qDebug() << "Onset detection disabled";
+    }
+}
+
+void EMGWidget::on_actionOnset_settings_triggered(void)
+{
+    bool ok;
+    double thresholdSd = QInputDialog::getDouble(this, tr("Onset detection"), tr("Threshold above rest (SD):"), onsetThresholdSd, 1, 20, 1, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    quint16 windowMs = QInputDialog::getInt(this, tr("Onset detection"), tr("Window (ms):"), onsetWindowMs, 5, 1000, 5, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    onsetThresholdSd = thresholdSd;
+    onsetWindowMs = windowMs;
+
+    // Calibrates again from the next block
+    setupOnsetDetector();
+}
+
+void EMGWidget::on_actionLive_features_triggered(bool checked)
+{
+    featuresEnabled = checked;
+    if (checked && featureExtractor.isConfigured())
+    {
+        // The table keeps the earlier windows, the next one starts from new samples
+        featureExtractor.reset();
+    }
+    qDebug() << "Live features" << (checked ? "enabled" : "disabled");
+}
+
+void EMGWidget::on_actionFeature_settings_triggered(void)
+{
+    bool ok;
+    quint16 windowMs = QInputDialog::getInt(this, tr("Features"), tr("Window (ms):"), featureWindowMs, 10, 5000, 10, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    quint16 hopMs = QInputDialog::getInt(this, tr("Features"), tr("Hop (ms):"), qMin(featureHopMs, windowMs), 1, windowMs, 5, &ok);
+    if (!ok)
+    {
+        return;
     }
+
+    double threshold = QInputDialog::getDouble(this, tr("Features"), tr("ZC/SSC threshold:"), featureThreshold, 0, 1000, 4, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    featureWindowMs = windowMs;
+    featureHopMs = hopMs;
+    featureThreshold = threshold;
+
+    // Live windows start again on the next block
+    featureExtractor = FeatureExtractor();
+}
+
+void EMGWidget::on_actionExtract_features_triggered(void)
+{
+    if (fileJob)
+    {
+        qWarning() << "Another file operation is still running";
+        return;
+    }
+
+    QStringList filenames = QFileDialog::getOpenFileNames(this, "Extract Features", "",
+                                                          "Recordings (*" RECORDING_EXTENSION " *.txt *.csv);;All Files (*)");
+    if (filenames.isEmpty())
+    {
+        return;
+    }
+
+    bool ok;
+    QStringList formats = {"Binary (" FEATURE_EXTENSION ")", "CSV"};
+    QString format = QInputDialog::getItem(this, tr("Features"), tr("Output:"), formats, 0, false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    bool csv = format == formats[1];
+
+    // Every file gets its table next to it, the window in samples follows each file's rate
+    quint16 windowMs = featureWindowMs;
+    quint16 hopMs = featureHopMs;
+    double threshold = featureThreshold;
+    startFileJob(QString("Extracting features of %1 recordings").arg(filenames.size()), true,
+        [filenames, csv, windowMs, hopMs, threshold](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            bool allOk = true;
+            for (qint32 i = 0; i < filenames.size() && !cancel; ++i)
+            {
+                const QString &filename = filenames[i];
+                RowBlock rows;
+                double sampleRate = 0;
+                if (filename.endsWith(RECORDING_EXTENSION, Qt::CaseInsensitive))
+                {
+                    RecordingHeader header;
+                    allOk = readRecordingFile(filename, header, rows, cancel) && allOk;
+                    sampleRate = header.sampleRate;
+                }
+                else
+                {
+                    TextImport import;
+                    allOk = readTextRecording(filename, import, cancel) && allOk;
+                    rows = import.rows;
+                }
+                if (sampleRate <= 0 && rows.rowCount() > 1 && rows.times.last() > rows.times.first())
+                {
+                    sampleRate = (rows.rowCount() - 1) / (rows.times.last() - rows.times.first());
+                }
+
+                FeatureSettings settings;
+                settings.windowSize = qMax(1, qRound(windowMs * sampleRate / 1000));
+                settings.hop = qMax(1, qRound(hopMs * sampleRate / 1000));
+                settings.sampleRate = sampleRate;
+                settings.threshold = threshold;
+                FeatureExtractor extractor;
+                extractor.configure(settings, rows.channels.size());
+
+                FeatureTable table;
+                QElapsedTimer timer;
+                timer.start();
+                auto fileProgress = [&progress, i, &filenames](int percent) {
+                    progress((i * 100 + percent) / filenames.size());
+                };
+                if (sampleRate <= 0 || !extractor.extract(rows, table, cancel, fileProgress))
+                {
+                    qWarning() << "No features extracted from" << filename;
+                    allOk = false;
+                    continue;
+                }
+
+                QString output = QFileInfo(filename).path() + "/" + QFileInfo(filename).completeBaseName()
+                                 + (csv ? ".features.csv" : ".features" FEATURE_EXTENSION);
+                if (csv ? writeFeatureCsv(output, table) : writeFeatureFile(output, table))
+                {
+                    qInfo() << "Features:" << table.rowCount() << "windows of" << table.channelCount << "channels in"
+                            << timer.elapsed() << "ms to" << output;
+                }
+                else
+                {
+                    allOk = false;
+                }
+            }
+            return allOk && !cancel;
+        },
+        [filenames](bool ok) {
+            qInfo() << (ok ? "Extracted features of" : "Feature extraction failed or was cancelled for some of") << filenames.size() << "recordings";
+        });
+}
+
+void EMGWidget::on_actionResample_recordings_triggered(void)
+{
+    if (fileJob)
+    {
+        qWarning() << "Another file operation is still running";
+        return;
+    }
+
+    QStringList filenames = QFileDialog::getOpenFileNames(this, "Resample / Align Recordings", "",
+                                                          "Recordings (*" RECORDING_EXTENSION " *.txt *.csv);;All Files (*)");
+    if (filenames.isEmpty())
+    {
+        return;
+    }
+
+    bool ok;
+    double rate = QInputDialog::getDouble(this, tr("Resample"), tr("Output rate (Hz):"), uniformRate, 1, 100000, 1, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    uniformRate = rate;
+
+    // One recording is resampled, several recorded together are also cut to their common span
+    QString output = QFileInfo(filenames.first()).path() + "/" + QFileInfo(filenames.first()).completeBaseName()
+                     + (filenames.size() > 1 ? QString(".aligned") : QString(".%1Hz").arg(rate)) + RECORDING_EXTENSION;
+    startFileJob(QString("Resampling %1 recordings").arg(filenames.size()), true,
+        [filenames, rate, output](const std::atomic_bool &cancel, const std::function<void(int)> &progress) {
+            QVector<RowBlock> streams;
+            QString device;
+            for (qint32 i = 0; i < filenames.size() && !cancel; ++i)
+            {
+                const QString &filename = filenames[i];
+                RowBlock rows;
+                bool read;
+                if (filename.endsWith(RECORDING_EXTENSION, Qt::CaseInsensitive))
+                {
+                    RecordingHeader header;
+                    read = readRecordingFile(filename, header, rows, cancel);
+                    if (device.isEmpty())
+                    {
+                        device = QString::fromLatin1(header.deviceId, qstrnlen(header.deviceId, sizeof(header.deviceId)));
+                    }
+                }
+                else
+                {
+                    TextImport import;
+                    read = readTextRecording(filename, import, cancel);
+                    rows = import.rows;
+                }
+                if (!read)
+                {
+                    return false;
+                }
+                streams.append(rows);
+                progress((i + 1) * 50 / filenames.size());
+            }
+            if (cancel)
+            {
+                return false;
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+            RowBlock aligned;
+            QVector<DriftClock> clocks;
+            if (!alignStreams(streams, rate, aligned, cancel, &clocks))
+            {
+                qWarning() << "Could not resample" << filenames.join(", ");
+                return false;
+            }
+            for (qint32 i = 0; i < clocks.size(); ++i)
+            {
+                qInfo() << QString("%1: %2 rows, board clock %3 Hz")
+                               .arg(QFileInfo(filenames[i]).fileName())
+                               .arg(streams[i].rowCount())
+                               .arg(clocks[i].rate(), 0, 'f', 3);
+            }
+            progress(90);
+
+            RecordingWriter writer;
+            if (!writer.open(output, aligned.channels.size(), device, rate))
+            {
+                return false;
+            }
+            writer.append(aligned);
+            writer.close();
+            if (writer.rowsWritten() != aligned.rowCount() || aligned.rowCount() == 0)
+            {
+                qWarning() << "Resampled recording incomplete:" << writer.rowsWritten() << "of" << aligned.rowCount() << "rows written to" << output;
+                QFile::remove(output);
+                return false;
+            }
+            qInfo() << "Resampled" << aligned.rowCount() << "rows of" << aligned.channels.size() << "channels in"
+                    << timer.elapsed() << "ms to" << output;
+            return !cancel;
+        },
+        [output](bool ok) {
+            if (!ok)
+            {
+                qInfo() << "Resampling to" << output << "cancelled or failed";
+            }
+        });
+}
+
+void EMGWidget::on_actionUniform_recording_triggered(bool checked)
+{
+    // Takes effect on the running session too
+    uniformRecording = checked;
+    if (checked)
+    {
+        startUniformRecording();
+    }
+    else
+    {
+        stopUniformRecording();
+    }
+}
+
+void EMGWidget::on_actionLoad_gesture_model_triggered(void)
+{
+    QString filename = QFileDialog::getOpenFileName(this, "Load Gesture Model", "", "Gesture Models (*.json);;All Files (*)");
+    if (filename.isEmpty() || !classifier.load(filename))
+    {
+        return;
+    }
+
+    // The model runs on the live feature windows
+    if (!featuresEnabled)
+    {
+        ui->actionLive_features->setChecked(true);
+        on_actionLive_features_triggered(true);
+    }
+    if (featureExtractor.isConfigured())
+    {
+        classifier.bind(featureTable.columnNames());
+    }
+    gestureText.clear();
+}
+
+void EMGWidget::on_actionPower_spectrum_triggered(void)
+{
+    if (time_axis.isEmpty())
+    {
+        qWarning() << "No data in memory for a power spectrum";
+        return;
+    }
+
+    // Dragging draws a selection rectangle instead of moving the plot, once
+    ui->customPlot->setSelectionRectMode(QCP::srmCustom);
+    qInfo() << "Drag over the time span to analyse";
+}
+
+void EMGWidget::on_actionPower_spectrum_settings_triggered(void)
+{
+    bool ok;
+    QStringList sizes = {"128", "256", "512", "1024", "2048", "4096"};
+    QString size = QInputDialog::getItem(this, tr("Power spectrum"), tr("Segment (samples):"), sizes,
+                                         qMax(0, sizes.indexOf(QString::number(psdSegmentSize))), false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    quint8 overlap = QInputDialog::getInt(this, tr("Power spectrum"), tr("Overlap (%):"), psdOverlapPercent, 0, 90, 5, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    psdSegmentSize = size.toUInt();
+    psdOverlapPercent = overlap;
+}
+
+void EMGWidget::powerSpectrumSpanSelected(const QRect &rect)
+{
+    ui->customPlot->setSelectionRectMode(QCP::srmNone);
+
+    double start = ui->customPlot->xAxis->pixelToCoord(rect.left());
+    double end = ui->customPlot->xAxis->pixelToCoord(rect.right());
+    if (end < start)
+    {
+        std::swap(start, end);
+    }
+    qint32 first = std::lower_bound(time_axis.constBegin(), time_axis.constEnd(), start) - time_axis.constBegin();
+    qint32 last = std::upper_bound(time_axis.constBegin(), time_axis.constEnd(), end) - time_axis.constBegin();
+    qint32 count = last - first;
+    if (count < 2 || time_axis[last - 1] <= time_axis[first])
+    {
+        qWarning() << "Not enough samples in the selected span";
+        return;
+    }
+
+    // Only the span is copied for the worker, in the colours of the plot
+    const QVector<QList<double>> &data = plottedData();
+    QVector<QVector<double>> channels(num_emg);
+    QList<QColor> colors;
+    for (quint8 c = 0; c < num_emg && c < data.size(); ++c)
+    {
+        channels[c] = data[c].mid(first, count);
+        colors.append(c < ui->customPlot->graphCount() ? ui->customPlot->graph(c)->pen().color() : QColor(Qt::black));
+    }
+
+    WelchSettings settings;
+    settings.segmentSize = psdSegmentSize;
+    settings.overlap = psdOverlapPercent / 100.0;
+    settings.sampleRate = (count - 1) / (time_axis[last - 1] - time_axis[first]);
+
+    if (!powerSpectrum)
+    {
+        powerSpectrum = new PowerSpectrumWindow(this);
+    }
+    powerSpectrum->compute(channels, colors, time_axis[first], time_axis[last - 1], settings);
+    powerSpectrum->show();
+    powerSpectrum->raise();
 }
 
 void EMGWidget::on_actionClear_log_triggered()
@@ -696,6 +2776,10 @@ void EMGWidget::on_actionClear_all_triggered()
 
 void EMGWidget::on_actionClear_plot_triggered()
 {
+    // A streamed recording would refill the graphs on the next range change
+    closeRecording();
+    forgetSessionRecording();
+
     // Clear all graphs from the plot
     ui->customPlot->clearGraphs();
 
@@ -706,6 +2790,9 @@ void EMGWidget::on_actionClear_plot_triggered()
     {
         emg_data[i].clear();  // Clear each QList<double> in the QVector
     }
+    filteredData.clear();
+    envelopeData.clear();
+    clearOnsetMarkers();
 
     // Re-add the graphs for each EMG channel
     for (quint32 i = 0; i < num_emg; i++)
@@ -713,12 +2800,14 @@ void EMGWidget::on_actionClear_plot_triggered()
         QColor color;
         color.setHsv(360/(i+1), 255, 255); // Saturation and value set to max (255) for full color
 
-        ui->customPlot->addGraph(); // Add a new graph for each EMG channel
+        new TraceGraph(ui->customPlot->xAxis, ui->customPlot->yAxis, traceRasterizer); // Add a new graph for each EMG channel
         ui->customPlot->graph(i)->setLineStyle(QCPGraph::lsLine);
         ui->customPlot->graph(i)->setPen(QPen(color));
         ui->customPlot->graph(i)->setBrush(Qt::NoBrush);
     }
 
+    spectrogram->clear();
+
     // Update the graph with the cleared data
     ui->customPlot->replot();
 
@@ -726,6 +2815,14 @@ void EMGWidget::on_actionClear_plot_triggered()
 }
 
 void EMGWidget::closeEvent(QCloseEvent *event) {
+    // A running load would be cut short and no save could start, so the window stays open
+    if (fileJob) {
+        QMessageBox::information(this, "File Operation Running",
+                                 "A file operation is still running. Wait for it to finish or cancel it, then close the window.");
+        event->ignore();
+        return;
+    }
+
     if(connect_status){
         portDisconnect();
         portOpened = true;
@@ -737,12 +2834,16 @@ void EMGWidget::closeEvent(QCloseEvent *event) {
                                            "You have unsaved changes. Do you want to save them before exiting?",
                                            QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
 
-        saveDialogShown = true; // Indicate that the dialog has been shown.
-
         if (reply == QMessageBox::Yes) {
-            on_actionSave_triggered();
-            event->accept();
+            // Closed only once the save is under way, it completes before the application exits
+            if (saveData()) {
+                saveDialogShown = true;
+                event->accept();
+            } else {
+                event->ignore();
+            }
         } else if (reply == QMessageBox::No) {
+            saveDialogShown = true; // Indicate that the dialog has been answered.
             event->accept();
         } else {
             event->ignore(); // Keep the application open if the user chooses Cancel.
@@ -3,11 +3,32 @@
 
 #include "QtWidgets/qtextbrowser.h"
 #include <QMainWindow>
+#include <QPointer>
 #include <QDebug>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QtSerialPort/QSerialPort>
 #include <QtSerialPort/QSerialPortInfo>
 #include <QTextEdit>
+#include "filejob.h"
+#include "filterchain.h"
+#include "envelope.h"
+#include "onsetdetector.h"
+#include "featureextractor.h"
+#include "gestureclassifier.h"
+#include "signalquality.h"
+#include "resampler.h"
+
+class TraceRasterizer;
+class RenderQualityController;
+class SpectrogramView;
+class RecordingViewer;
+class RecordingWriter;
+class QCPGraph;
+class QCPAbstractItem;
+class PowerSpectrumWindow;
+class QLabel;
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class EMGWidget; }
@@ -46,6 +67,33 @@ private slots:
     void on_actionClear_log_triggered();
     void on_actionClear_all_triggered();
 
+    void on_actionBenchmark_rendering_triggered(void);
+    void on_actionBenchmark_file_formats_triggered(void);
+    void on_actionBenchmark_filters_triggered(void);
+    void on_actionBenchmark_FFT_triggered(void);
+    void on_actionBenchmark_resampler_triggered(void);
+    void on_actionIndex_recordings_triggered(void);
+    void on_actionSpectrogram_triggered(bool checked);
+    void on_actionSpectrogram_settings_triggered(void);
+    void on_actionFiltered_signal_triggered(bool checked);
+    void on_actionFilter_settings_triggered(void);
+    void on_actionEnvelope_triggered(bool checked);
+    void on_actionEnvelope_settings_triggered(void);
+    void on_actionOnset_detection_triggered(bool checked);
+    void on_actionOnset_settings_triggered(void);
+    void on_actionLive_features_triggered(bool checked);
+    void on_actionFeature_settings_triggered(void);
+    void on_actionExtract_features_triggered(void);
+    void on_actionLoad_gesture_model_triggered(void);
+    void on_actionPower_spectrum_triggered(void);
+    void on_actionPower_spectrum_settings_triggered(void);
+    void on_actionResample_recordings_triggered(void);
+    void on_actionUniform_recording_triggered(bool checked);
+
+    void powerSpectrumSpanSelected(const QRect &rect);
+
+    void onsetMarkersRendered(void);
+
 private:
     Ui::EMGWidget *ui;
 
@@ -53,6 +101,80 @@ private:
     QSerialPort m_serial; // Serial port class to setup the COM Port
 
     QTextBrowser *logViewer; // To log data
+    TraceRasterizer *traceRasterizer = nullptr; // Parallel rendering of the channel traces
+    RenderQualityController *renderQuality = nullptr; // Adaptive antialiasing
+    SpectrogramView *spectrogram = nullptr; // Time-frequency pane of one channel
+    RecordingViewer *recordingViewer = nullptr; // Streams large recordings from disk
+    PowerSpectrumWindow *powerSpectrum = nullptr; // Welch PSD of a span picked on the plot
+    quint32 psdSegmentSize = 512;
+    quint8 psdOverlapPercent = 50;
+
+    // Continuous recording of the acquired rows
+    RecordingWriter *recorder = nullptr;
+    QString sessionFile; // Last session file written
+    bool sessionCoversAll = false; // True if sessionFile holds every row in memory
+
+    // Copy of the session resampled onto a uniform grid, on the board clock fitted to the arrival times
+    SincResampler liveResampler;
+    RecordingWriter *uniformRecorder = nullptr;
+    bool uniformRecording = false;
+    double uniformRate = 1000; // Hz, also the default of Resample / align recordings
+
+    FileJob *fileJob = nullptr; // Load or save running in the background
+
+    // Streaming filters between the packet decoder and the plot/recorder
+    FilterChain filterChain;
+    QVector<QList<double>> filteredData; // Filtered copy of emg_data, row for row, while acquiring
+    RecordingWriter *filteredRecorder = nullptr; // Filtered stream of the session, next to the raw one
+    bool showFiltered = false; // Plot the filtered stream instead of the raw one
+    bool bandPassEnabled = true;
+    quint8 mainsFrequency = 50; // Notch frequency in Hz, 0 for none
+
+    // Envelope of the filtered stream, drawn over the channels
+    EnvelopeProcessor envelope;
+    QVector<QList<double>> envelopeData; // Envelope of filteredData, row for row
+    QList<QPointer<QCPGraph>> envelopeGraphs; // After the channel graphs, gone after clearGraphs()
+    bool showEnvelope = false;
+    EnvelopeProcessor::Method envelopeMethod = EnvelopeProcessor::Rms;
+    quint16 envelopeWindowMs = 100;
+
+    // Muscle activation onsets on the envelope, marked on the plot and logged with the session
+    OnsetDetector onsetDetector;
+    bool onsetEnabled = false;
+    double onsetThresholdSd = 3; // Threshold above the rest level, in standard deviations
+    quint16 onsetWindowMs = 50; // Window of the m-of-n test, half of it must be above the threshold
+    QList<QPointer<QCPAbstractItem>> onsetMarkers; // Oldest first, gone after clearItems()
+    QFile onsetLog; // Events of the session recording, as CSV
+
+    // End-to-end onset latency, from the serial read to the replot showing the marker
+    QElapsedTimer arrivalClock;
+    QVector<qint64> pendingOnsetArrivals; // Arrival times of the markers not drawn yet
+    qint64 onsetLatencyTotal = 0; // ns
+    qint64 onsetLatencyMax = 0;
+    quint32 onsetLatencyCount = 0;
+
+    // Windowed features for classifier training, saved with the session
+    FeatureExtractor featureExtractor;
+    FeatureTable featureTable; // Windows of the filtered stream since the session started
+    QString featureFile;
+    bool featuresEnabled = false;
+    quint16 featureWindowMs = 200;
+    quint16 featureHopMs = 50;
+    double featureThreshold = 0; // Dead zone of ZC and SSC
+
+    // Gesture predicted from the live feature windows, shown with the device info
+    GestureClassifier classifier;
+    QString gestureText;
+    qint64 inferenceTotal = 0; // ns
+    qint64 inferenceMax = 0;
+    quint32 inferenceCount = 0;
+    quint32 inferenceOverBudget = 0; // Windows classified in more than the budget
+    quint32 inferenceSkipped = 0; // Older windows of a read left out to stay in the budget
+
+    // Per-channel quality of the raw stream, shown in the status bar at the graph update rate
+    SignalQualityMonitor qualityMonitor;
+    QList<QLabel*> qualityLabels;
+    QVector<qint8> shownQuality; // Status each label shows, -1 before the first update
 
     quint16 updateIntervalMs = 100; // Graph update of 100ms by default
     quint8 num_emg = 8; // Number of EMG sensors (default 8)
@@ -88,10 +210,42 @@ private:
     void plotEMGGraph(void);
     void updateGraph(void);
     void updateDeviceInfo(void);
-    void saveDataToFile(const QString& filename);
+    // Shows the save dialog, true if the data was saved or its save job started
+    bool saveData(void);
+    bool saveDataToFile(const QString& filename);
     void loadDataFromFile(const QString& filename);
+    void openRecording(const QString& filename);
+    bool saveRecordingFile(const QString& filename, bool compressed = false);
+    bool saveEdfFile(const QString& filename, bool bdf);
+    void loadRecordingFile(const QString& filename);
+    bool startFileJob(const QString& label, bool isSave, const FileJob::Work& work, const std::function<void(bool)>& done);
+    void markDataSaved(void);
+    void closeRecording(void);
     void setUpdateInterval(quint8 intervalMs);
-    qint32 QByteArrayToInt(const QByteArray& bytes);
+    double estimatedSampleRate(void) const;
+    void dispatchSamples(qint32 firstSample, qint64 arrival);
+    void setupFilterChain(void);
+    void filterSamples(const RowBlock &rows, qint32 firstSample, RowBlock &filtered);
+    const QVector<QList<double>> &plottedData(void) const;
+    void setupEnvelope(void);
+    void envelopeSamples(const RowBlock &filtered, qint32 firstSample, RowBlock &envelopeRows);
+    void updateEnvelopeGraphs(void);
+    void setupOnsetDetector(void);
+    void onsetSamples(const RowBlock &envelopeRows, qint64 arrival);
+    void addOnsetMarker(const OnsetEvent &event);
+    void clearOnsetMarkers(void);
+    FeatureSettings featureSettings(double sampleRate) const;
+    void featureSamples(const RowBlock &filtered);
+    void classifyWindows(qint32 firstRow);
+    void qualitySamples(const RowBlock &rows);
+    void updateQualityIndicator(void);
+    void startSessionRecording(bool coversAll);
+    void stopSessionRecording(void);
+    void startUniformRecording(void);
+    void stopUniformRecording(void);
+    void forgetSessionRecording(void);
+    void offerSessionRecovery(void);
+    qint32 QByteArrayToInt(const QByteArray& bytes, bool *ok = nullptr);
 
 };
 
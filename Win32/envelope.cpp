@@ -0,0 +1,96 @@
+#include "envelope.h"
+#include <QtMath>
+
+QString EnvelopeProcessor::methodName(Method method)
+{
+    switch (method)
+    {
+    case RectifiedAverage:
+        return "Rectified average";
+    case Rms:
+        return "RMS";
+    case TeagerKaiser:
+        return "Teager-Kaiser";
+    }
+    return QString();
+}
+
+void EnvelopeProcessor::configure(Method method, quint32 channelCount, quint32 windowSize)
+{
+    m_method = method;
+    m_windowSize = qMax<quint32>(1, windowSize);
+    m_channels = QVector<ChannelState>(channelCount);
+    reset();
+}
+
+void EnvelopeProcessor::reset(void)
+{
+    for (ChannelState &state : m_channels)
+    {
+        state = ChannelState();
+        state.terms = QVector<double>(m_windowSize, 0.0);
+    }
+}
+
+double EnvelopeProcessor::push(ChannelState &state, double sample) const
+{
+    if (qIsNaN(sample))
+        return qQNaN();
+
+    double term;
+    switch (m_method)
+    {
+    case RectifiedAverage:
+        term = qAbs(sample);
+        break;
+    case Rms:
+        term = sample * sample;
+        break;
+    default:
+        // The operator needs the two samples before this one
+        term = state.history >= 2 ? qAbs(state.previous[0] * state.previous[0] - sample * state.previous[1]) : 0;
+        break;
+    }
+    state.previous[1] = state.previous[0];
+    state.previous[0] = sample;
+    state.history = qMin<quint32>(state.history + 1, 2);
+
+    // Replace the oldest term of the window
+    state.sum += term - state.terms[state.head];
+    state.terms[state.head] = term;
+    state.head = (state.head + 1) % m_windowSize;
+    state.filled = qMin(state.filled + 1, m_windowSize);
+    if (state.head == 0)
+    {
+        // Exact sum once per window, so rounding errors do not pile up
+        state.sum = 0;
+        for (double value : std::as_const(state.terms))
+        {
+            state.sum += value;
+        }
+    }
+
+    const double mean = qMax(0.0, state.sum) / state.filled;
+    return m_method == Rms ? qSqrt(mean) : mean;
+}
+
+void EnvelopeProcessor::process(const RowBlock &rows, RowBlock &envelope)
+{
+    const qint32 count = rows.rowCount();
+    envelope.times = rows.times;
+    envelope.channels = QVector<QVector<double>>(rows.channels.size(), QVector<double>(count, qQNaN()));
+    if (!isConfigured())
+        return;
+
+    const quint32 channels = qMin<quint32>(m_channels.size(), rows.channels.size());
+    for (quint32 c = 0; c < channels; ++c)
+    {
+        ChannelState &state = m_channels[c];
+        const double *in = rows.channels[c].constData();
+        double *out = envelope.channels[c].data();
+        for (qint32 i = 0; i < count && i < rows.channels[c].size(); ++i)
+        {
+            out[i] = push(state, in[i]);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <QString>
+#include <QVector>
+#include "recording.h"
+
+/**
+ * @brief Streaming amplitude envelope of every channel.
+ *
+ * Each channel keeps a ring of the last windowSize terms and their running
+ * sum, so every new sample costs one addition and one subtraction whatever
+ * the window. The term is |x| for the rectified moving average, x^2 for the
+ * RMS and |x[n-1]^2 - x[n] x[n-2]| (Teager-Kaiser energy) for the TKEO
+ * envelope. The sum is recomputed exactly once per window to cancel rounding
+ * drift, which keeps the cost O(1) per sample on average.
+ *
+ * NaN samples give a NaN envelope and are left out of the window.
+ */
+class EnvelopeProcessor
+{
+public:
+    enum Method
+    {
+        RectifiedAverage,
+        Rms,
+        TeagerKaiser
+    };
+
+    static QString methodName(Method method);
+
+    // Sets the method and window, clears the state
+    void configure(Method method, quint32 channelCount, quint32 windowSize);
+    void reset(void);
+
+    bool isConfigured(void) const { return m_windowSize > 0; }
+    Method method(void) const { return m_method; }
+    quint32 channelCount(void) const { return m_channels.size(); }
+    quint32 windowSize(void) const { return m_windowSize; }
+
+    // Envelope of every row of rows, envelope gets the same times and shape (all NaN until configured)
+    void process(const RowBlock &rows, RowBlock &envelope);
+
+private:
+    struct ChannelState
+    {
+        QVector<double> terms; // Ring of the last windowSize terms
+        quint32 head = 0; // Next slot to write
+        quint32 filled = 0; // Valid terms in the ring
+        double sum = 0;
+        double previous[2] = {0, 0}; // x[n-1], x[n-2]
+        quint32 history = 0; // Valid samples seen, up to 2
+    };
+
+    double push(ChannelState &state, double sample) const;
+
+    Method m_method = Rms;
+    quint32 m_windowSize = 0;
+    QVector<ChannelState> m_channels;
+};
+
+#endif // ENVELOPE_H
@@ -0,0 +1,81 @@
+#include "fastdatetimeticker.h"
+#include "clocktime.h"
+#include <limits>
+
+// Enough for several screens worth of ticks while scrolling
+static const int LABEL_CACHE_SIZE = 1024;
+
+FastDateTimeTicker::FastDateTimeTicker() : m_labels(LABEL_CACHE_SIZE)
+{
+}
+
+void FastDateTimeTicker::clearLabelCache(void)
+{
+    m_labels.clear();
+    m_offsetZone = QTimeZone();
+    m_offsetStart = m_offsetEnd = 0;
+}
+
+bool FastDateTimeTicker::fastPathApplies(const QLocale &locale) const
+{
+    return mDateTimeFormat == QLatin1String(CLOCK_TIME_FORMAT)
+           && (mDateTimeSpec == Qt::LocalTime || mDateTimeSpec == Qt::UTC || (mDateTimeSpec == Qt::TimeZone && mTimeZone.isValid()))
+           && locale.zeroDigit() == QLatin1String("0");
+}
+
+qint64 FastDateTimeTicker::utcOffsetMSecs(qint64 msecsSinceEpoch)
+{
+    if (mDateTimeSpec == Qt::UTC)
+        return 0;
+    if (msecsSinceEpoch >= m_offsetStart && msecsSinceEpoch < m_offsetEnd)
+        return m_offsetMSecs;
+
+    // The zone is looked up again whenever the labels are cleared
+    if (!m_offsetZone.isValid())
+        m_offsetZone = mDateTimeSpec == Qt::TimeZone ? mTimeZone : QTimeZone::systemTimeZone();
+
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(msecsSinceEpoch, Qt::UTC);
+    m_offsetMSecs = qint64(m_offsetZone.offsetFromUtc(time)) * 1000;
+    if (m_offsetZone.hasTransitions())
+    {
+        // A transition exactly at this time starts the range, so look for it from 1 ms later
+        const QTimeZone::OffsetData previous = m_offsetZone.previousTransition(time.addMSecs(1));
+        const QTimeZone::OffsetData next = m_offsetZone.nextTransition(time);
+        m_offsetStart = previous.atUtc.isValid() ? previous.atUtc.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+        m_offsetEnd = next.atUtc.isValid() ? next.atUtc.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+    }
+    else
+    {
+        // No transition data, the offset is only trusted for the hour
+        m_offsetStart = msecsSinceEpoch - msecsSinceEpoch % 3600000;
+        m_offsetEnd = m_offsetStart + 3600000;
+    }
+    return m_offsetMSecs;
+}
+
+QString FastDateTimeTicker::getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision)
+{
+    // Labels made with another format, time spec, time zone or locale are no longer valid
+    if (mDateTimeFormat != m_cachedFormat || mDateTimeSpec != m_cachedSpec || mTimeZone != m_cachedTimeZone
+        || locale != m_cachedLocale)
+    {
+        clearLabelCache();
+        m_cachedFormat = mDateTimeFormat;
+        m_cachedSpec = mDateTimeSpec;
+        m_cachedTimeZone = mTimeZone;
+        m_cachedLocale = locale;
+    }
+
+    const qint64 msecs = qRound64(tick * 1000.0);
+    if (const QString *label = m_labels.object(msecs))
+        return *label;
+
+    QString label;
+    if (fastPathApplies(locale))
+        label = clockTimeToString(msecs + utcOffsetMSecs(msecs));
+    else
+        label = QCPAxisTickerDateTime::getTickLabel(tick, locale, formatChar, precision);
+
+    m_labels.insert(msecs, new QString(label));
+    return label;
+}
@@ -0,0 +1,49 @@
+#ifndef FASTDATETIMETICKER_H
+#define FASTDATETIMETICKER_H
+
+#include <QCache>
+#include <QLocale>
+#include <QTimeZone>
+#include "qcustomplot.h"
+
+/**
+ * @brief Date/time ticker that memoises its tick labels.
+ *
+ * In a scrolling view most tick values survive from one frame to the next, so
+ * labels are cached by tick value (in ms) and only formatted once, until the
+ * format, time spec, time zone or locale changes. The "hh:mm:ss.zzz" format
+ * is formatted with integer arithmetic instead of QDateTime, with the UTC
+ * offset of the zone kept until its next transition; any other format falls
+ * back to QCPAxisTickerDateTime.
+ * Returning the very same strings also keeps the axis label pixmap cache of
+ * QCustomPlot (phCacheLabels) hot, so text layout is not redone either.
+ */
+class FastDateTimeTicker : public QCPAxisTickerDateTime
+{
+public:
+    FastDateTimeTicker();
+
+    // Drops every memoised label
+    void clearLabelCache(void);
+
+protected:
+    QString getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision) override;
+
+private:
+    bool fastPathApplies(const QLocale &locale) const;
+    qint64 utcOffsetMSecs(qint64 msecsSinceEpoch);
+
+    QCache<qint64, QString> m_labels; // Label by tick in ms
+    QString m_cachedFormat; // Format, spec, zone and locale the cached labels were made with
+    Qt::TimeSpec m_cachedSpec = Qt::LocalTime;
+    QTimeZone m_cachedTimeZone;
+    QLocale m_cachedLocale;
+
+    // UTC offset of m_offsetZone over [m_offsetStart, m_offsetEnd) ms, between two of its transitions
+    QTimeZone m_offsetZone;
+    qint64 m_offsetStart = 0;
+    qint64 m_offsetEnd = 0;
+    qint64 m_offsetMSecs = 0;
+};
+
+#endif // FASTDATETIMETICKER_H
@@ -0,0 +1,414 @@
+#include "featureextractor.h"
+#include <QDebug>
+#include <QFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+
+const quint32 FEATURE_LANES = 4; // Independent partial sums of the time-domain pass
+const qint32 TASK_WINDOWS = 256; // Windows per pool task of extract()
+const quint32 MIN_WINDOW_SIZE = 8;
+
+QString featureName(Feature feature)
+{
+    switch (feature)
+    {
+    case FeatureMav:
+        return "MAV";
+    case FeatureWl:
+        return "WL";
+    case FeatureZc:
+        return "ZC";
+    case FeatureSsc:
+        return "SSC";
+    case FeatureRms:
+        return "RMS";
+    case FeatureMnf:
+        return "MNF";
+    case FeatureMdf:
+        return "MDF";
+    default:
+        return QString();
+    }
+}
+
+QStringList FeatureTable::columnNames(void) const
+{
+    QStringList names;
+    for (quint32 c = 0; c < channelCount; ++c)
+    {
+        for (qint32 f = 0; f < FEATURE_COUNT; ++f)
+        {
+            names << QString("EMG%1_%2").arg(c + 1).arg(featureName(Feature(f)));
+        }
+    }
+    return names;
+}
+
+// MAV, WL, ZC, SSC and RMS of x[0..n-1], n >= 3
+static void timeFeatures(const double *x, quint32 n, double threshold, double *out)
+{
+    double sumAbs[FEATURE_LANES] = {};
+    double sumSquare[FEATURE_LANES] = {};
+    double length[FEATURE_LANES] = {};
+    double crossings[FEATURE_LANES] = {};
+    double slopeChanges[FEATURE_LANES] = {};
+    const double slopeThreshold = threshold * threshold;
+
+    // Comparisons are added as 0/1, so there is no branch in the loop
+    auto step = [&](quint32 i, quint32 lane) {
+        const double previous = x[i] - x[i - 1];
+        const double next = x[i] - x[i + 1];
+        sumAbs[lane] += std::fabs(x[i]);
+        sumSquare[lane] += x[i] * x[i];
+        length[lane] += std::fabs(previous);
+        crossings[lane] += double(x[i] * x[i - 1] < 0) * double(std::fabs(previous) >= threshold);
+        slopeChanges[lane] += double(previous * next > slopeThreshold);
+    };
+
+    // Inner samples, FEATURE_LANES at a time
+    quint32 i = 1;
+    for (; i + FEATURE_LANES <= n - 1; i += FEATURE_LANES)
+    {
+        for (quint32 lane = 0; lane < FEATURE_LANES; ++lane)
+        {
+            step(i + lane, lane);
+        }
+    }
+    for (; i < n - 1; ++i)
+    {
+        step(i, 0);
+    }
+
+    // The first sample has no previous one, the last one no next one
+    const double last = x[n - 1] - x[n - 2];
+    double mav = std::fabs(x[0]) + std::fabs(x[n - 1]);
+    double meanSquare = x[0] * x[0] + x[n - 1] * x[n - 1];
+    double wl = std::fabs(last);
+    double zc = double(x[n - 1] * x[n - 2] < 0) * double(std::fabs(last) >= threshold);
+    double ssc = 0;
+    for (quint32 lane = 0; lane < FEATURE_LANES; ++lane)
+    {
+        mav += sumAbs[lane];
+        meanSquare += sumSquare[lane];
+        wl += length[lane];
+        zc += crossings[lane];
+        ssc += slopeChanges[lane];
+    }
+
+    out[FeatureMav] = mav / n;
+    out[FeatureWl] = wl;
+    out[FeatureZc] = zc;
+    out[FeatureSsc] = ssc;
+    out[FeatureRms] = std::sqrt(meanSquare / n);
+}
+
+// MNF and MDF of x[0..window.size()-1], scratch holds the frame and the spectrum of plan
+static void spectralFeatures(const double *x, const QVector<double> &window, double sampleRate, const FftPlan &plan,
+                             QVector<double> &scratch, double *out)
+{
+    const quint32 n = window.size();
+    double mean = 0;
+    for (quint32 i = 0; i < n; ++i)
+    {
+        mean += x[i];
+    }
+    mean /= n;
+
+    // Zero-padded to the FFT size
+    const quint32 size = plan.size();
+    const quint32 bins = plan.binCount();
+    scratch.resize(size + 2 * bins);
+    double *frame = scratch.data();
+    double *re = frame + size;
+    double *im = re + bins;
+    for (quint32 i = 0; i < n; ++i)
+    {
+        frame[i] = (x[i] - mean) * window[i];
+    }
+    std::fill(frame + n, frame + size, 0.0);
+    plan.realForward(frame, re, im);
+
+    // One-sided power spectrum without the DC bin, kept in re for the median
+    double total = 0;
+    double weighted = 0;
+    for (quint32 k = 1; k < bins; ++k)
+    {
+        re[k] = re[k] * re[k] + im[k] * im[k];
+        total += re[k];
+        weighted += k * re[k];
+    }
+    if (!(total > 0))
+    {
+        out[FeatureMnf] = total == 0 ? 0 : qQNaN();
+        out[FeatureMdf] = out[FeatureMnf];
+        return;
+    }
+
+    quint32 median = 1;
+    double cumulative = re[1];
+    while (cumulative < total / 2 && median < bins - 1)
+    {
+        cumulative += re[++median];
+    }
+
+    const double binWidth = sampleRate / size;
+    out[FeatureMnf] = weighted / total * binWidth;
+    out[FeatureMdf] = median * binWidth;
+}
+
+void FeatureExtractor::configure(const FeatureSettings &settings, quint32 channelCount)
+{
+    m_settings = settings;
+    m_settings.windowSize = qMax(MIN_WINDOW_SIZE, settings.windowSize);
+    m_settings.hop = qBound<quint32>(1, settings.hop, m_settings.windowSize);
+    m_channelCount = channelCount;
+    hannWindow(m_window, m_settings.windowSize);
+    quint32 fftSize = 1;
+    while (fftSize < m_settings.windowSize)
+    {
+        fftSize <<= 1;
+    }
+    m_plan = &FftPlan::plan(fftSize);
+    reset();
+}
+
+void FeatureExtractor::reset(void)
+{
+    m_history = QVector<QVector<double>>(m_channelCount);
+    m_historyTimes.clear();
+    m_scratch.clear();
+}
+
+void FeatureExtractor::computeWindow(const QVector<QVector<double>> &channels, qint32 offset, QVector<double> &scratch, float *out) const
+{
+    double features[FEATURE_COUNT];
+    for (quint32 c = 0; c < m_channelCount; ++c)
+    {
+        const double *x = channels[c].constData() + offset;
+        timeFeatures(x, m_settings.windowSize, m_settings.threshold, features);
+        if (qIsNaN(features[FeatureMav]))
+        {
+            // A missing sample in the window
+            std::fill(features, features + FEATURE_COUNT, qQNaN());
+        }
+        else
+        {
+            spectralFeatures(x, m_window, m_settings.sampleRate, *m_plan, scratch, features);
+        }
+
+        for (qint32 f = 0; f < FEATURE_COUNT; ++f)
+        {
+            out[c * FEATURE_COUNT + f] = float(features[f]);
+        }
+    }
+}
+
+void FeatureExtractor::process(const RowBlock &rows, FeatureTable &table)
+{
+    if (!isConfigured())
+    {
+        return;
+    }
+    if (table.channelCount != m_channelCount)
+    {
+        table.clear(m_channelCount, m_settings);
+    }
+
+    // Channels missing from rows are NaN
+    const qint32 count = rows.rowCount();
+    m_historyTimes.append(rows.times);
+    for (quint32 c = 0; c < m_channelCount; ++c)
+    {
+        if (c < quint32(rows.channels.size()) && rows.channels[c].size() == count)
+        {
+            m_history[c].append(rows.channels[c]);
+        }
+        else
+        {
+            m_history[c].resize(m_history[c].size() + count, qQNaN());
+        }
+    }
+
+    const qint32 windowSize = m_settings.windowSize;
+    const qint32 hop = m_settings.hop;
+    qint32 first = 0;
+    for (; first + windowSize <= m_historyTimes.size(); first += hop)
+    {
+        const qint32 row = table.rowCount();
+        table.times.append(m_historyTimes[first + windowSize - 1]);
+        table.values.resize(table.values.size() + table.columnCount());
+        computeWindow(m_history, first, m_scratch, table.values.data() + row * table.columnCount());
+    }
+
+    // Keep what the next windows still need
+    if (first > 0)
+    {
+        m_historyTimes.remove(0, first);
+        for (QVector<double> &history : m_history)
+        {
+            history.remove(0, first);
+        }
+    }
+}
+
+bool FeatureExtractor::extract(const RowBlock &rows, FeatureTable &table, const std::atomic_bool &cancel,
+                               const std::function<void(int)> &progress) const
+{
+    table.clear(m_channelCount, m_settings);
+    const qint32 windowSize = m_settings.windowSize;
+    const qint32 hop = m_settings.hop;
+    if (!isConfigured() || rows.rowCount() < windowSize || quint32(rows.channels.size()) < m_channelCount)
+    {
+        qWarning() << "Not enough data for feature extraction";
+        return false;
+    }
+
+    const qint32 windowCount = (rows.rowCount() - windowSize) / hop + 1;
+    table.times.resize(windowCount);
+    table.values.resize(qsizetype(windowCount) * table.columnCount());
+    for (qint32 w = 0; w < windowCount; ++w)
+    {
+        table.times[w] = rows.times[w * hop + windowSize - 1];
+    }
+
+    // Columns shorter than the time stamps would be read past their end
+    QVector<QVector<double>> channels = rows.channels;
+    for (QVector<double> &column : channels)
+    {
+        if (column.size() < rows.rowCount())
+        {
+            column.resize(rows.rowCount(), qQNaN());
+        }
+    }
+
+    struct Task
+    {
+        qint32 first;
+        qint32 count;
+    };
+    QVector<Task> tasks;
+    for (qint32 first = 0; first < windowCount; first += TASK_WINDOWS)
+    {
+        tasks.append({first, qMin(TASK_WINDOWS, windowCount - first)});
+    }
+
+    float *values = table.values.data();
+    auto run = [this, &channels, values, hop](const Task &task) {
+        QVector<double> scratch;
+        for (qint32 w = task.first; w < task.first + task.count; ++w)
+        {
+            computeWindow(channels, w * hop, scratch, values + qsizetype(w) * m_channelCount * FEATURE_COUNT);
+        }
+    };
+
+    // A few tasks per pool thread in every batch, so cancel and progress stay responsive
+    const qint32 tasksPerBatch = 4 * qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    for (qint32 first = 0; first < tasks.size(); first += tasksPerBatch)
+    {
+        const qint32 last = qMin<qint32>(first + tasksPerBatch, tasks.size());
+        QtConcurrent::blockingMap(tasks.begin() + first, tasks.begin() + last, run);
+        if (cancel)
+        {
+            table.clear(m_channelCount, m_settings);
+            return false;
+        }
+        if (progress)
+        {
+            progress(int(last * 100LL / tasks.size()));
+        }
+    }
+    return true;
+}
+
+bool writeFeatureFile(const QString &fileName, const FeatureTable &table)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Cannot write" << fileName << ":" << file.errorString();
+        return false;
+    }
+
+    FeatureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FEATURE_MAGIC, sizeof(header.magic));
+    header.version = FEATURE_VERSION;
+    header.channelCount = table.channelCount;
+    header.featureCount = FEATURE_COUNT;
+    header.windowSize = table.settings.windowSize;
+    header.hop = table.settings.hop;
+    header.threshold = float(table.settings.threshold);
+    header.sampleRate = table.settings.sampleRate;
+    header.rowCount = table.rowCount();
+
+    // Rows are time then values, written in blocks
+    const qint32 columns = table.columnCount();
+    const qint32 rowSize = sizeof(double) + columns * sizeof(float);
+    const qint32 blockRows = qMax(1, (1 << 20) / rowSize);
+    QByteArray block;
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+    for (qint32 first = 0; ok && first < table.rowCount(); first += blockRows)
+    {
+        const qint32 count = qMin(blockRows, table.rowCount() - first);
+        block.resize(qsizetype(count) * rowSize);
+        char *out = block.data();
+        for (qint32 row = first; row < first + count; ++row)
+        {
+            memcpy(out, &table.times[row], sizeof(double));
+            memcpy(out + sizeof(double), table.values.constData() + qsizetype(row) * columns, columns * sizeof(float));
+            out += rowSize;
+        }
+        ok = file.write(block) == block.size();
+    }
+
+    if (!ok)
+    {
+        qWarning() << "Write failed:" << file.errorString();
+    }
+    return ok;
+}
+
+bool writeFeatureCsv(const QString &fileName, const FeatureTable &table)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qWarning() << "Cannot write" << fileName << ":" << file.errorString();
+        return false;
+    }
+
+    QByteArray text = "time," + table.columnNames().join(',').toLatin1() + '\n';
+    const qint32 columns = table.columnCount();
+    bool ok = true;
+    for (qint32 row = 0; ok && row < table.rowCount(); ++row)
+    {
+        text += QByteArray::number(table.times[row], 'f', 3);
+        const float *values = table.values.constData() + qsizetype(row) * columns;
+        for (qint32 i = 0; i < columns; ++i)
+        {
+            text += ',';
+            text += QByteArray::number(values[i], 'g', 7);
+        }
+        text += '\n';
+
+        // Written in blocks of about 1 MB
+        if (text.size() > (1 << 20) || row == table.rowCount() - 1)
+        {
+            ok = file.write(text) == text.size();
+            text.clear();
+        }
+    }
+    if (ok && table.rowCount() == 0)
+    {
+        ok = file.write(text) == text.size();
+    }
+
+    if (!ok)
+    {
+        qWarning() << "Write failed:" << file.errorString();
+    }
+    return ok;
+}
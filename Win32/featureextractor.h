@@ -0,0 +1,159 @@
+#ifndef FEATUREEXTRACTOR_H
+#define FEATUREEXTRACTOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include "fft.h"
+#include "recording.h"
+
+/*
+ * Feature table file (.armf), little-endian:
+ *
+ *   FeatureFileHeader
+ *   row 0: time (double), then for every channel the FEATURE_COUNT features (float)
+ *   row 1: ...
+ *
+ * Features are in the order of the Feature enum. A window with a missing
+ * sample has NaN features.
+ */
+
+#define FEATURE_EXTENSION ".armf"
+#define FEATURE_MAGIC "ARMBFEAT"
+#define FEATURE_VERSION 1
+
+enum Feature
+{
+    FeatureMav, // Mean absolute value
+    FeatureWl, // Waveform length
+    FeatureZc, // Zero crossings
+    FeatureSsc, // Slope sign changes
+    FeatureRms,
+    FeatureMnf, // Mean frequency (Hz)
+    FeatureMdf, // Median frequency (Hz)
+    FEATURE_COUNT
+};
+
+#pragma pack(push, 1)
+struct FeatureFileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 channelCount;
+    quint32 featureCount;
+    quint32 windowSize; // Samples
+    quint32 hop; // Samples
+    float threshold;
+    double sampleRate; // Hz
+    quint64 rowCount;
+};
+#pragma pack(pop)
+
+/**
+ * @brief Short name of a feature, as used in the table columns.
+ */
+QString featureName(Feature feature);
+
+/**
+ * @brief Window of the feature extraction.
+ */
+struct FeatureSettings
+{
+    quint32 windowSize = 200; ///< Samples per window.
+    quint32 hop = 50; ///< Samples between the starts of two windows, at most windowSize.
+    double sampleRate = 1000; ///< Hz, for the spectral features.
+    double threshold = 0; ///< Dead zone of ZC (amplitude step) and SSC (threshold^2 on the slope product) against noise.
+};
+
+/**
+ * @brief Features of every window, one row per window.
+ */
+struct FeatureTable
+{
+    quint32 channelCount = 0;
+    FeatureSettings settings;
+    QVector<double> times; ///< Time of the last sample of every window (plot key).
+    QVector<float> values; ///< Row, then channel, then feature.
+
+    qint32 rowCount(void) const { return times.size(); }
+    quint32 columnCount(void) const { return channelCount * FEATURE_COUNT; }
+    float value(qint32 row, quint32 channel, Feature feature) const { return values[(row * channelCount + channel) * FEATURE_COUNT + feature]; }
+    QStringList columnNames(void) const; // "EMG1_MAV", ...
+    void clear(quint32 channels, const FeatureSettings &windowSettings)
+    {
+        channelCount = channels;
+        settings = windowSettings;
+        times.clear();
+        values.clear();
+    }
+};
+
+/**
+ * @brief Windowed time- and frequency-domain EMG features.
+ *
+ * The time-domain features (MAV, WL, ZC, SSC, RMS) come from one pass over
+ * the window that keeps independent partial sums per lane and turns the
+ * comparisons into 0/1 terms, so the loop has no branch and vectorises. MNF
+ * and MDF are the mean and median frequency of the power spectrum of the
+ * window, mean removed and Hann-weighted, zero-padded to a power of two and
+ * transformed with the shared real-input FftPlan of that size.
+ *
+ * The same extractor serves the acquisition stream (process(), windows are
+ * emitted as soon as they are complete) and whole recordings (extract(),
+ * ranges of windows on the thread pool).
+ */
+class FeatureExtractor
+{
+public:
+    // Sets the window and the channel count, clears the stream state
+    void configure(const FeatureSettings &settings, quint32 channelCount);
+    void reset(void);
+
+    bool isConfigured(void) const { return m_channelCount > 0; }
+    const FeatureSettings &settings(void) const { return m_settings; }
+    quint32 channelCount(void) const { return m_channelCount; }
+
+    // Streams rows in, appends a table row for every window they complete
+    void process(const RowBlock &rows, FeatureTable &table);
+
+    /**
+     * @brief Features of every window of a whole recording.
+     *
+     * Windows are split in ranges computed in parallel on the thread pool,
+     * every range for all channels so no two tasks write the same cache line.
+     * The stream state is not used.
+     *
+     * @param progress Called on the calling thread with the percentage of windows done.
+     * @return false if rows is shorter than a window or cancel is set.
+     */
+    bool extract(const RowBlock &rows, FeatureTable &table, const std::atomic_bool &cancel,
+                 const std::function<void(int)> &progress = nullptr) const;
+
+private:
+    // Features of one window of every channel, channels[c] + offset is its first sample
+    void computeWindow(const QVector<QVector<double>> &channels, qint32 offset, QVector<double> &scratch, float *out) const;
+
+    FeatureSettings m_settings;
+    quint32 m_channelCount = 0;
+    QVector<double> m_window; // Hann window of windowSize samples
+    const FftPlan *m_plan = nullptr; // Shared real-input plan of the window, zero-padded
+
+    // Samples of the window being filled while streaming
+    QVector<QVector<double>> m_history;
+    QVector<double> m_historyTimes;
+    QVector<double> m_scratch; // FFT frame and spectrum
+};
+
+/**
+ * @brief Writes a feature table as a .armf file (see the layout above).
+ */
+bool writeFeatureFile(const QString &fileName, const FeatureTable &table);
+
+/**
+ * @brief Writes a feature table as CSV, a time column in seconds and one column per channel and feature.
+ */
+bool writeFeatureCsv(const QString &fileName, const FeatureTable &table);
+
+#endif // FEATUREEXTRACTOR_H
@@ -0,0 +1,323 @@
+#include "fft.h"
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QtMath>
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FFT_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define FFT_NEON
+#include <arm_neon.h>
+#endif
+
+// count butterflies a = a + w b, b = a - w b of one stage
+static inline void butterflies(double *re0, double *im0, double *re1, double *im1, const double *wr, const double *wi, quint32 count)
+{
+    quint32 k = 0;
+#if defined(FFT_SSE2)
+    for (; k + 2 <= count; k += 2)
+    {
+        const __m128d ar = _mm_loadu_pd(re0 + k);
+        const __m128d ai = _mm_loadu_pd(im0 + k);
+        const __m128d br = _mm_loadu_pd(re1 + k);
+        const __m128d bi = _mm_loadu_pd(im1 + k);
+        const __m128d cr = _mm_loadu_pd(wr + k);
+        const __m128d ci = _mm_loadu_pd(wi + k);
+        const __m128d tr = _mm_sub_pd(_mm_mul_pd(br, cr), _mm_mul_pd(bi, ci));
+        const __m128d ti = _mm_add_pd(_mm_mul_pd(br, ci), _mm_mul_pd(bi, cr));
+        _mm_storeu_pd(re1 + k, _mm_sub_pd(ar, tr));
+        _mm_storeu_pd(im1 + k, _mm_sub_pd(ai, ti));
+        _mm_storeu_pd(re0 + k, _mm_add_pd(ar, tr));
+        _mm_storeu_pd(im0 + k, _mm_add_pd(ai, ti));
+    }
+#elif defined(FFT_NEON)
+    for (; k + 2 <= count; k += 2)
+    {
+        const float64x2_t ar = vld1q_f64(re0 + k);
+        const float64x2_t ai = vld1q_f64(im0 + k);
+        const float64x2_t br = vld1q_f64(re1 + k);
+        const float64x2_t bi = vld1q_f64(im1 + k);
+        const float64x2_t cr = vld1q_f64(wr + k);
+        const float64x2_t ci = vld1q_f64(wi + k);
+        const float64x2_t tr = vsubq_f64(vmulq_f64(br, cr), vmulq_f64(bi, ci));
+        const float64x2_t ti = vaddq_f64(vmulq_f64(br, ci), vmulq_f64(bi, cr));
+        vst1q_f64(re1 + k, vsubq_f64(ar, tr));
+        vst1q_f64(im1 + k, vsubq_f64(ai, ti));
+        vst1q_f64(re0 + k, vaddq_f64(ar, tr));
+        vst1q_f64(im0 + k, vaddq_f64(ai, ti));
+    }
+#endif
+    for (; k < count; ++k)
+    {
+        const double tr = re1[k] * wr[k] - im1[k] * wi[k];
+        const double ti = re1[k] * wi[k] + im1[k] * wr[k];
+        re1[k] = re0[k] - tr;
+        im1[k] = im0[k] - ti;
+        re0[k] = re0[k] + tr;
+        im0[k] = im0[k] + ti;
+    }
+}
+
+const FftPlan &FftPlan::plan(quint32 size)
+{
+    static QMutex mutex;
+    static QHash<quint32, const FftPlan *> plans; // Never freed, plans are shared until exit
+
+    if (!isPowerOfTwo(size))
+    {
+        quint32 rounded = 1;
+        while (rounded < size)
+        {
+            rounded <<= 1;
+        }
+        qWarning() << "FFT size is not a power of two:" << size << "using" << rounded;
+        size = rounded;
+    }
+
+    QMutexLocker locker(&mutex);
+    if (const FftPlan *existing = plans.value(size))
+    {
+        return *existing;
+    }
+
+    // Built unlocked, the plan asks for its half-size plan
+    locker.unlock();
+    const FftPlan *created = new FftPlan(size);
+    locker.relock();
+    if (const FftPlan *existing = plans.value(size))
+    {
+        delete created;
+        return *existing;
+    }
+    plans.insert(size, created);
+    return *created;
+}
+
+FftPlan::FftPlan(quint32 size) : m_size(size)
+{
+    quint32 bits = 0;
+    while ((1u << bits) < size)
+    {
+        ++bits;
+    }
+    m_reverse.resize(size);
+    for (quint32 i = 0; i < size; ++i)
+    {
+        quint32 reversed = 0;
+        for (quint32 b = 0; b < bits; ++b)
+        {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        m_reverse[i] = reversed;
+    }
+
+    // Exact twiddles for every stage, no recurrence so no accumulated rounding
+    m_cos.resize(qMax<quint32>(1, size) - 1);
+    m_sin.resize(m_cos.size());
+    for (quint32 half = 1; half < size; half <<= 1)
+    {
+        for (quint32 k = 0; k < half; ++k)
+        {
+            const double angle = M_PI * k / half;
+            m_cos[half - 1 + k] = std::cos(angle);
+            m_sin[half - 1 + k] = -std::sin(angle);
+        }
+    }
+
+    if (size >= 2)
+    {
+        m_half = &plan(size / 2);
+        const quint32 splits = size / 4 + 1;
+        m_splitCos.resize(splits);
+        m_splitSin.resize(splits);
+        for (quint32 k = 0; k < splits; ++k)
+        {
+            const double angle = 2.0 * M_PI * k / size;
+            m_splitCos[k] = std::cos(angle);
+            m_splitSin[k] = -std::sin(angle);
+        }
+    }
+}
+
+void FftPlan::transform(double *re, double *im, bool inverse) const
+{
+    // Swapping the real and imaginary parts before and after the forward transform gives the inverse
+    if (inverse)
+    {
+        std::swap(re, im);
+    }
+
+    const quint32 n = m_size;
+    const quint32 *reverse = m_reverse.constData();
+    for (quint32 i = 0; i < n; ++i)
+    {
+        const quint32 j = reverse[i];
+        if (i < j)
+        {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    // First stage, the twiddle is 1
+    for (quint32 i = 0; i + 1 < n; i += 2)
+    {
+        const double ar = re[i];
+        const double ai = im[i];
+        re[i] = ar + re[i + 1];
+        im[i] = ai + im[i + 1];
+        re[i + 1] = ar - re[i + 1];
+        im[i + 1] = ai - im[i + 1];
+    }
+
+    for (quint32 half = 2; half < n; half <<= 1)
+    {
+        const double *wr = m_cos.constData() + half - 1;
+        const double *wi = m_sin.constData() + half - 1;
+        for (quint32 i = 0; i < n; i += 2 * half)
+        {
+            butterflies(re + i, im + i, re + i + half, im + i + half, wr, wi, half);
+        }
+    }
+}
+
+void FftPlan::realForward(const double *input, double *re, double *im) const
+{
+    if (m_size < 2)
+    {
+        re[0] = m_size ? input[0] : 0;
+        im[0] = 0;
+        return;
+    }
+
+    // Even samples as the real part and odd ones as the imaginary part of a half-size transform
+    const quint32 half = m_size / 2;
+    for (quint32 j = 0; j < half; ++j)
+    {
+        re[j] = input[2 * j];
+        im[j] = input[2 * j + 1];
+    }
+    m_half->transform(re, im);
+
+    // Split Z into the spectra E of the even and O of the odd samples, X[k] = E[k] + W^k O[k]
+    // and X[half - k] = conj(E[k] - W^k O[k]), so bins k and half - k are done together in place
+    const double r0 = re[0];
+    const double i0 = im[0];
+    re[0] = r0 + i0;
+    im[0] = 0;
+    re[half] = r0 - i0;
+    im[half] = 0;
+    for (quint32 k = 1; k <= half / 2; ++k)
+    {
+        const quint32 j = half - k;
+        const double er = 0.5 * (re[k] + re[j]);
+        const double ei = 0.5 * (im[k] - im[j]);
+        const double odr = 0.5 * (im[k] + im[j]);
+        const double odi = 0.5 * (re[j] - re[k]);
+        const double tr = odr * m_splitCos[k] - odi * m_splitSin[k];
+        const double ti = odr * m_splitSin[k] + odi * m_splitCos[k];
+        re[k] = er + tr;
+        im[k] = ei + ti;
+        re[j] = er - tr;
+        im[j] = ti - ei;
+    }
+}
+
+void FftPlan::realForwardBatch(const double *input, qint32 inputStride, qint32 count, double *re, double *im, qint32 outputStride) const
+{
+    for (qint32 i = 0; i < count; ++i)
+    {
+        realForward(input + qint64(i) * inputStride, re + qint64(i) * outputStride, im + qint64(i) * outputStride);
+    }
+}
+
+void channelSpectra(const QVector<QVector<double>> &channels, qint32 first, const QVector<double> &window,
+                    quint32 fftSize, ChannelSpectra &spectra)
+{
+    const FftPlan &plan = FftPlan::plan(qMax<quint32>(fftSize, window.size()));
+    const quint32 size = plan.size();
+    const quint32 length = window.size();
+    const qint32 channelCount = channels.size();
+    spectra.fftSize = size;
+    spectra.binCount = plan.binCount();
+    spectra.re.resize(channelCount * spectra.binCount);
+    spectra.im.resize(channelCount * spectra.binCount);
+
+    // Windowed frames of all channels, one after the other, then one batch
+    QVector<double> frames(channelCount * size, 0.0);
+    for (qint32 c = 0; c < channelCount; ++c)
+    {
+        const QVector<double> &channel = channels[c];
+        const quint32 available = quint32(qBound<qint64>(0, channel.size() - qint64(first), length));
+        const double *x = channel.constData() + first;
+        double mean = 0;
+        for (quint32 i = 0; i < available; ++i)
+        {
+            mean += x[i];
+        }
+        mean = available ? mean / available : 0;
+
+        double *frame = frames.data() + c * size;
+        for (quint32 i = 0; i < available; ++i)
+        {
+            frame[i] = (x[i] - mean) * window[i];
+        }
+    }
+    plan.realForwardBatch(frames.constData(), size, channelCount, spectra.re.data(), spectra.im.data(), spectra.binCount);
+}
+
+void fftInPlace(QVector<Complex> &data, bool inverse)
+{
+    const quint32 n = data.size();
+    if (!isPowerOfTwo(n))
+    {
+        qWarning() << "FFT size is not a power of two:" << n;
+        return;
+    }
+
+    QVector<double> re(n);
+    QVector<double> im(n);
+    for (quint32 i = 0; i < n; ++i)
+    {
+        re[i] = data[i].real();
+        im[i] = data[i].imag();
+    }
+    FftPlan::plan(n).transform(re.data(), im.data(), inverse);
+    for (quint32 i = 0; i < n; ++i)
+    {
+        data[i] = Complex(re[i], im[i]);
+    }
+}
+
+void naiveDft(const double *input, quint32 size, double *re, double *im)
+{
+    for (quint32 k = 0; k <= size / 2; ++k)
+    {
+        double sumRe = 0;
+        double sumIm = 0;
+        for (quint32 i = 0; i < size; ++i)
+        {
+            // Index reduced first so the angle stays exact for large k * i
+            const double angle = 2.0 * M_PI * ((quint64(k) * i) % size) / size;
+            sumRe += input[i] * std::cos(angle);
+            sumIm -= input[i] * std::sin(angle);
+        }
+        re[k] = sumRe;
+        im[k] = sumIm;
+    }
+}
+
+void hannWindow(QVector<double> &window, quint32 size)
+{
+    window.resize(size);
+    for (quint32 i = 0; i < size; ++i)
+    {
+        window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / size);
+    }
+}
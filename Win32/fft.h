@@ -0,0 +1,109 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <QVector>
+#include <complex>
+
+typedef std::complex<double> Complex;
+
+/**
+ * @brief Returns true if n is a non-zero power of two.
+ */
+inline bool isPowerOfTwo(quint32 n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * @brief Radix-2 FFT of one size with all its tables precomputed.
+ *
+ * Complex data is held split, real parts in one array and imaginary parts in
+ * another, so every butterfly stage runs over contiguous twiddles and data
+ * two at a time in SSE2 or NEON registers (scalar elsewhere, same operations
+ * in the same order). The inverse transform is the forward one with the two
+ * arrays swapped.
+ *
+ * Real input of size n goes through a complex transform of size n / 2 on the
+ * even and odd samples followed by one split pass, which halves the work of
+ * a complex transform with a zero imaginary part.
+ *
+ * Plans are immutable once built; plan() builds each size once and shares
+ * it between threads for the lifetime of the program.
+ */
+class FftPlan
+{
+public:
+    // Shared plan of the given size (a power of two), built on first use
+    static const FftPlan &plan(quint32 size);
+
+    explicit FftPlan(quint32 size);
+
+    quint32 size(void) const { return m_size; }
+    quint32 binCount(void) const { return m_size / 2 + 1; } ///< Bins of a real-input spectrum.
+
+    // In-place transform of size() values, the inverse is not scaled
+    void transform(double *re, double *im, bool inverse = false) const;
+
+    // Spectrum of size() real samples, binCount() values written to re and im
+    void realForward(const double *input, double *re, double *im) const;
+
+    // realForward() of count inputs, input i at input + i * inputStride and its bins at re/im + i * outputStride
+    void realForwardBatch(const double *input, qint32 inputStride, qint32 count, double *re, double *im, qint32 outputStride) const;
+
+private:
+    quint32 m_size;
+    QVector<quint32> m_reverse; // Bit-reversed index of every position
+    QVector<double> m_cos; // Twiddles of every stage, stage of half length h at offset h - 1
+    QVector<double> m_sin; // Negated sines, forward transform
+    QVector<double> m_splitCos; // Twiddles of the real-input split pass, n / 4 + 1 of them
+    QVector<double> m_splitSin;
+    const FftPlan *m_half = nullptr; // Complex plan of size / 2 for real input
+};
+
+/**
+ * @brief Real spectra of one window of every channel.
+ */
+struct ChannelSpectra
+{
+    quint32 fftSize = 0;
+    quint32 binCount = 0;
+    QVector<double> re; ///< binCount values per channel, channel after channel.
+    QVector<double> im;
+
+    double power(quint32 channel, quint32 bin) const
+    {
+        const qint32 i = channel * binCount + bin;
+        return re[i] * re[i] + im[i] * im[i];
+    }
+};
+
+/**
+ * @brief Spectra of the rows first .. first + window.size() - 1 of every channel.
+ *
+ * Every channel has its mean removed, is weighted by window and zero-padded
+ * to fftSize (a power of two, at least window.size()), then all channels are
+ * transformed as one batch with the shared plan. A channel shorter than the
+ * window is treated as zeros past its end.
+ */
+void channelSpectra(const QVector<QVector<double>> &channels, qint32 first, const QVector<double> &window,
+                    quint32 fftSize, ChannelSpectra &spectra);
+
+/**
+ * @brief In-place iterative radix-2 FFT.
+ *
+ * @param data Samples to transform, size must be a power of two.
+ * @param inverse Computes the unscaled inverse transform if true.
+ */
+void fftInPlace(QVector<Complex> &data, bool inverse = false);
+
+/**
+ * @brief Direct O(n^2) DFT of real samples, the reference the FFT is checked against.
+ */
+void naiveDft(const double *input, quint32 size, double *re, double *im);
+
+/**
+ * @brief Fills window with a periodic Hann window of the given size.
+ */
+void hannWindow(QVector<double> &window, quint32 size);
+
+#endif // FFT_H
@@ -0,0 +1,60 @@
+#include "filejob.h"
+#include <QtConcurrent>
+
+FileJob::FileJob(const QString &label, bool finishOnExit, QWidget *parent)
+    : QObject(parent), m_cancel(false), m_percent(-1), m_finishOnExit(finishOnExit)
+{
+    m_dialog = new QProgressDialog(label, "Cancel", 0, 100, parent);
+    m_dialog->setWindowModality(Qt::NonModal);
+    m_dialog->setMinimumDuration(500);
+    m_dialog->setAutoClose(false);
+    m_dialog->setAutoReset(false);
+    connect(m_dialog, &QProgressDialog::canceled, this, &FileJob::cancel);
+
+    connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &FileJob::onFinished);
+}
+
+FileJob::~FileJob()
+{
+    // The work uses this job for progress, it must be done before the job goes away
+    if (!m_finishOnExit)
+    {
+        m_cancel = true;
+    }
+    m_watcher.waitForFinished();
+    delete m_dialog;
+}
+
+void FileJob::start(const Work &work)
+{
+    m_dialog->setValue(0);
+
+    // Only changes are posted to the GUI thread
+    auto progress = [this](int percent) {
+        if (m_percent.exchange(percent) != percent)
+        {
+            QMetaObject::invokeMethod(this, "setProgress", Qt::QueuedConnection, Q_ARG(int, percent));
+        }
+    };
+    const std::atomic_bool *cancel = &m_cancel;
+    m_watcher.setFuture(QtConcurrent::run([work, cancel, progress]() {
+        return work(*cancel, progress);
+    }));
+}
+
+void FileJob::setProgress(int percent)
+{
+    if (m_dialog)
+    {
+        m_dialog->setValue(percent);
+    }
+}
+
+void FileJob::onFinished(void)
+{
+    if (m_dialog)
+    {
+        m_dialog->hide();
+    }
+    emit finished(!m_cancel && m_watcher.result());
+}
@@ -0,0 +1,53 @@
+#ifndef FILEJOB_H
+#define FILEJOB_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QProgressDialog>
+#include <atomic>
+#include <functional>
+
+/**
+ * @brief Runs a file load or save on the thread pool behind a progress dialog.
+ *
+ * The dialog is not modal, so the window (and live acquisition) stays usable
+ * while the job runs. Cancel sets the flag passed to the work function, which
+ * is expected to poll it. finished() is emitted on the GUI thread, which is
+ * where results must be published.
+ */
+class FileJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Work run on the pool. progress (0-100) may be called from any thread. Returns false on error
+    typedef std::function<bool(const std::atomic_bool &cancel, const std::function<void(int)> &progress)> Work;
+
+    // With finishOnExit, destroying the job waits for it instead of cancelling it (saves)
+    FileJob(const QString &label, bool finishOnExit, QWidget *parent);
+    ~FileJob();
+
+    void start(const Work &work);
+    bool isRunning(void) const { return m_watcher.isRunning(); }
+
+public slots:
+    void cancel(void) { m_cancel = true; }
+
+signals:
+    // ok is false if the work failed or was cancelled
+    void finished(bool ok);
+
+private slots:
+    void setProgress(int percent);
+    void onFinished(void);
+
+private:
+    QPointer<QProgressDialog> m_dialog;
+    QFutureWatcher<bool> m_watcher;
+    std::atomic_bool m_cancel;
+    std::atomic_int m_percent; // Last value posted to the dialog
+    bool m_finishOnExit;
+};
+
+#endif // FILEJOB_H
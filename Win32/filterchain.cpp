@@ -0,0 +1,142 @@
+#include "filterchain.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QtMath>
+
+// Q of the two sections of a fourth-order Butterworth
+static const double BUTTERWORTH4_Q[2] = {0.54119610, 1.30656296};
+// Highest usable cutoff as a fraction of the sample rate
+static const double MAX_CUTOFF_RATIO = 0.45;
+
+void BiquadStage::configure(quint32 channelCount, double sampleRate)
+{
+    m_bank.configure(design(sampleRate), channelCount);
+}
+
+void BiquadStage::process(RowBlock &rows)
+{
+    m_bank.process(rows.channels, rows.rowCount());
+}
+
+QString DcRemovalStage::name(void) const
+{
+    return "DC removal";
+}
+
+QVector<BiquadCoefficients> DcRemovalStage::design(double sampleRate) const
+{
+    return {BiquadCoefficients::firstOrderHighPass(sampleRate, m_cutoff)};
+}
+
+QString BandPassStage::name(void) const
+{
+    return QString("Band-pass %1-%2 Hz").arg(m_lower).arg(m_upper);
+}
+
+QVector<BiquadCoefficients> BandPassStage::design(double sampleRate) const
+{
+    const double maxCutoff = MAX_CUTOFF_RATIO * sampleRate;
+    QVector<BiquadCoefficients> sections;
+    if (m_lower < maxCutoff)
+    {
+        for (double q : BUTTERWORTH4_Q)
+        {
+            sections.append(BiquadCoefficients::highPass(sampleRate, m_lower, q));
+        }
+    }
+    if (m_upper < maxCutoff)
+    {
+        for (double q : BUTTERWORTH4_Q)
+        {
+            sections.append(BiquadCoefficients::lowPass(sampleRate, m_upper, q));
+        }
+    }
+    else
+    {
+        qInfo() << name() << "at" << sampleRate << "Hz: upper edge above the usable band, high-pass only";
+    }
+    return sections;
+}
+
+QString NotchStage::name(void) const
+{
+    return QString("Notch %1 Hz").arg(m_frequency);
+}
+
+QVector<BiquadCoefficients> NotchStage::design(double sampleRate) const
+{
+    if (m_frequency >= MAX_CUTOFF_RATIO * sampleRate)
+    {
+        qInfo() << name() << "at" << sampleRate << "Hz: above the usable band, disabled";
+        return {};
+    }
+    return {BiquadCoefficients::notch(sampleRate, m_frequency, m_q)};
+}
+
+FilterChain::~FilterChain()
+{
+    clear();
+}
+
+void FilterChain::append(FilterStage *stage)
+{
+    m_stages.append(stage);
+    m_sampleRate = 0;
+    resetCost();
+}
+
+void FilterChain::clear(void)
+{
+    qDeleteAll(m_stages);
+    m_stages.clear();
+    m_sampleRate = 0;
+    resetCost();
+}
+
+void FilterChain::configure(quint32 channelCount, double sampleRate)
+{
+    m_channelCount = channelCount;
+    m_sampleRate = sampleRate;
+    for (FilterStage *stage : std::as_const(m_stages))
+    {
+        stage->configure(channelCount, sampleRate);
+    }
+    resetCost();
+    qDebug() << "Filter chain configured:" << channelCount << "channels at" << sampleRate << "Hz";
+}
+
+void FilterChain::process(RowBlock &rows)
+{
+    if (!isConfigured())
+        return;
+
+    QElapsedTimer timer;
+    for (qint32 i = 0; i < m_stages.size(); ++i)
+    {
+        timer.start();
+        m_stages[i]->process(rows);
+        m_stageNsecs[i] += timer.nsecsElapsed();
+    }
+    m_samples += qint64(rows.rowCount()) * m_channelCount;
+}
+
+double FilterChain::stageCost(qint32 index) const
+{
+    return m_samples > 0 ? double(m_stageNsecs[index]) / m_samples : 0;
+}
+
+QStringList FilterChain::costReport(void) const
+{
+    QStringList lines;
+    for (qint32 i = 0; i < m_stages.size(); ++i)
+    {
+        lines << QString("%1: %2 ns/sample").arg(m_stages[i]->name()).arg(stageCost(i), 0, 'f', 1);
+    }
+    return lines;
+}
+
+void FilterChain::resetCost(void)
+{
+    m_stageNsecs = QVector<qint64>(m_stages.size(), 0);
+    m_samples = 0;
+}
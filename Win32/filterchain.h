@@ -0,0 +1,149 @@
+#ifndef FILTERCHAIN_H
+#define FILTERCHAIN_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "biquadbank.h"
+#include "recording.h"
+
+/**
+ * @brief One stage of a FilterChain.
+ *
+ * A stage keeps its own state per channel and filters whole blocks of rows
+ * in place.
+ */
+class FilterStage
+{
+public:
+    virtual ~FilterStage() {}
+
+    virtual QString name(void) const = 0;
+
+    // Sets the stream parameters and clears the state
+    virtual void configure(quint32 channelCount, double sampleRate) = 0;
+
+    // Filters the rows of one block in place
+    virtual void process(RowBlock &rows) = 0;
+};
+
+/**
+ * @brief Stage made of cascaded biquad sections, the same for every channel.
+ *
+ * The sections run in a BiquadBank, all channels at once. Subclasses only
+ * design the sections for a sample rate. A design may be empty when the stage
+ * makes no sense at that rate (cutoff above Nyquist), the stage then passes
+ * the samples through.
+ */
+class BiquadStage : public FilterStage
+{
+public:
+    void configure(quint32 channelCount, double sampleRate) override;
+    void process(RowBlock &rows) override;
+
+    qint32 sectionCount(void) const { return m_bank.sectionCount(); }
+
+protected:
+    virtual QVector<BiquadCoefficients> design(double sampleRate) const = 0;
+
+private:
+    BiquadBank m_bank;
+};
+
+/**
+ * @brief Removes the offset of the raw ADC values (first-order high-pass).
+ */
+class DcRemovalStage : public BiquadStage
+{
+public:
+    explicit DcRemovalStage(double cutoff = 0.5) : m_cutoff(cutoff) {}
+    QString name(void) const override;
+
+protected:
+    QVector<BiquadCoefficients> design(double sampleRate) const override;
+
+private:
+    double m_cutoff;
+};
+
+/**
+ * @brief Fourth-order Butterworth band-pass (high-pass and low-pass cascade).
+ *
+ * The low-pass half is left out if the upper edge is too close to Nyquist.
+ */
+class BandPassStage : public BiquadStage
+{
+public:
+    BandPassStage(double lower = 20, double upper = 450) : m_lower(lower), m_upper(upper) {}
+    QString name(void) const override;
+
+protected:
+    QVector<BiquadCoefficients> design(double sampleRate) const override;
+
+private:
+    double m_lower;
+    double m_upper;
+};
+
+/**
+ * @brief Narrow notch against mains interference.
+ */
+class NotchStage : public BiquadStage
+{
+public:
+    explicit NotchStage(double frequency = 50, double q = 30) : m_frequency(frequency), m_q(q) {}
+    QString name(void) const override;
+
+protected:
+    QVector<BiquadCoefficients> design(double sampleRate) const override;
+
+private:
+    double m_frequency;
+    double m_q;
+};
+
+/**
+ * @brief Ordered list of filter stages applied block by block to the acquired rows.
+ *
+ * The chain owns its stages. It stays unconfigured, and process() does
+ * nothing, until the channel count and sample rate of the stream are known.
+ * The time spent in every stage is accumulated so the cost of the chain can
+ * be reported per stage.
+ */
+class FilterChain
+{
+public:
+    FilterChain() {}
+    ~FilterChain();
+    Q_DISABLE_COPY(FilterChain)
+
+    // Takes ownership of stage, the chain must be configured again
+    void append(FilterStage *stage);
+    void clear(void);
+    qint32 stageCount(void) const { return m_stages.size(); }
+    FilterStage *stage(qint32 index) const { return m_stages[index]; }
+
+    void configure(quint32 channelCount, double sampleRate);
+    bool isConfigured(void) const { return m_sampleRate > 0; }
+    quint32 channelCount(void) const { return m_channelCount; }
+    double sampleRate(void) const { return m_sampleRate; }
+
+    // Runs every stage over rows in place
+    void process(RowBlock &rows);
+
+    // Average time spent per sample (one value of one channel) in a stage, in nanoseconds
+    double stageCost(qint32 index) const;
+    // One line per stage with its cost
+    QStringList costReport(void) const;
+    void resetCost(void);
+
+private:
+    QList<FilterStage*> m_stages;
+    QVector<qint64> m_stageNsecs;
+    qint64 m_samples = 0;
+    quint32 m_channelCount = 0;
+    double m_sampleRate = 0;
+};
+
+#endif // FILTERCHAIN_H
@@ -0,0 +1,226 @@
+#include "gestureclassifier.h"
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+const quint32 ROW_BLOCK = 8; // Floats per padded block of a weight row
+
+static quint32 paddedLength(quint32 length)
+{
+    return (length + ROW_BLOCK - 1) / ROW_BLOCK * ROW_BLOCK;
+}
+
+// Dot product of two padded rows, in independent partial sums
+static inline float dot(const float *weights, const float *x, quint32 stride)
+{
+    float sum[ROW_BLOCK] = {};
+    for (quint32 i = 0; i < stride; i += ROW_BLOCK)
+    {
+        for (quint32 lane = 0; lane < ROW_BLOCK; ++lane)
+        {
+            sum[lane] += weights[i + lane] * x[i + lane];
+        }
+    }
+    return ((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+
+static bool readNumbers(const QJsonValue &value, QVector<float> &numbers)
+{
+    if (!value.isArray())
+        return false;
+    const QJsonArray array = value.toArray();
+    numbers.resize(array.size());
+    for (qint32 i = 0; i < array.size(); ++i)
+    {
+        if (!array[i].isDouble())
+            return false;
+        numbers[i] = float(array[i].toDouble());
+    }
+    return true;
+}
+
+void GestureClassifier::clear(void)
+{
+    *this = GestureClassifier();
+}
+
+bool GestureClassifier::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open" << fileName << ":" << file.errorString();
+        return false;
+    }
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isObject())
+    {
+        qWarning() << "Invalid gesture model" << fileName << ":" << error.errorString();
+        return false;
+    }
+    const QJsonObject root = document.object();
+
+    GestureClassifier model;
+    model.m_fileName = fileName;
+    model.m_type = root["type"].toString().toLower();
+    for (const QJsonValue &name : root["classes"].toArray())
+    {
+        model.m_classes << name.toString();
+    }
+    for (const QJsonValue &name : root["features"].toArray())
+    {
+        model.m_features << name.toString();
+    }
+    if (model.m_type != "lda" && model.m_type != "svm" && model.m_type != "mlp")
+    {
+        qWarning() << "Unknown gesture model type" << model.m_type << "in" << fileName;
+        return false;
+    }
+    if (model.m_classes.size() < 2 || model.m_features.isEmpty())
+    {
+        qWarning() << "Gesture model" << fileName << "needs two classes and one feature at least";
+        return false;
+    }
+
+    // Optional standardisation of the inputs
+    const qint32 inputCount = model.m_features.size();
+    model.m_mean = QVector<float>(inputCount, 0.0f);
+    model.m_scale = QVector<float>(inputCount, 1.0f);
+    if ((root.contains("mean") && (!readNumbers(root["mean"], model.m_mean) || model.m_mean.size() != inputCount))
+        || (root.contains("scale") && (!readNumbers(root["scale"], model.m_scale) || model.m_scale.size() != inputCount)))
+    {
+        qWarning() << "Gesture model" << fileName << "has a mean or scale not matching its features";
+        return false;
+    }
+    for (float &scale : model.m_scale)
+    {
+        // Kept as the reciprocal, so the inputs are multiplied
+        scale = scale != 0 ? 1.0f / scale : 1.0f;
+    }
+
+    // Layers, every one fed by the previous
+    quint32 inputs = inputCount;
+    quint32 widest = paddedLength(inputs);
+    for (const QJsonValue &value : root["layers"].toArray())
+    {
+        const QJsonObject object = value.toObject();
+        const QJsonArray rows = object["weights"].toArray();
+        Layer layer;
+        layer.inputs = inputs;
+        layer.outputs = rows.size();
+        layer.stride = paddedLength(inputs);
+        layer.weights = QVector<float>(layer.outputs * layer.stride, 0.0f);
+        for (quint32 o = 0; o < layer.outputs; ++o)
+        {
+            QVector<float> row;
+            if (!readNumbers(rows[o], row) || quint32(row.size()) != inputs)
+            {
+                qWarning() << "Gesture model" << fileName << "has a weight row of the wrong size in layer" << model.m_layers.size() + 1;
+                return false;
+            }
+            std::copy(row.constBegin(), row.constEnd(), layer.weights.begin() + o * layer.stride);
+        }
+        if (!readNumbers(object["bias"], layer.bias) || quint32(layer.bias.size()) != layer.outputs || layer.outputs == 0)
+        {
+            qWarning() << "Gesture model" << fileName << "has a bias of the wrong size in layer" << model.m_layers.size() + 1;
+            return false;
+        }
+        model.m_layers.append(layer);
+        inputs = layer.outputs;
+        widest = qMax(widest, paddedLength(inputs));
+    }
+    if (model.m_layers.isEmpty() || inputs != quint32(model.m_classes.size()) || (model.m_type != "mlp" && model.m_layers.size() != 1))
+    {
+        qWarning() << "Gesture model" << fileName << "layers do not map the features to the classes";
+        return false;
+    }
+
+    for (QVector<float> &activations : model.m_activations)
+    {
+        activations = QVector<float>(widest, 0.0f);
+    }
+    *this = model;
+    qInfo() << "Gesture model" << m_type.toUpper() << "with" << m_layers.size() << "layers," << m_features.size()
+            << "features and" << m_classes.size() << "classes from" << fileName;
+    return true;
+}
+
+bool GestureClassifier::bind(const QStringList &columns)
+{
+    m_columns.clear();
+    for (const QString &name : std::as_const(m_features))
+    {
+        qint32 column = columns.indexOf(name);
+        if (column < 0)
+        {
+            qWarning() << "Feature" << name << "of the gesture model is not computed";
+            m_columns.clear();
+            return false;
+        }
+        m_columns.append(column);
+    }
+    return true;
+}
+
+qint32 GestureClassifier::classify(const float *row, double *confidence)
+{
+    if (!isBound())
+    {
+        return -1;
+    }
+
+    // Standardised inputs, the padding stays zero
+    float *input = m_activations[0].data();
+    float *output = m_activations[1].data();
+    for (qint32 i = 0; i < m_columns.size(); ++i)
+    {
+        const float value = row[m_columns[i]];
+        if (qIsNaN(value))
+        {
+            return -1;
+        }
+        input[i] = (value - m_mean[i]) * m_scale[i];
+    }
+    std::fill(input + m_columns.size(), input + m_activations[0].size(), 0.0f);
+
+    for (qint32 l = 0; l < m_layers.size(); ++l)
+    {
+        const Layer &layer = m_layers[l];
+        const bool hidden = l < m_layers.size() - 1;
+        const float *weights = layer.weights.constData();
+        for (quint32 o = 0; o < layer.outputs; ++o)
+        {
+            const float value = dot(weights + o * layer.stride, input, layer.stride) + layer.bias[o];
+            output[o] = hidden ? qMax(0.0f, value) : value;
+        }
+
+        // The next layer reads past its inputs up to its stride
+        std::fill(output + layer.outputs, output + m_activations[0].size(), 0.0f);
+        std::swap(input, output);
+    }
+
+    // Scores are in input after the last swap
+    const qint32 classCount = m_classes.size();
+    qint32 best = 0;
+    for (qint32 c = 1; c < classCount; ++c)
+    {
+        if (input[c] > input[best])
+            best = c;
+    }
+    if (confidence)
+    {
+        double sum = 0;
+        for (qint32 c = 0; c < classCount; ++c)
+        {
+            sum += std::exp(double(input[c] - input[best]));
+        }
+        *confidence = 1.0 / sum;
+    }
+    return best;
+}
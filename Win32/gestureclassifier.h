@@ -0,0 +1,73 @@
+#ifndef GESTURECLASSIFIER_H
+#define GESTURECLASSIFIER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief Gesture model trained offline, applied to one feature table row at a time.
+ *
+ * Models are JSON files written by the training scripts:
+ *
+ *   {
+ *     "type": "lda" | "svm" | "mlp",
+ *     "classes": ["rest", "fist", ...],
+ *     "features": ["EMG1_MAV", "EMG1_WL", ...],   // FeatureTable column names
+ *     "mean": [...], "scale": [...],              // optional, x' = (x - mean) / scale
+ *     "layers": [{"weights": [[...], ...], "bias": [...]}, ...]
+ *   }
+ *
+ * Every layer computes W x + b, with weights given as one row per output.
+ * LDA and linear SVM models have a single layer whose outputs are the class
+ * scores; MLP hidden layers are followed by a ReLU. The confidence is the
+ * softmax of the class scores.
+ *
+ * Weights are stored as float rows in one contiguous block, each row padded
+ * with zeros to a multiple of 8 floats, so a dot product runs over whole
+ * blocks of 8 with no remainder loop, in independent partial sums the
+ * compiler can vectorise. Rows are only padded, not aligned in memory; the
+ * vector loads are unaligned ones.
+ */
+class GestureClassifier
+{
+public:
+    // Reads and checks a model, the previous one is kept on error
+    bool load(const QString &fileName);
+    void clear(void);
+
+    bool isLoaded(void) const { return !m_layers.isEmpty(); }
+    const QString &type(void) const { return m_type; }
+    const QStringList &classes(void) const { return m_classes; }
+    const QStringList &featureNames(void) const { return m_features; }
+    const QString &fileName(void) const { return m_fileName; }
+
+    // Finds the model inputs among the columns of a feature table, false if one is missing
+    bool bind(const QStringList &columns);
+    bool isBound(void) const { return isLoaded() && m_columns.size() == m_features.size(); }
+
+    // Class of a bound table row with its confidence, -1 if a feature is missing (NaN)
+    qint32 classify(const float *row, double *confidence = nullptr);
+
+private:
+    struct Layer
+    {
+        quint32 inputs = 0;
+        quint32 outputs = 0;
+        quint32 stride = 0; // Padded row length
+        QVector<float> weights; // outputs rows of stride floats
+        QVector<float> bias;
+    };
+
+    QString m_fileName;
+    QString m_type;
+    QStringList m_classes;
+    QStringList m_features;
+    QVector<float> m_mean;
+    QVector<float> m_scale;
+    QVector<Layer> m_layers;
+    QVector<qint32> m_columns; // Table column of every input
+    QVector<float> m_activations[2]; // Input and output of the current layer, padded with zeros
+};
+
+#endif // GESTURECLASSIFIER_H
@@ -0,0 +1,74 @@
+#include "onsetdetector.h"
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+
+void OnsetDetector::configure(quint32 channelCount, quint32 calibrationSamples, quint32 windowSize, quint32 minAbove, double thresholdSd)
+{
+    m_calibrationSamples = qMax<quint32>(2, calibrationSamples);
+    m_windowSize = qMax<quint32>(1, windowSize);
+    m_minAbove = qBound<quint32>(1, minAbove, m_windowSize);
+    m_thresholdSd = thresholdSd;
+    m_channels = QVector<ChannelState>(channelCount);
+    reset();
+}
+
+void OnsetDetector::reset(void)
+{
+    for (ChannelState &state : m_channels)
+    {
+        state = ChannelState();
+        state.above = QVector<quint8>(m_windowSize, 0);
+    }
+}
+
+void OnsetDetector::process(const RowBlock &envelope, qint64 arrival, QVector<OnsetEvent> &events)
+{
+    if (!isConfigured())
+        return;
+
+    // Channel by channel, then merged, so the events come out in time order
+    const qint32 firstEvent = events.size();
+    const quint32 channels = qMin<quint32>(m_channels.size(), envelope.channels.size());
+    for (quint32 c = 0; c < channels; ++c)
+    {
+        ChannelState &state = m_channels[c];
+        const QVector<double> &values = envelope.channels[c];
+        for (qint32 i = 0; i < values.size() && i < envelope.rowCount(); ++i)
+        {
+            const double value = values[i];
+            if (qIsNaN(value))
+                continue;
+
+            if (state.calibration < m_calibrationSamples)
+            {
+                const double delta = value - state.mean;
+                state.mean += delta / ++state.calibration;
+                state.m2 += delta * (value - state.mean);
+                if (state.calibration == m_calibrationSamples)
+                {
+                    state.threshold = state.mean + m_thresholdSd * qSqrt(state.m2 / (state.calibration - 1));
+                    qInfo() << QString("Onset threshold EMG%1: %2").arg(c + 1).arg(state.threshold, 0, 'f', 2);
+                }
+                continue;
+            }
+
+            const quint8 isAbove = value > state.threshold;
+            state.aboveCount += isAbove;
+            state.aboveCount -= state.above[state.head];
+            state.above[state.head] = isAbove;
+            state.head = (state.head + 1) % m_windowSize;
+
+            const bool active = state.aboveCount >= m_minAbove;
+            if (active != state.active)
+            {
+                state.active = active;
+                events.append({c, active, envelope.times[i], arrival});
+            }
+        }
+    }
+
+    std::stable_sort(events.begin() + firstEvent, events.end(), [](const OnsetEvent &a, const OnsetEvent &b) {
+        return a.time < b.time;
+    });
+}
@@ -0,0 +1,64 @@
+#ifndef ONSETDETECTOR_H
+#define ONSETDETECTOR_H
+
+#include <QVector>
+#include "recording.h"
+
+/**
+ * @brief Muscle activation onset or offset found by OnsetDetector.
+ */
+struct OnsetEvent
+{
+    quint32 channel;
+    bool onset; ///< false for an offset.
+    double time; ///< Time of the sample that decided the event, in seconds (plot key).
+    qint64 arrival; ///< Monotonic time the serial bytes of that sample were read, in ns.
+};
+
+/**
+ * @brief Double-threshold onset detector on envelope channels (after Bonato et al.).
+ *
+ * The first calibrationSamples valid samples of a channel are taken as rest
+ * and give its amplitude threshold, mean + thresholdSd standard deviations.
+ * After that the channel turns active when at least minAbove of the last
+ * windowSize samples are above the threshold, and inactive again when fewer
+ * than minAbove are. Both tests are O(1) per sample with a running count
+ * over a ring of flags.
+ */
+class OnsetDetector
+{
+public:
+    // Sets the parameters, clears the calibration and the state
+    void configure(quint32 channelCount, quint32 calibrationSamples, quint32 windowSize, quint32 minAbove, double thresholdSd = 3);
+    void reset(void);
+
+    bool isConfigured(void) const { return m_windowSize > 0; }
+    quint32 channelCount(void) const { return m_channels.size(); }
+    bool isCalibrated(quint32 channel) const { return m_channels[channel].calibration >= m_calibrationSamples; }
+    double threshold(quint32 channel) const { return m_channels[channel].threshold; }
+    bool isActive(quint32 channel) const { return m_channels[channel].active; }
+
+    // Runs the envelope rows through the detector, appends the events they trigger in time order
+    void process(const RowBlock &envelope, qint64 arrival, QVector<OnsetEvent> &events);
+
+private:
+    struct ChannelState
+    {
+        quint32 calibration = 0; // Rest samples seen
+        double mean = 0; // Welford mean and sum of squared deviations of the rest samples
+        double m2 = 0;
+        double threshold = 0;
+        QVector<quint8> above; // Ring of the last windowSize threshold tests
+        quint32 head = 0;
+        quint32 aboveCount = 0;
+        bool active = false;
+    };
+
+    quint32 m_calibrationSamples = 0;
+    quint32 m_windowSize = 0;
+    quint32 m_minAbove = 0;
+    double m_thresholdSd = 3;
+    QVector<ChannelState> m_channels;
+};
+
+#endif // ONSETDETECTOR_H
@@ -0,0 +1,251 @@
+#include "powerspectrum.h"
+#include <QDebug>
+#include <QThreadPool>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+#include <QtMath>
+#include "qcustomplot.h"
+#include "clocktime.h"
+#include "fft.h"
+#include "definitions.h"
+
+const double MAX_OVERLAP = 0.95;
+
+bool welchPsd(const QVector<QVector<double>> &channels, qint32 first, qint32 count, const WelchSettings &settings,
+              PowerSpectrum &spectrum, const std::atomic_bool *cancel)
+{
+    const FftPlan &plan = FftPlan::plan(qMax<quint32>(2, settings.segmentSize));
+    const qint32 size = plan.size();
+    const qint32 bins = plan.binCount();
+    const qint32 hop = qMax(1, qRound(size * (1.0 - qBound(0.0, settings.overlap, MAX_OVERLAP))));
+    const qint32 channelCount = channels.size();
+    spectrum.settings = settings;
+    spectrum.settings.segmentSize = size;
+    if (count < size || channelCount == 0 || settings.sampleRate <= 0)
+    {
+        return false;
+    }
+    const qint32 segmentCount = (count - size) / hop + 1;
+
+    // Tables shared by every segment
+    QVector<double> window;
+    hannWindow(window, size);
+    double windowPower = 0;
+    for (double w : std::as_const(window))
+    {
+        windowPower += w * w;
+    }
+
+    struct Task
+    {
+        qint32 first;
+        qint32 count;
+        QVector<double> sums; // channelCount * bins periodogram sums
+        QVector<qint32> segments;
+    };
+    const qint32 taskCount = qMin(segmentCount, 4 * qMax(1, QThreadPool::globalInstance()->maxThreadCount()));
+    QVector<Task> tasks(taskCount);
+    for (qint32 t = 0; t < taskCount; ++t)
+    {
+        tasks[t].first = qint64(segmentCount) * t / taskCount;
+        tasks[t].count = qint64(segmentCount) * (t + 1) / taskCount - tasks[t].first;
+    }
+
+    QtConcurrent::blockingMap(tasks, [&](Task &task) {
+        task.sums = QVector<double>(channelCount * bins, 0.0);
+        task.segments = QVector<qint32>(channelCount, 0);
+        QVector<double> frame(size);
+        QVector<double> re(bins);
+        QVector<double> im(bins);
+        for (qint32 s = task.first; s < task.first + task.count; ++s)
+        {
+            if (cancel && *cancel)
+            {
+                return;
+            }
+            const qint64 offset = first + qint64(s) * hop;
+            for (qint32 c = 0; c < channelCount; ++c)
+            {
+                if (channels[c].size() < offset + size)
+                {
+                    continue;
+                }
+                const double *x = channels[c].constData() + offset;
+                double mean = 0;
+                for (qint32 i = 0; i < size; ++i)
+                {
+                    mean += x[i];
+                }
+                mean /= size;
+                if (qIsNaN(mean))
+                {
+                    // A missing sample, the segment is left out of this channel
+                    continue;
+                }
+
+                for (qint32 i = 0; i < size; ++i)
+                {
+                    frame[i] = (x[i] - mean) * window[i];
+                }
+                plan.realForward(frame.constData(), re.data(), im.data());
+                double *sums = task.sums.data() + c * bins;
+                for (qint32 k = 0; k < bins; ++k)
+                {
+                    sums[k] += re[k] * re[k] + im[k] * im[k];
+                }
+                ++task.segments[c];
+            }
+        }
+    });
+    if (cancel && *cancel)
+    {
+        return false;
+    }
+
+    // Average, scaled to a density and folded onto the positive frequencies
+    spectrum.frequencies.resize(bins);
+    for (qint32 k = 0; k < bins; ++k)
+    {
+        spectrum.frequencies[k] = k * settings.sampleRate / size;
+    }
+    spectrum.density = QVector<QVector<double>>(channelCount, QVector<double>(bins, 0.0));
+    spectrum.segments = QVector<qint32>(channelCount, 0);
+    for (const Task &task : std::as_const(tasks))
+    {
+        for (qint32 c = 0; c < channelCount; ++c)
+        {
+            spectrum.segments[c] += task.segments[c];
+            for (qint32 k = 0; k < bins; ++k)
+            {
+                spectrum.density[c][k] += task.sums[c * bins + k];
+            }
+        }
+    }
+    for (qint32 c = 0; c < channelCount; ++c)
+    {
+        const qint32 segments = spectrum.segments[c];
+        const double scale = segments ? 1.0 / (settings.sampleRate * windowPower * segments) : qQNaN();
+        for (qint32 k = 0; k < bins; ++k)
+        {
+            const bool folded = k > 0 && k < bins - 1;
+            spectrum.density[c][k] *= folded ? 2 * scale : scale;
+        }
+    }
+    return true;
+}
+
+PowerSpectrumWindow::PowerSpectrumWindow(QWidget *parent) : QWidget(parent, Qt::Window), m_cancel(false)
+{
+    setWindowTitle(tr("Power spectrum"));
+    resize(640, 420);
+
+    m_plot = new QCustomPlot(this);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_plot);
+
+    // Log-log axes, the usual view of an EMG spectrum
+    QSharedPointer<QCPAxisTickerLog> ticker(new QCPAxisTickerLog);
+    for (QCPAxis *axis : {m_plot->xAxis, m_plot->yAxis})
+    {
+        axis->setScaleType(QCPAxis::stLogarithmic);
+        axis->setTicker(ticker);
+        axis->setNumberFormat("eb");
+        axis->setNumberPrecision(0);
+    }
+    m_plot->xAxis->setLabel("Frequency (Hz)");
+    m_plot->yAxis->setLabel(QString("PSD (%1^2/Hz)").arg(VOLTAGE_UNIT));
+    m_plot->legend->setVisible(true);
+    m_plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+
+    connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &PowerSpectrumWindow::onFinished);
+}
+
+PowerSpectrumWindow::~PowerSpectrumWindow()
+{
+    m_cancel = true;
+    m_watcher.waitForFinished();
+}
+
+void PowerSpectrumWindow::compute(const QVector<QVector<double>> &channels, const QList<QColor> &colors, double start, double end,
+                                  const WelchSettings &settings)
+{
+    // The result of a running estimate is not wanted any more
+    if (m_watcher.isRunning())
+    {
+        m_cancel = true;
+        m_watcher.waitForFinished();
+    }
+    m_cancel = false;
+    m_colors = colors;
+    m_result = PowerSpectrum();
+    m_timer.start();
+
+    m_watcher.setFuture(QtConcurrent::run([this, channels, settings, start, end]() {
+        qint32 rowCount = channels.isEmpty() ? 0 : channels.first().size();
+        m_result.start = start;
+        m_result.end = end;
+        return welchPsd(channels, 0, rowCount, settings, m_result, &m_cancel);
+    }));
+}
+
+void PowerSpectrumWindow::onFinished(void)
+{
+    if (!m_watcher.result())
+    {
+        if (!m_cancel)
+        {
+            qWarning() << "Selection too short for a" << m_result.settings.segmentSize << "sample segment";
+        }
+        return;
+    }
+    qInfo() << QString("Welch PSD of %1 channels, %2 segments of %3 samples in %4 ms")
+                   .arg(m_result.density.size())
+                   .arg(m_result.segments.isEmpty() ? 0 : m_result.segments.first())
+                   .arg(m_result.settings.segmentSize)
+                   .arg(m_timer.elapsed());
+    draw(m_result);
+}
+
+void PowerSpectrumWindow::draw(const PowerSpectrum &spectrum)
+{
+    m_plot->clearGraphs();
+
+    // The DC bin has no place on a log axis
+    QVector<double> frequencies = spectrum.frequencies.mid(1);
+    double lowest = std::numeric_limits<double>::max();
+    double highest = 0;
+    for (qint32 c = 0; c < spectrum.density.size(); ++c)
+    {
+        QVector<double> density = spectrum.density[c].mid(1);
+        for (double value : std::as_const(density))
+        {
+            if (value > 0)
+            {
+                lowest = qMin(lowest, value);
+                highest = qMax(highest, value);
+            }
+        }
+
+        QCPGraph *graph = m_plot->addGraph();
+        graph->setName(QString("EMG %1").arg(c + 1));
+        graph->setPen(QPen(c < m_colors.size() ? m_colors[c] : QColor(Qt::black)));
+        graph->setData(frequencies, density, true);
+    }
+
+    if (!frequencies.isEmpty())
+    {
+        m_plot->xAxis->setRange(frequencies.first(), frequencies.last());
+    }
+    if (highest > 0)
+    {
+        m_plot->yAxis->setRange(lowest, highest * 2);
+    }
+
+    qint64 offset = qint64(QDateTime::fromMSecsSinceEpoch(qRound64(spectrum.start * 1000)).offsetFromUtc()) * 1000;
+    setWindowTitle(tr("Power spectrum %1 - %2 (Welch, %3 samples, %4% overlap)")
+                       .arg(clockTimeToString(qRound64(spectrum.start * 1000) + offset),
+                            clockTimeToString(qRound64(spectrum.end * 1000) + offset))
+                       .arg(spectrum.settings.segmentSize)
+                       .arg(qRound(spectrum.settings.overlap * 100)));
+    m_plot->replot();
+}
@@ -0,0 +1,82 @@
+#ifndef POWERSPECTRUM_H
+#define POWERSPECTRUM_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QColor>
+#include <QVector>
+#include <atomic>
+
+class QCustomPlot;
+
+/**
+ * @brief Segmentation of a Welch estimate.
+ */
+struct WelchSettings
+{
+    quint32 segmentSize = 512; ///< Samples per segment, rounded up to a power of two.
+    double overlap = 0.5; ///< Fraction of a segment shared with the next one, below 1.
+    double sampleRate = 1000; ///< Hz.
+};
+
+/**
+ * @brief One-sided power spectral density of every channel.
+ */
+struct PowerSpectrum
+{
+    WelchSettings settings;
+    QVector<double> frequencies; ///< Hz, one per bin.
+    QVector<QVector<double>> density; ///< Per channel, units^2 / Hz per bin.
+    QVector<qint32> segments; ///< Per channel, segments averaged (those with a missing sample are left out).
+    double start = 0; ///< Time span of the estimate (plot keys).
+    double end = 0;
+};
+
+/**
+ * @brief Welch PSD of the rows first .. first + count - 1 of every channel.
+ *
+ * Segments are mean-removed, Hann-weighted and transformed with the shared
+ * real-input FftPlan of the segment size; their periodograms are averaged.
+ * The window and its power are computed once per call. Ranges of segments
+ * are accumulated in parallel on the thread pool, each for all channels
+ * into its own sums, which are added at the end.
+ *
+ * @return false if the span holds no full segment or cancel is set.
+ */
+bool welchPsd(const QVector<QVector<double>> &channels, qint32 first, qint32 count, const WelchSettings &settings,
+              PowerSpectrum &spectrum, const std::atomic_bool *cancel = nullptr);
+
+/**
+ * @brief Window plotting a PowerSpectrum on log-log axes, one graph per channel.
+ *
+ * compute() runs the estimate on the thread pool and draws it when done; a
+ * new request while one runs cancels the running one.
+ */
+class PowerSpectrumWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PowerSpectrumWindow(QWidget *parent = nullptr);
+    ~PowerSpectrumWindow();
+
+    // channels holds the selected span of every channel, start and end are its times
+    void compute(const QVector<QVector<double>> &channels, const QList<QColor> &colors, double start, double end,
+                 const WelchSettings &settings);
+
+private slots:
+    void onFinished(void);
+
+private:
+    void draw(const PowerSpectrum &spectrum);
+
+    QCustomPlot *m_plot;
+    QList<QColor> m_colors;
+    QFutureWatcher<bool> m_watcher;
+    std::atomic_bool m_cancel;
+    PowerSpectrum m_result; // Written by the running estimate, read once it finished
+    QElapsedTimer m_timer; // Since compute(), for the log
+};
+
+#endif // POWERSPECTRUM_H
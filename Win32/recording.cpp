@@ -0,0 +1,166 @@
+#include "recording.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtMath>
+#include <algorithm>
+
+static const quint32 INDEX_MAGIC = 0x58444941; // "AIDX"
+static const quint32 INDEX_VERSION = 1;
+
+void RecordingIndex::reset(quint32 channels, quint32 rowsInBlock)
+{
+    channelCount = channels;
+    rowsPerBlock = rowsInBlock;
+    rowCount = 0;
+    blockOffsets.clear();
+    blockRows.clear();
+    levels = QVector<PyramidLevel>(1);
+}
+
+void RecordingIndex::appendBlock(qint64 offset, qint32 rows, double start, double end, const double *minimum, const double *maximum)
+{
+    if (levels.isEmpty())
+    {
+        levels.resize(1);
+    }
+
+    blockOffsets.append(offset);
+    blockRows.append(rows);
+    rowCount += rows;
+
+    PyramidLevel &base = levels[0];
+    base.start.append(start);
+    base.end.append(end);
+    for (quint32 c = 0; c < channelCount; ++c)
+    {
+        base.minimum.append(minimum[c]);
+        base.maximum.append(maximum[c]);
+    }
+}
+
+void RecordingIndex::buildPyramid(void)
+{
+    levels.resize(1);
+    while (levels.last().size() > 1)
+    {
+        const PyramidLevel &lower = levels.last();
+        PyramidLevel upper;
+        for (qint32 i = 0; i < lower.size(); i += 2)
+        {
+            // Odd entry at the end is carried over as is
+            qint32 j = qMin(i + 1, lower.size() - 1);
+            upper.start.append(lower.start[i]);
+            upper.end.append(lower.end[j]);
+            for (quint32 c = 0; c < channelCount; ++c)
+            {
+                upper.minimum.append(qMin(lower.minimum[i * channelCount + c], lower.minimum[j * channelCount + c]));
+                upper.maximum.append(qMax(lower.maximum[i * channelCount + c], lower.maximum[j * channelCount + c]));
+            }
+        }
+        levels.append(upper);
+    }
+}
+
+qint32 RecordingIndex::entryAt(qint32 level, double time) const
+{
+    const QVector<double> &end = levels[level].end;
+    return std::lower_bound(end.constBegin(), end.constEnd(), time) - end.constBegin();
+}
+
+qint32 RecordingIndex::levelFor(double lower, double upper, qint32 maxEntries) const
+{
+    for (qint32 level = 0; level < levels.size(); ++level)
+    {
+        qint32 first = entryAt(level, lower);
+        qint32 last = entryAt(level, upper);
+        if (last - first + 1 <= maxEntries)
+        {
+            return level;
+        }
+    }
+    return levels.size() - 1;
+}
+
+double RecordingIndex::startTime(void) const
+{
+    return isEmpty() ? 0 : levels[0].start.first();
+}
+
+double RecordingIndex::endTime(void) const
+{
+    return isEmpty() ? 0 : levels[0].end.last();
+}
+
+QString RecordingIndex::sidecarFileName(const QString &recording)
+{
+    return recording + INDEX_EXTENSION;
+}
+
+bool RecordingIndex::save(const QString &recording) const
+{
+    // The size and modification time of the recording tell if the index is still valid
+    QFileInfo info(recording);
+    QSaveFile file(sidecarFileName(recording));
+    if (isEmpty() || !file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << INDEX_MAGIC << INDEX_VERSION << info.size() << info.lastModified().toMSecsSinceEpoch();
+    out << channelCount << rowsPerBlock << rowCount << blockOffsets << blockRows;
+    const PyramidLevel &base = levels[0];
+    out << base.start << base.end << base.minimum << base.maximum;
+
+    if (out.status() != QDataStream::Ok || !file.commit())
+    {
+        qWarning() << "Unable to write index" << file.fileName();
+        return false;
+    }
+    return true;
+}
+
+bool RecordingIndex::load(const QString &recording)
+{
+    QFile file(sidecarFileName(recording));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QFileInfo info(recording);
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic, version;
+    qint64 size, modified;
+    in >> magic >> version >> size >> modified;
+    if (in.status() != QDataStream::Ok || magic != INDEX_MAGIC || version != INDEX_VERSION
+        || size != info.size() || modified != info.lastModified().toMSecsSinceEpoch())
+    {
+        qInfo() << "Index" << file.fileName() << "is out of date";
+        return false;
+    }
+
+    levels = QVector<PyramidLevel>(1);
+    PyramidLevel &base = levels[0];
+    in >> channelCount >> rowsPerBlock >> rowCount >> blockOffsets >> blockRows;
+    in >> base.start >> base.end >> base.minimum >> base.maximum;
+
+    const qint32 blocks = blockOffsets.size();
+    if (in.status() != QDataStream::Ok || rowsPerBlock == 0 || rowsPerBlock > MAX_ROWS_PER_BLOCK || blockRows.size() != blocks || base.size() != blocks || base.end.size() != blocks
+        || base.minimum.size() != qint64(blocks) * channelCount || base.maximum.size() != qint64(blocks) * channelCount)
+    {
+        qWarning() << "Index" << file.fileName() << "is corrupt";
+
+        // Nothing read from the sidecar is trusted, the source rebuilds the index with its own layout
+        *this = RecordingIndex();
+        return false;
+    }
+
+    buildPyramid();
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// Sidecar file holding the index of a recording, next to it
+#define INDEX_EXTENSION ".armbidx"
+
+/**
+ * @brief Consecutive rows of a recording, stored per channel.
+ */
+struct RowBlock
+{
+    QVector<double> times; ///< Time of every row in seconds (plot key).
+    QVector<QVector<double>> channels; ///< One column of values per channel.
+
+    qint32 rowCount(void) const { return times.size(); }
+    void clear(quint32 channelCount)
+    {
+        times.clear();
+        channels = QVector<QVector<double>>(channelCount);
+    }
+};
+
+/**
+ * @brief Min/max summary of a recording at one resolution.
+ *
+ * Entry i covers a run of consecutive rows from start[i] to end[i]. Minimum
+ * and maximum hold channelCount values per entry (entry-major).
+ */
+struct PyramidLevel
+{
+    QVector<double> start;
+    QVector<double> end;
+    QVector<double> minimum;
+    QVector<double> maximum;
+
+    qint32 size(void) const { return start.size(); }
+};
+
+/**
+ * @brief Block index and decimation pyramid of a recording.
+ *
+ * Rows are grouped in blocks of rowsPerBlock rows. Level 0 of the pyramid has
+ * one entry per block, every further level merges two entries of the level
+ * below, up to a single entry covering the whole recording. The pyramid lets
+ * any time range be drawn from a bounded number of entries without touching
+ * the samples themselves.
+ */
+class RecordingIndex
+{
+public:
+    static const quint32 DEFAULT_ROWS_PER_BLOCK = 4096;
+    static const quint32 MAX_ROWS_PER_BLOCK = 1 << 20;
+
+    quint32 channelCount = 0;
+    quint32 rowsPerBlock = DEFAULT_ROWS_PER_BLOCK;
+    qint64 rowCount = 0;
+    QVector<qint64> blockOffsets; ///< Position of the first row of each block in the source.
+    QVector<qint32> blockRows; ///< Number of rows in each block (the last one may be short).
+    QVector<PyramidLevel> levels;
+
+    qint32 blockCount(void) const { return blockOffsets.size(); }
+    bool isEmpty(void) const { return blockOffsets.isEmpty(); }
+
+    // Starts a new index, level 0 is filled with appendBlock()
+    void reset(quint32 channels, quint32 rowsInBlock);
+    // Adds a block summary to level 0, minimum and maximum hold channelCount values
+    void appendBlock(qint64 offset, qint32 rows, double start, double end, const double *minimum, const double *maximum);
+    // Builds levels 1 and up from level 0
+    void buildPyramid(void);
+
+    // First entry of level whose end is at or after time
+    qint32 entryAt(qint32 level, double time) const;
+    // Lowest level that covers [lower, upper] with at most maxEntries entries
+    qint32 levelFor(double lower, double upper, qint32 maxEntries) const;
+
+    double startTime(void) const;
+    double endTime(void) const;
+
+    // Sidecar file name of recording
+    static QString sidecarFileName(const QString &recording);
+    // Writes level 0 and the block table to the sidecar of recording
+    bool save(const QString &recording) const;
+    // Reads the sidecar of recording, returns false if it is missing or the recording changed since
+    bool load(const QString &recording);
+};
+
+/**
+ * @brief Random access to a recording on disk.
+ *
+ * buildIndex() and readBlock() may run on worker threads, implementations must
+ * not share file handles between calls (a read-only mapping may be shared).
+ */
+class RecordingSource
+{
+public:
+    virtual ~RecordingSource() {}
+
+    virtual QString fileName(void) const = 0;
+    virtual quint32 channelCount(void) const = 0;
+
+    // Scans the source once, filling index. Returns false on error or when cancel is set
+    virtual bool buildIndex(RecordingIndex &index, const std::atomic_bool &cancel) const = 0;
+
+    // Reads the rows of one block of index into rows
+    virtual bool readBlock(const RecordingIndex &index, qint32 block, RowBlock &rows) const = 0;
+};
+
+#endif // RECORDING_H
@@ -0,0 +1,219 @@
+#include "recordingcodec.h"
+#include <QtMath>
+#include <cstring>
+
+static const quint32 MAX_DECIMALS = 9;
+static const quint32 PROBE_VALUES = 16; // Values used to guess the number of decimals
+
+static const double POWERS_OF_TEN[MAX_DECIMALS + 1] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+// True if value is exactly integer / 10^decimals with an integer that fits a double
+static inline bool toFixedPoint(double value, quint32 decimals, qint64 &integer)
+{
+    const double scaled = value * POWERS_OF_TEN[decimals];
+    if (!(qAbs(scaled) < 9007199254740992.0)) // 2^53, also rejects NaN and inf
+        return false;
+    integer = qRound64(scaled);
+    return double(integer) / POWERS_OF_TEN[decimals] == value;
+}
+
+static inline quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+static inline qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+static inline quint32 bitWidth(quint64 value)
+{
+    quint32 width = 0;
+    while (value)
+    {
+        ++width;
+        value >>= 1;
+    }
+    return width;
+}
+
+static inline quint64 load64(const uchar *data)
+{
+    quint64 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static bool findDecimals(const double *values, quint32 count, quint32 &decimals)
+{
+    // Smallest number of decimals that fits the first values, then checked on all of them
+    const quint32 probe = qMin(count, PROBE_VALUES);
+    qint64 integer;
+    for (decimals = 0; decimals <= MAX_DECIMALS; ++decimals)
+    {
+        quint32 i = 0;
+        while (i < probe && toFixedPoint(values[i], decimals, integer))
+            ++i;
+        if (i == probe)
+            break;
+    }
+    if (decimals > MAX_DECIMALS)
+        return false;
+
+    for (quint32 i = probe; i < count; ++i)
+    {
+        if (!toFixedPoint(values[i], decimals, integer))
+            return false;
+    }
+    return true;
+}
+
+static void appendRaw(const double *values, quint32 count, QByteArray &out)
+{
+    ColumnHeader header = {ColumnRaw, 0, 0, quint32(count * sizeof(double))};
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(values), count * sizeof(double));
+}
+
+void encodeColumn(const double *values, quint32 count, QByteArray &out)
+{
+    quint32 decimals;
+    if (count == 0 || !findDecimals(values, count, decimals))
+    {
+        appendRaw(values, count, out);
+        return;
+    }
+
+    const qint64 start = out.size();
+    out.append(sizeof(ColumnHeader), '\0');
+
+    qint64 previous;
+    toFixedPoint(values[0], decimals, previous);
+    out.append(reinterpret_cast<const char*>(&previous), sizeof(previous));
+
+    quint64 deltas[CODEC_BLOCK];
+    for (quint32 first = 1; first < count; first += CODEC_BLOCK)
+    {
+        const quint32 n = qMin<quint32>(CODEC_BLOCK, count - first);
+        quint64 all = 0;
+        for (quint32 i = 0; i < n; ++i)
+        {
+            qint64 integer;
+            toFixedPoint(values[first + i], decimals, integer);
+            deltas[i] = zigzag(integer - previous);
+            all |= deltas[i];
+            previous = integer;
+        }
+
+        // One width per block, deltas packed LSB first
+        const quint32 width = bitWidth(all);
+        const qint64 blockStart = out.size() + 1;
+        out.append(char(width));
+        out.append(int((quint64(n) * width + 7) / 8), '\0');
+        uchar *packed = reinterpret_cast<uchar*>(out.data() + blockStart);
+        quint64 bit = 0;
+        for (quint32 i = 0; i < n; ++i)
+        {
+            quint64 value = deltas[i];
+            for (quint32 left = width; left > 0;)
+            {
+                const quint32 shift = bit & 7;
+                const quint32 take = qMin(8 - shift, left);
+                packed[bit >> 3] |= uchar((value & ((1u << take) - 1)) << shift);
+                value >>= take;
+                bit += take;
+                left -= take;
+            }
+        }
+    }
+
+    // Padded to keep the next column aligned
+    out.append(int((8 - (out.size() - start) % 8) % 8), '\0');
+
+    const qint64 size = out.size() - start - sizeof(ColumnHeader);
+    if (size >= qint64(count * sizeof(double)))
+    {
+        // Not worth it, e.g. noise in the low bits
+        out.truncate(start);
+        appendRaw(values, count, out);
+        return;
+    }
+
+    ColumnHeader header = {ColumnDeltaPacked, quint8(decimals), 0, quint32(size)};
+    memcpy(out.data() + start, &header, sizeof(header));
+}
+
+qint64 decodeColumn(const char *data, qint64 size, quint32 count, double *values)
+{
+    ColumnHeader header;
+    if (size < qint64(sizeof(header)))
+        return 0;
+    memcpy(&header, data, sizeof(header));
+    if (qint64(sizeof(header)) + header.size > size)
+        return 0;
+
+    const uchar *in = reinterpret_cast<const uchar*>(data + sizeof(header));
+    const uchar *end = in + header.size;
+
+    if (header.method == ColumnRaw)
+    {
+        if (header.size != count * sizeof(double))
+            return 0;
+        memcpy(values, in, header.size);
+        return sizeof(header) + header.size;
+    }
+
+    if (header.method != ColumnDeltaPacked || header.decimals > MAX_DECIMALS || count == 0 || end - in < 8)
+        return 0;
+
+    const double scale = POWERS_OF_TEN[header.decimals];
+    qint64 integer = qint64(load64(in));
+    in += sizeof(qint64);
+    values[0] = double(integer) / scale;
+
+    for (quint32 first = 1; first < count; first += CODEC_BLOCK)
+    {
+        const quint32 n = qMin<quint32>(CODEC_BLOCK, count - first);
+        if (in >= end)
+            return 0;
+        const quint32 width = *in++;
+        const quint64 bytes = (quint64(n) * width + 7) / 8;
+        if (width > 64 || quint64(end - in) < bytes)
+            return 0;
+
+        const quint64 mask = width == 64 ? ~quint64(0) : (quint64(1) << width) - 1;
+        double *out = values + first;
+        if (width <= 56 && quint64(end - in) >= bytes + 7)
+        {
+            // Every delta is inside one unaligned 8-byte load
+            for (quint32 i = 0; i < n; ++i)
+            {
+                const quint64 bit = quint64(i) * width;
+                integer += unzigzag((load64(in + (bit >> 3)) >> (bit & 7)) & mask);
+                out[i] = double(integer) / scale;
+            }
+        }
+        else
+        {
+            for (quint32 i = 0; i < n; ++i)
+            {
+                quint64 value = 0;
+                quint64 bit = quint64(i) * width;
+                for (quint32 done = 0; done < width;)
+                {
+                    const quint32 shift = bit & 7;
+                    const quint32 take = qMin(8 - shift, width - done);
+                    value |= quint64((in[bit >> 3] >> shift) & ((1u << take) - 1)) << done;
+                    bit += take;
+                    done += take;
+                }
+                integer += unzigzag(value);
+                out[i] = double(integer) / scale;
+            }
+        }
+        in += bytes;
+    }
+
+    return sizeof(header) + header.size;
+}
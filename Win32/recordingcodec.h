@@ -0,0 +1,53 @@
+#ifndef RECORDINGCODEC_H
+#define RECORDINGCODEC_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+/*
+ * Lossless column codec of compressed .armb chunks.
+ *
+ * Every column starts with a ColumnHeader. Samples from the device and time
+ * stamps are decimal numbers with few digits, so a column whose values all
+ * round-trip exactly through value * 10^decimals as integers is stored as:
+ *
+ *   qint64 first value, then the zigzag deltas in blocks of CODEC_BLOCK values,
+ *   each block a quint8 bit width followed by the deltas packed LSB first
+ *
+ * Every delta of a block has the same width, so a block decodes in a tight
+ * loop without branches on the data. Columns that do not round-trip (NaN,
+ * arbitrary doubles) are stored as raw doubles.
+ */
+
+#define CODEC_BLOCK 128
+
+enum ColumnMethod
+{
+    ColumnRaw = 0,
+    ColumnDeltaPacked = 1
+};
+
+#pragma pack(push, 1)
+struct ColumnHeader
+{
+    quint8 method;
+    quint8 decimals;
+    quint16 reserved;
+    quint32 size; // Bytes following this header, a multiple of 8
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ColumnHeader) == 8, "ColumnHeader must be 8 bytes");
+
+// Appends the encoded column (header included) to out
+void encodeColumn(const double *values, quint32 count, QByteArray &out);
+
+/**
+ * @brief Decodes one column written by encodeColumn().
+ *
+ * @param size Bytes available from data.
+ * @return Bytes used (header included), or 0 if the column is invalid.
+ */
+qint64 decodeColumn(const char *data, qint64 size, quint32 count, double *values);
+
+#endif // RECORDINGCODEC_H
@@ -0,0 +1,47 @@
+#include "recordingformat.h"
+#include <cstring>
+
+// Table of the reflected polynomial 0xEDB88320, one entry per byte value
+static const struct Crc32Table
+{
+    quint32 entries[256];
+
+    Crc32Table()
+    {
+        for (quint32 i = 0; i < 256; ++i)
+        {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+            }
+            entries[i] = crc;
+        }
+    }
+} CRC32_TABLE;
+
+quint32 recordingCrc32(const void *data, quint64 size, quint32 crc)
+{
+    const quint8 *byte = static_cast<const quint8*>(data);
+    crc = ~crc;
+    for (const quint8 *end = byte + size; byte != end; ++byte)
+    {
+        crc = CRC32_TABLE.entries[(crc ^ *byte) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+RecordingHeader makeRecordingHeader(quint32 channelCount, const QString &deviceId, double sampleRate)
+{
+    RecordingHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.channelCount = channelCount;
+    header.sampleRate = sampleRate;
+    header.scale = 1.0; // Values are stored as doubles in physical units
+
+    QByteArray id = deviceId.toLatin1().left(sizeof(header.deviceId));
+    memcpy(header.deviceId, id.constData(), id.size());
+    return header;
+}
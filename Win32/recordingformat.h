@@ -0,0 +1,118 @@
+#ifndef RECORDINGFORMAT_H
+#define RECORDINGFORMAT_H
+
+#include <QtGlobal>
+#include <QString>
+
+/*
+ * Native recording file (.armb), little-endian, every section 8-byte aligned:
+ *
+ *   RecordingHeader
+ *   chunk 0: ChunkHeader (16 bytes before version 3)
+ *            ChunkSummary, minimum[channelCount], maximum[channelCount] (double)
+ *            times[rowCount], then per channel values[rowCount] (double)
+ *   chunk 1: ...
+ *   IndexEntry[chunkCount] (only once the recording is closed)
+ *   RecordingFooter
+ *
+ * Compressed chunks (ChunkHeader::encoding == CHUNK_COMPRESSED) keep the
+ * summary as is and store the times and every channel as encoded columns
+ * (see recordingcodec.h) instead of raw doubles.
+ *
+ * The file is append-only while recording. Every chunk is written over the
+ * previous footer and followed by a new one, so a cleanly written file always
+ * ends with a footer. The chunk index is written once on close, which lets a
+ * reader open the file from the footer alone. If the footer is missing (crash,
+ * power loss) or has no index, every complete chunk is still recovered by
+ * walking the chunk headers from the start. Since version 3 every chunk
+ * carries the CRC-32 of its payload, so a chunk torn by a crash is not read
+ * back as samples.
+ */
+
+#define RECORDING_EXTENSION ".armb"
+#define RECORDING_MAGIC "ARMBREC1"
+#define RECORDING_VERSION 3
+#define RECORDING_VERSION_MIN 2 // Oldest version still read
+#define CHUNK_MAGIC 0x4B4E4843 // "CHNK"
+#define FOOTER_MAGIC 0x544F4F46 // "FOOT"
+#define CHUNK_RAW 0
+#define CHUNK_COMPRESSED 1
+
+#pragma pack(push, 1)
+struct RecordingHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 channelCount;
+    char deviceId[4];
+    quint32 reserved0;
+    double sampleRate; // Hz, 0 if unknown
+    double scale; // Physical units per stored unit
+    quint8 reserved[24];
+};
+
+struct ChunkHeader
+{
+    quint32 magic;
+    quint32 rowCount;
+    quint32 payloadSize; // Bytes following this header
+    quint32 encoding; // CHUNK_RAW or CHUNK_COMPRESSED
+    quint32 checksum; // CRC-32 of the payload, since version 3
+    quint32 reserved;
+};
+
+// Followed by the minimum and maximum of every channel in the chunk (NaN if the channel has no value)
+struct ChunkSummary
+{
+    double start; // Time of the first row
+    double end; // Time of the last row
+};
+
+struct IndexEntry
+{
+    quint64 offset; // Position of the ChunkHeader
+    quint32 rowCount;
+    quint32 reserved;
+};
+
+struct RecordingFooter
+{
+    quint32 magic;
+    quint32 chunkCount;
+    quint64 rowCount;
+    quint64 dataEnd; // End of the last chunk
+    quint64 indexOffset; // Position of the chunk index, 0 while recording
+};
+#pragma pack(pop)
+
+static_assert(sizeof(RecordingHeader) == 64, "RecordingHeader must be 64 bytes");
+static_assert(sizeof(ChunkHeader) == 24, "ChunkHeader must be 24 bytes");
+static_assert(sizeof(ChunkSummary) == 16, "ChunkSummary must be 16 bytes");
+static_assert(sizeof(IndexEntry) == 16, "IndexEntry must be 16 bytes");
+static_assert(sizeof(RecordingFooter) == 32, "RecordingFooter must be 32 bytes");
+
+// Bytes of a ChunkHeader in a file of the given version
+inline quint64 chunkHeaderSize(quint32 version)
+{
+    return version >= 3 ? sizeof(ChunkHeader) : 16;
+}
+
+// Bytes of the summary of a chunk, min/max included
+inline quint64 chunkSummarySize(quint32 channelCount)
+{
+    return sizeof(ChunkSummary) + 2 * quint64(channelCount) * sizeof(double);
+}
+
+// Bytes following the ChunkHeader of a raw chunk
+inline quint64 chunkPayloadSize(quint32 channelCount, quint32 rowCount)
+{
+    return chunkSummarySize(channelCount) + quint64(channelCount + 1) * rowCount * sizeof(double);
+}
+
+// CRC-32 (IEEE 802.3) of size bytes, continuing from crc
+quint32 recordingCrc32(const void *data, quint64 size, quint32 crc = 0);
+
+// Fills a header for a new recording
+RecordingHeader makeRecordingHeader(quint32 channelCount, const QString &deviceId, double sampleRate = 0);
+
+#endif // RECORDINGFORMAT_H
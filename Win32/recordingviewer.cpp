@@ -0,0 +1,249 @@
+#include "recordingviewer.h"
+#include <QtConcurrent>
+#include <cmath>
+#include <limits>
+
+// Raw rows are drawn when there are at most this many per pixel of plot width
+static const qint32 RAW_ROWS_PER_PIXEL = 4;
+// Memory kept for raw blocks
+static const qint64 BLOCK_CACHE_BYTES = 256 * 1024 * 1024;
+
+RecordingViewer::RecordingViewer(QCustomPlot *plot, RecordingSource *source, QObject *parent)
+    : QObject(parent), m_plot(plot), m_source(source), m_cancel(false)
+{
+    qint64 bytesPerRow = (m_source->channelCount() + 1) * sizeof(double);
+    m_blocks.setMaxCost(qMax<qint64>(1, BLOCK_CACHE_BYTES / bytesPerRow));
+
+    m_viewTimer.setSingleShot(true);
+    m_viewTimer.setInterval(15);
+    connect(&m_viewTimer, &QTimer::timeout, this, &RecordingViewer::updateView);
+
+    connect(&m_indexWatcher, &QFutureWatcher<QSharedPointer<const RecordingIndex>>::finished, this, &RecordingViewer::onIndexBuilt);
+    connect(m_plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(onRangeChanged()));
+}
+
+RecordingViewer::~RecordingViewer()
+{
+    // Workers use the source and the index, let them finish first
+    m_cancel = true;
+    m_indexWatcher.waitForFinished();
+    m_reads.waitForFinished();
+}
+
+void RecordingViewer::open(void)
+{
+    qInfo() << "Indexing" << m_source->fileName();
+
+    QSharedPointer<RecordingSource> source = m_source;
+    const std::atomic_bool *cancel = &m_cancel;
+    m_indexWatcher.setFuture(QtConcurrent::run([source, cancel]() {
+        QSharedPointer<RecordingIndex> index(new RecordingIndex);
+        if (!source->buildIndex(*index, *cancel))
+        {
+            return QSharedPointer<const RecordingIndex>();
+        }
+        return QSharedPointer<const RecordingIndex>(index);
+    }));
+}
+
+void RecordingViewer::onIndexBuilt(void)
+{
+    m_index = m_indexWatcher.result();
+    if (m_index.isNull() || m_index->isEmpty())
+    {
+        qWarning() << "No data found in" << m_source->fileName();
+        m_index.reset();
+        return;
+    }
+
+    qInfo() << "Indexed" << m_index->rowCount << "rows in" << m_index->blockCount() << "blocks";
+
+    // Whole recording in view, value range from the top of the pyramid
+    const PyramidLevel &top = m_index->levels.last();
+    double minY = *std::min_element(top.minimum.constBegin(), top.minimum.constEnd());
+    double maxY = *std::max_element(top.maximum.constBegin(), top.maximum.constEnd());
+    m_plot->yAxis->setRange(minY, maxY);
+    m_plot->xAxis->setRange(m_index->startTime(), m_index->endTime());
+
+    emit indexed(m_index->rowCount);
+    updateView();
+}
+
+void RecordingViewer::onRangeChanged(void)
+{
+    if (m_index)
+        m_viewTimer.start();
+}
+
+void RecordingViewer::updateView(void)
+{
+    if (!m_index)
+        return;
+
+    const RecordingIndex &index = *m_index;
+    const QCPRange range = m_plot->xAxis->range();
+    const qint32 width = qMax(1, m_plot->xAxis->axisRect()->width());
+    const quint32 channels = index.channelCount;
+
+    QVector<double> keys;
+    QVector<QVector<double>> values(channels);
+
+    // Visible blocks plus one on each side, so lines run up to the edges
+    qint32 first = qMax(0, qMin(index.entryAt(0, range.lower), index.blockCount() - 1) - 1);
+    qint32 last = qMin(index.entryAt(0, range.upper) + 1, index.blockCount() - 1);
+    qint64 rows = qint64(last - first + 1) * index.rowsPerBlock;
+
+    const bool raw = rows <= qint64(RAW_ROWS_PER_PIXEL) * width;
+    if (raw || (rows < qint64(index.rowsPerBlock) * width && rows <= m_blocks.maxCost() / 2))
+    {
+        // Raw rows where they are cached, block summary meanwhile. Below one pyramid
+        // entry per pixel, the cached rows are reduced to a min/max pair per pixel instead
+        const double pixelWidth = range.size() / width;
+        for (qint32 b = first; b <= last; ++b)
+        {
+            if (const RowBlock *block = m_blocks.object(b))
+            {
+                if (raw)
+                {
+                    keys.append(block->times);
+                    for (quint32 c = 0; c < channels; ++c)
+                    {
+                        values[c].append(block->channels[c]);
+                    }
+                }
+                else
+                {
+                    appendDecimated(*block, range.lower, pixelWidth, keys, values);
+                }
+            }
+            else
+            {
+                requestBlock(b);
+                appendEnvelope(index.levels[0], b, keys, values);
+            }
+        }
+
+        // Prefetch one view width on both sides, or one block when the view alone fills half the cache
+        qint32 span = raw ? last - first + 1 : 1;
+        for (qint32 b = 1; b <= span; ++b)
+        {
+            requestBlock(last + b);
+            requestBlock(first - b);
+        }
+    }
+    else
+    {
+        // More rows than pixels: min/max envelope from the pyramid
+        qint32 level = index.levelFor(range.lower, range.upper, width);
+        const PyramidLevel &entries = index.levels[level];
+        qint32 e0 = qMax(0, qMin(index.entryAt(level, range.lower), entries.size() - 1) - 1);
+        qint32 e1 = qMin(index.entryAt(level, range.upper) + 1, entries.size() - 1);
+        for (qint32 e = e0; e <= e1; ++e)
+        {
+            appendEnvelope(entries, e, keys, values);
+        }
+    }
+
+    for (quint32 c = 0; c < channels && c < quint32(m_plot->graphCount()); ++c)
+    {
+        m_plot->graph(c)->setData(keys, values[c], true);
+    }
+    m_plot->replot(QCustomPlot::rpQueuedReplot);
+}
+
+void RecordingViewer::appendEnvelope(const PyramidLevel &level, qint32 entry, QVector<double> &keys, QVector<QVector<double>> &values) const
+{
+    const quint32 channels = values.size();
+    double middle = (level.start[entry] + level.end[entry]) / 2;
+    keys.append(middle);
+    keys.append(middle);
+    for (quint32 c = 0; c < channels; ++c)
+    {
+        double minimum = level.minimum[entry * channels + c];
+        double maximum = level.maximum[entry * channels + c];
+        if (minimum > maximum)
+        {
+            // No valid value in this entry
+            minimum = maximum = qQNaN();
+        }
+        values[c].append(minimum);
+        values[c].append(maximum);
+    }
+}
+
+void RecordingViewer::appendDecimated(const RowBlock &block, double origin, double pixelWidth, QVector<double> &keys,
+                                      QVector<QVector<double>> &values) const
+{
+    const quint32 channels = values.size();
+    QVector<double> minimum(channels);
+    QVector<double> maximum(channels);
+    qint64 pixel = 0;
+    qint32 start = 0;
+    for (qint32 row = 0; row <= block.rowCount(); ++row)
+    {
+        // A pixel ends where the next one starts or with the block
+        const qint64 rowPixel = row < block.rowCount() ? qint64(std::floor((block.times[row] - origin) / pixelWidth)) : pixel + 1;
+        if (row > start && rowPixel != pixel)
+        {
+            double middle = origin + (pixel + 0.5) * pixelWidth;
+            keys.append(middle);
+            keys.append(middle);
+            for (quint32 c = 0; c < channels; ++c)
+            {
+                values[c].append(minimum[c] <= maximum[c] ? minimum[c] : qQNaN());
+                values[c].append(minimum[c] <= maximum[c] ? maximum[c] : qQNaN());
+            }
+            start = row;
+        }
+        if (row == block.rowCount())
+            break;
+        if (row == start)
+        {
+            pixel = rowPixel;
+            minimum.fill(std::numeric_limits<double>::max());
+            maximum.fill(std::numeric_limits<double>::lowest());
+        }
+
+        for (quint32 c = 0; c < channels && c < quint32(block.channels.size()); ++c)
+        {
+            const double value = block.channels[c][row];
+            if (qIsNaN(value))
+                continue;
+            minimum[c] = qMin(minimum[c], value);
+            maximum[c] = qMax(maximum[c], value);
+        }
+    }
+}
+
+void RecordingViewer::requestBlock(qint32 block)
+{
+    if (block < 0 || block >= m_index->blockCount() || m_pending.contains(block) || m_blocks.contains(block))
+        return;
+    m_pending.insert(block);
+
+    QSharedPointer<RecordingSource> source = m_source;
+    QSharedPointer<const RecordingIndex> index = m_index;
+    m_reads.addFuture(QtConcurrent::run([this, source, index, block]() {
+        QSharedPointer<RowBlock> rows(new RowBlock);
+        if (!source->readBlock(*index, block, *rows))
+        {
+            rows.reset();
+        }
+        // Delivered on the GUI thread, dropped if the viewer is gone by then
+        QMetaObject::invokeMethod(this, [this, block, rows]() { onBlockLoaded(block, rows); }, Qt::QueuedConnection);
+    }));
+}
+
+void RecordingViewer::onBlockLoaded(qint32 block, QSharedPointer<RowBlock> rows)
+{
+    m_pending.remove(block);
+    if (m_pending.isEmpty())
+    {
+        m_reads.clearFutures();
+    }
+    if (rows.isNull())
+        return;
+
+    m_blocks.insert(block, new RowBlock(*rows), qMax(1, rows->rowCount()));
+    m_viewTimer.start();
+}
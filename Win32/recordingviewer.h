@@ -0,0 +1,66 @@
+#ifndef RECORDINGVIEWER_H
+#define RECORDINGVIEWER_H
+
+#include <QObject>
+#include <QCache>
+#include <QFutureSynchronizer>
+#include <QFutureWatcher>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTimer>
+#include "qcustomplot.h"
+#include "recording.h"
+
+/**
+ * @brief Displays a recording without loading it into memory.
+ *
+ * The source is indexed on a worker thread. Afterwards, every change of the
+ * x-axis range draws the visible span either from the decimation pyramid
+ * (min/max envelope, when it has an entry per pixel at least) or from raw
+ * row blocks read in the background and kept in a bounded cache. Between a
+ * few rows per pixel and one pyramid entry per pixel the cached blocks are
+ * drawn as a min/max pair per pixel. Blocks of the
+ * ranges left and right of the view are prefetched so panning stays smooth.
+ * Graph i of the plot shows channel i of the source.
+ */
+class RecordingViewer : public QObject
+{
+    Q_OBJECT
+
+public:
+    RecordingViewer(QCustomPlot *plot, RecordingSource *source, QObject *parent = nullptr);
+    ~RecordingViewer();
+
+    // Starts indexing, the view is drawn once the index is ready
+    void open(void);
+
+    const RecordingSource *source(void) const { return m_source.data(); }
+    bool isIndexed(void) const { return !m_index.isNull(); }
+
+signals:
+    void indexed(qint64 rowCount);
+
+private slots:
+    void onIndexBuilt(void);
+    void onRangeChanged(void);
+    void updateView(void);
+
+private:
+    void requestBlock(qint32 block);
+    void onBlockLoaded(qint32 block, QSharedPointer<RowBlock> rows);
+    void appendEnvelope(const PyramidLevel &level, qint32 entry, QVector<double> &keys, QVector<QVector<double>> &values) const;
+    void appendDecimated(const RowBlock &block, double origin, double pixelWidth, QVector<double> &keys, QVector<QVector<double>> &values) const;
+
+    QCustomPlot *m_plot;
+    QSharedPointer<RecordingSource> m_source;
+    QSharedPointer<const RecordingIndex> m_index;
+    QFutureWatcher<QSharedPointer<const RecordingIndex>> m_indexWatcher;
+    std::atomic_bool m_cancel;
+
+    QCache<qint32, RowBlock> m_blocks; // Raw blocks, cost in rows
+    QSet<qint32> m_pending; // Blocks being read
+    QFutureSynchronizer<void> m_reads;
+    QTimer m_viewTimer; // Coalesces range changes while dragging
+};
+
+#endif // RECORDINGVIEWER_H
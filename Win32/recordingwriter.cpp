@@ -0,0 +1,270 @@
+#include "recordingwriter.h"
+#include "recordingcodec.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static const qint32 CHUNK_ROWS = 8192; // Rows per chunk, also wakes the writer early
+static const qint32 FLUSH_INTERVAL_MS = 500; // Longest time rows stay queued
+static const qint32 SYNC_INTERVAL_MS = 2000; // Longest time written data stays in the OS cache
+
+RecordingWriter::RecordingWriter(QObject *parent) : QThread(parent), m_rowsWritten(0)
+{
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    close();
+    unlock();
+}
+
+bool RecordingWriter::open(const QString &fileName, quint32 channelCount, const QString &deviceId, double sampleRate)
+{
+    // A lock left by a crashed process is stale and taken over
+    m_lock = new QLockFile(lockFileName(fileName));
+    if (!m_lock->tryLock(0))
+    {
+        qWarning() << "Recording" << fileName << "is being written by another process";
+        delete m_lock;
+        m_lock = nullptr;
+        return false;
+    }
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Unable to open file for writing:" << m_file.errorString();
+        unlock();
+        return false;
+    }
+
+    m_channelCount = channelCount;
+    m_index.clear();
+    m_rowsWritten = 0;
+    m_queue.clear();
+    m_queuedRows = 0;
+    m_stopping = false;
+
+    m_header = makeRecordingHeader(channelCount, deviceId, sampleRate);
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_dataEnd = sizeof(m_header);
+    writeFooter(0);
+
+    start();
+    return true;
+}
+
+void RecordingWriter::close(void)
+{
+    if (!isRunning())
+        return;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wake.wakeOne();
+    }
+    wait();
+    unlock();
+}
+
+void RecordingWriter::unlock(void)
+{
+    // Unlocking removes the lock file
+    delete m_lock;
+    m_lock = nullptr;
+}
+
+void RecordingWriter::append(const RowBlock &rows)
+{
+    if (rows.rowCount() == 0)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(rows);
+    m_queuedRows += rows.rowCount();
+    if (m_queuedRows >= CHUNK_ROWS)
+        m_wake.wakeOne();
+}
+
+void RecordingWriter::run()
+{
+    QElapsedTimer sinceSync;
+    sinceSync.start();
+
+    forever
+    {
+        QList<RowBlock> batch;
+        bool stopping;
+        {
+            QMutexLocker locker(&m_mutex);
+            // Wait for a full chunk, the flush interval or the stop request
+            if (!m_stopping && m_queuedRows < CHUNK_ROWS)
+                m_wake.wait(&m_mutex, FLUSH_INTERVAL_MS);
+            batch.swap(m_queue);
+            m_queuedRows = 0;
+            stopping = m_stopping;
+        }
+
+        if (!batch.isEmpty())
+            writeChunks(batch);
+        if (stopping)
+            writeIndex();
+
+        if (stopping || sinceSync.elapsed() >= SYNC_INTERVAL_MS)
+        {
+            syncToDisk();
+            sinceSync.restart();
+        }
+
+        if (stopping)
+            break;
+    }
+
+    m_file.close();
+    qDebug() << "Recording closed:" << m_file.fileName() << m_rowsWritten << "rows";
+}
+
+void RecordingWriter::writeChunks(const QList<RowBlock> &batch)
+{
+    // Columns of all queued rows
+    RowBlock rows;
+    rows.clear(m_channelCount);
+    for (const RowBlock &block : batch)
+    {
+        rows.times.append(block.times);
+        for (quint32 c = 0; c < m_channelCount; ++c)
+        {
+            if (c < quint32(block.channels.size()) && block.channels[c].size() == block.rowCount())
+                rows.channels[c].append(block.channels[c]);
+            else
+                rows.channels[c].append(QVector<double>(block.rowCount(), qQNaN()));
+        }
+    }
+
+    if (m_index.isEmpty())
+        m_firstTime = rows.times.first();
+    m_lastTime = rows.times.last();
+
+    QByteArray buffer;
+    m_file.seek(m_dataEnd);
+    for (qint32 first = 0; first < rows.rowCount(); first += CHUNK_ROWS)
+    {
+        const quint32 count = qMin(CHUNK_ROWS, rows.rowCount() - first);
+
+        ChunkHeader chunk;
+        chunk.magic = CHUNK_MAGIC;
+        chunk.rowCount = count;
+        chunk.payloadSize = m_compressed ? chunkSummarySize(m_channelCount) : chunkPayloadSize(m_channelCount, count);
+        chunk.encoding = m_compressed ? CHUNK_COMPRESSED : CHUNK_RAW;
+        chunk.reserved = 0;
+
+        // Header, summary and columns in one buffer, so each chunk is a single write
+        buffer.resize(sizeof(chunk) + chunk.payloadSize);
+        char *out = buffer.data();
+        out += sizeof(chunk);
+
+        ChunkSummary summary;
+        summary.start = rows.times[first];
+        summary.end = rows.times[first + count - 1];
+        memcpy(out, &summary, sizeof(summary));
+        out += sizeof(summary);
+
+        double *minimum = reinterpret_cast<double*>(out);
+        double *maximum = minimum + m_channelCount;
+        for (quint32 c = 0; c < m_channelCount; ++c)
+        {
+            // NaN stays the result only if the channel has no value in the chunk
+            minimum[c] = maximum[c] = qQNaN();
+            for (const double *value = rows.channels[c].constData() + first, *end = value + count; value != end; ++value)
+            {
+                if (qIsNaN(*value))
+                    continue;
+                if (qIsNaN(minimum[c]) || *value < minimum[c])
+                    minimum[c] = *value;
+                if (qIsNaN(maximum[c]) || *value > maximum[c])
+                    maximum[c] = *value;
+            }
+        }
+        out += 2 * m_channelCount * sizeof(double);
+
+        if (m_compressed)
+        {
+            encodeColumn(rows.times.constData() + first, count, buffer);
+            for (quint32 c = 0; c < m_channelCount; ++c)
+            {
+                encodeColumn(rows.channels[c].constData() + first, count, buffer);
+            }
+            chunk.payloadSize = buffer.size() - sizeof(chunk);
+        }
+        else
+        {
+            memcpy(out, rows.times.constData() + first, count * sizeof(double));
+            out += count * sizeof(double);
+            for (quint32 c = 0; c < m_channelCount; ++c)
+            {
+                memcpy(out, rows.channels[c].constData() + first, count * sizeof(double));
+                out += count * sizeof(double);
+            }
+        }
+        // The checksum lets recovery tell a complete chunk from one torn by a crash
+        chunk.checksum = recordingCrc32(buffer.constData() + sizeof(chunk), chunk.payloadSize);
+        memcpy(buffer.data(), &chunk, sizeof(chunk));
+
+        if (m_file.write(buffer) != buffer.size())
+        {
+            qWarning() << "Recording write failed:" << m_file.errorString();
+            return;
+        }
+        m_index.append({m_dataEnd, count, 0});
+        m_dataEnd += buffer.size();
+        m_rowsWritten += count;
+    }
+
+    writeFooter(0);
+}
+
+void RecordingWriter::writeFooter(quint64 indexOffset)
+{
+    RecordingFooter footer;
+    footer.magic = FOOTER_MAGIC;
+    footer.chunkCount = m_index.size();
+    footer.rowCount = m_rowsWritten;
+    footer.dataEnd = m_dataEnd;
+    footer.indexOffset = indexOffset;
+
+    m_file.seek(indexOffset ? indexOffset + m_index.size() * sizeof(IndexEntry) : m_dataEnd);
+    m_file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+}
+
+void RecordingWriter::writeIndex(void)
+{
+    // Measured sample rate if none was given
+    if (m_header.sampleRate <= 0 && m_rowsWritten > 1 && m_lastTime > m_firstTime)
+    {
+        m_header.sampleRate = (m_rowsWritten - 1) / (m_lastTime - m_firstTime);
+        m_file.seek(0);
+        m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    }
+
+    m_file.seek(m_dataEnd);
+    m_file.write(reinterpret_cast<const char*>(m_index.constData()), m_index.size() * sizeof(IndexEntry));
+    writeFooter(m_dataEnd);
+}
+
+void RecordingWriter::syncToDisk(void)
+{
+    m_file.flush();
+#ifdef Q_OS_WIN
+    FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(m_file.handle())));
+#else
+    ::fsync(m_file.handle());
+#endif
+}
@@ -0,0 +1,83 @@
+#ifndef RECORDINGWRITER_H
+#define RECORDINGWRITER_H
+
+#include <QFile>
+#include <QList>
+#include <QLockFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include "recording.h"
+#include "recordingformat.h"
+
+/**
+ * @brief Background thread that streams acquired rows into a recording file.
+ *
+ * append() only queues the rows, the writer thread drains the queue in chunks
+ * of up to CHUNK_ROWS rows with one sequential write each, rewrites the footer
+ * behind every chunk and syncs the file to disk every few seconds. A crash
+ * therefore loses at most the last sync interval of data, and the chunk
+ * checksums let BinaryRecordingSource drop a chunk that was only partly
+ * written. The chunk index is
+ * written on close(). The file is locked (lockFileName()) from open() to
+ * close(), so another instance never takes it for a crashed recording.
+ */
+class RecordingWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit RecordingWriter(QObject *parent = nullptr);
+    ~RecordingWriter();
+
+    // Chunks written after this are compressed (see recordingcodec.h)
+    void setCompressed(bool compressed) { m_compressed = compressed; }
+    bool isCompressed(void) const { return m_compressed; }
+
+    // Creates fileName, writes the header and starts the writer thread. A sample rate of 0 is measured from the rows
+    bool open(const QString &fileName, quint32 channelCount, const QString &deviceId, double sampleRate = 0);
+    // Writes what is still queued, the chunk index and the final footer, and joins the thread
+    void close(void);
+
+    // Queues rows for writing. Called from the acquisition (GUI) thread
+    void append(const RowBlock &rows);
+
+    // Lock file held while fileName is written, by this or by another process
+    static QString lockFileName(const QString &fileName) { return fileName + ".lock"; }
+
+    QString fileName(void) const { return m_file.fileName(); }
+    quint32 channelCount(void) const { return m_channelCount; }
+    qint64 rowsWritten(void) const { return m_rowsWritten; }
+    bool isOpen(void) const { return isRunning(); }
+
+protected:
+    void run() override;
+
+private:
+    void writeChunks(const QList<RowBlock> &batch);
+    void writeFooter(quint64 indexOffset);
+    void writeIndex(void);
+    void syncToDisk(void);
+    void unlock(void);
+
+    QFile m_file;
+    QLockFile *m_lock = nullptr;
+    RecordingHeader m_header;
+    bool m_compressed = false;
+    quint32 m_channelCount = 0;
+    quint64 m_dataEnd = 0; // End of the last chunk, where the footer goes
+    QVector<IndexEntry> m_index; // One entry per chunk written
+    double m_firstTime = 0;
+    double m_lastTime = 0;
+    std::atomic<qint64> m_rowsWritten;
+
+    // Shared with the GUI thread
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QList<RowBlock> m_queue;
+    qint64 m_queuedRows = 0;
+    bool m_stopping = false;
+};
+
+#endif // RECORDINGWRITER_H
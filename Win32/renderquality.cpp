@@ -0,0 +1,105 @@
+#include "renderquality.h"
+
+// Number of consecutive slow frames before quality is dropped, so single hiccups are ignored
+static const quint8 OVER_BUDGET_FRAMES = 3;
+// Time at reduced quality after slow frames before full quality is tried again
+static const int REPROBE_INTERVAL_MS = 2000;
+
+RenderQualityController::RenderQualityController(QCustomPlot *plot) : QObject(plot), m_plot(plot)
+{
+    m_fullNotAntialiased = m_plot->notAntialiasedElements();
+    m_fullHints = m_plot->plottingHints();
+
+    m_idleTimer.setSingleShot(true);
+    connect(&m_idleTimer, &QTimer::timeout, this, &RenderQualityController::restoreQuality);
+
+    connect(m_plot, &QCustomPlot::mousePress, this, &RenderQualityController::onMousePress);
+    connect(m_plot, &QCustomPlot::mouseRelease, this, &RenderQualityController::onMouseRelease);
+    connect(m_plot, &QCustomPlot::mouseWheel, this, &RenderQualityController::onMouseWheel);
+    connect(m_plot, &QCustomPlot::afterReplot, this, &RenderQualityController::onAfterReplot);
+}
+
+void RenderQualityController::onMousePress(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    // A press may start a range drag, stay fast until it is released
+    m_interacting = true;
+    m_idleTimer.stop();
+    reduceQuality();
+}
+
+void RenderQualityController::onMouseRelease(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    m_interacting = false;
+    if (m_reduced)
+        m_idleTimer.start(m_idleDelayMs);
+}
+
+void RenderQualityController::onMouseWheel(QWheelEvent *event)
+{
+    Q_UNUSED(event);
+    // Wheel zooming has no release, the idle timer ends it
+    reduceQuality();
+    m_idleTimer.start(m_idleDelayMs);
+}
+
+void RenderQualityController::onAfterReplot(void)
+{
+    if (m_finalReplot)
+    {
+        // Never judge the budget on the restoring frame, it would drop quality straight away again
+        m_finalReplot = false;
+        return;
+    }
+
+    // Replots of the acquisition keep coming while reduced, only interaction pushes the restore away
+    if (m_reduced)
+        return;
+
+    // Full quality frame, check it against the budget
+    if (m_plot->replotTime(false) > m_frameBudgetMs)
+    {
+        if (++m_overBudgetFrames >= OVER_BUDGET_FRAMES)
+        {
+            qDebug() << "Frame time" << m_plot->replotTime(true) << "ms over budget, reducing render quality";
+            reduceQuality();
+
+            // Restored later to measure full-quality frames again, and dropped again if still too slow
+            m_idleTimer.start(REPROBE_INTERVAL_MS);
+        }
+    }
+    else
+    {
+        m_overBudgetFrames = 0;
+    }
+}
+
+void RenderQualityController::reduceQuality(void)
+{
+    if (m_reduced)
+        return;
+
+    // Remember the current settings, they may have been changed since construction
+    m_fullNotAntialiased = m_plot->notAntialiasedElements();
+    m_fullHints = m_plot->plottingHints();
+
+    m_plot->setNotAntialiasedElements(QCP::aeAll);
+    m_plot->setPlottingHint(QCP::phFastPolylines, true);
+    m_reduced = true;
+    m_overBudgetFrames = 0;
+}
+
+void RenderQualityController::restoreQuality(void)
+{
+    if (!m_reduced || m_interacting)
+        return;
+
+    m_plot->setNotAntialiasedElements(m_fullNotAntialiased);
+    m_plot->setPlottingHints(m_fullHints);
+    m_reduced = false;
+
+    // Single high-quality frame of the final view
+    m_finalReplot = true;
+    m_plot->replot();
+}
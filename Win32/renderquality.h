@@ -0,0 +1,54 @@
+#ifndef RENDERQUALITY_H
+#define RENDERQUALITY_H
+
+#include <QObject>
+#include <QTimer>
+#include "qcustomplot.h"
+
+/**
+ * @brief Trades antialiasing for frame rate while the plot is busy.
+ *
+ * Quality is dropped (no antialiasing, phFastPolylines) as soon as the user
+ * starts dragging or zooming, or when several consecutive full-quality frames
+ * exceed the frame budget. The original settings are restored with a single
+ * final high-quality replot once the idle delay has passed since the last
+ * interaction; replots of the acquisition do not count as activity. After a
+ * reduction for slow frames, full quality is probed again every few seconds.
+ */
+class RenderQualityController : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenderQualityController(QCustomPlot *plot);
+
+    void setFrameBudget(double ms) { m_frameBudgetMs = ms; }
+    double frameBudget(void) const { return m_frameBudgetMs; }
+    void setIdleDelay(int ms) { m_idleDelayMs = ms; }
+    bool isReduced(void) const { return m_reduced; }
+
+private slots:
+    void onMousePress(QMouseEvent *event);
+    void onMouseRelease(QMouseEvent *event);
+    void onMouseWheel(QWheelEvent *event);
+    void onAfterReplot(void);
+    void restoreQuality(void);
+
+private:
+    void reduceQuality(void);
+
+    QCustomPlot *m_plot;
+    QTimer m_idleTimer;
+    int m_idleDelayMs = 300; // After the last interaction
+    double m_frameBudgetMs = 33.0;
+    quint8 m_overBudgetFrames = 0; // Consecutive full-quality frames over budget
+    bool m_interacting = false;
+    bool m_reduced = false;
+    bool m_finalReplot = false;
+
+    // Settings restored when the plot goes idle
+    QCP::AntialiasedElements m_fullNotAntialiased;
+    QCP::PlottingHints m_fullHints;
+};
+
+#endif // RENDERQUALITY_H
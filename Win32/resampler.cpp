@@ -0,0 +1,309 @@
+#include "resampler.h"
+#include <QDebug>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+
+const quint32 PHASES = 256; // Kernel rows per input sample interval
+const quint32 MAX_HALF_TAPS = 256;
+const double PASSBAND = 0.9; // Cut-off as a fraction of the lower Nyquist frequency
+const double KAISER_BETA = 8.0;
+const qint32 BLOCK_ROWS = 4096; // Rows per block when a whole recording is resampled
+const qint64 TRIM_SAMPLES = 4096; // History dropped once this many samples are no longer needed
+
+// Modified Bessel function of the first kind, order 0, by its power series
+static double besselI0(double x)
+{
+    double sum = 1;
+    double term = 1;
+    const double quarter = x * x / 4;
+    for (qint32 k = 1; k < 50 && term > sum * 1e-17; ++k)
+    {
+        term *= quarter / (double(k) * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// Dot product in independent partial sums, so the compiler can keep them in vector registers
+static inline double dot(const double *x, const double *coefficients, quint32 count)
+{
+    double sum[4] = {};
+    quint32 i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        sum[0] += x[i] * coefficients[i];
+        sum[1] += x[i + 1] * coefficients[i + 1];
+        sum[2] += x[i + 2] * coefficients[i + 2];
+        sum[3] += x[i + 3] * coefficients[i + 3];
+    }
+    for (; i < count; ++i)
+    {
+        sum[0] += x[i] * coefficients[i];
+    }
+    return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+}
+
+void DriftClock::add(qint64 index, double time)
+{
+    if (qIsNaN(time))
+        return;
+    if (m_count == 0)
+    {
+        m_firstIndex = index;
+        m_origin = time;
+    }
+
+    // Running means and co-moments (Welford), no large sums to cancel
+    const double n = index - m_firstIndex;
+    const double t = time - m_origin;
+    ++m_count;
+    const double dn = n - m_meanN;
+    m_meanN += dn / m_count;
+    m_meanT += (t - m_meanT) / m_count;
+    m_cnn += dn * (n - m_meanN);
+    m_cnt += dn * (t - m_meanT);
+    m_span = qMax(m_span, qAbs(t));
+}
+
+void DriftClock::add(qint64 firstIndex, const QVector<double> &times)
+{
+    for (qint32 i = 0; i < times.size(); ++i)
+    {
+        add(firstIndex + i, times[i]);
+    }
+}
+
+void SincResampler::configure(quint32 channelCount, double inputRate, double outputRate, quint32 halfTaps)
+{
+    m_outputRate = outputRate;
+    const double ratio = inputRate > 0 ? qMin(1.0, outputRate / inputRate) : 1.0;
+    m_cutoff = PASSBAND * ratio;
+    m_halfTaps = qBound<quint32>(2, qCeil(halfTaps / ratio), MAX_HALF_TAPS);
+    m_taps = 2 * m_halfTaps;
+
+    // Row p is the kernel for an output p / PHASES of an interval past input sample base,
+    // tap j weighing input sample base - halfTaps + 1 + j
+    m_table.resize((PHASES + 1) * m_taps);
+    const double i0Beta = besselI0(KAISER_BETA);
+    for (quint32 p = 0; p <= PHASES; ++p)
+    {
+        double *row = m_table.data() + p * m_taps;
+        double sum = 0;
+        for (quint32 j = 0; j < m_taps; ++j)
+        {
+            const double x = double(j) - (m_halfTaps - 1) - double(p) / PHASES;
+            const double r = x / m_halfTaps;
+            const double window = qAbs(r) < 1 ? besselI0(KAISER_BETA * qSqrt(1 - r * r)) / i0Beta : 0;
+            const double arg = M_PI * m_cutoff * x;
+            const double sinc = qAbs(arg) < 1e-12 ? 1 : std::sin(arg) / arg;
+            row[j] = m_cutoff * sinc * window;
+            sum += row[j];
+        }
+
+        // Unit gain at DC for every phase, or a constant input would ripple
+        for (quint32 j = 0; j < m_taps; ++j)
+        {
+            row[j] /= sum;
+        }
+    }
+    m_coefficients.resize(m_taps);
+
+    m_history = QVector<QVector<double>>(channelCount);
+    m_fixedClock = false;
+    reset();
+}
+
+void SincResampler::setClock(const DriftClock &clock)
+{
+    m_clock = clock;
+    m_fixedClock = true;
+}
+
+void SincResampler::reset(void)
+{
+    if (!m_fixedClock)
+    {
+        m_clock.reset();
+    }
+    for (QVector<double> &history : m_history)
+    {
+        history.clear();
+    }
+    m_inputCount = 0;
+    m_historyStart = 0;
+    m_next = 0;
+    m_started = false;
+}
+
+void SincResampler::kernel(double fraction, double *coefficients) const
+{
+    // Linear interpolation between the two nearest tabulated phases
+    const double position = qBound(0.0, fraction, 1.0) * PHASES;
+    const quint32 phase = qMin<quint32>(PHASES - 1, quint32(position));
+    const double weight = position - phase;
+    const double *row0 = m_table.constData() + phase * m_taps;
+    const double *row1 = row0 + m_taps;
+    for (quint32 j = 0; j < m_taps; ++j)
+    {
+        coefficients[j] = row0[j] + weight * (row1[j] - row0[j]);
+    }
+}
+
+void SincResampler::process(const RowBlock &rows, RowBlock &output)
+{
+    if (!isConfigured())
+        return;
+
+    const qint32 channels = m_history.size();
+    output.channels.resize(channels);
+    if (!m_fixedClock)
+    {
+        m_clock.add(m_inputCount, rows.times);
+    }
+    for (qint32 c = 0; c < channels; ++c)
+    {
+        QVector<double> &history = m_history[c];
+        const qint32 count = c < rows.channels.size() ? qMin(rows.channels[c].size(), rows.rowCount()) : 0;
+        for (qint32 i = 0; i < rows.rowCount(); ++i)
+        {
+            const double value = i < count ? rows.channels[c][i] : qQNaN();
+            history.append(qIsNaN(value) ? (history.isEmpty() ? 0.0 : history.last()) : value);
+        }
+    }
+    m_inputCount += rows.rowCount();
+    if (!m_clock.isValid())
+        return;
+
+    // The first row is the first grid time with a full kernel of input before it, grid indices need 64 bits
+    const qint64 h = m_halfTaps;
+    if (!m_started)
+    {
+        m_next = qint64(std::ceil(m_clock.time(double(m_historyStart + h - 1)) * m_outputRate));
+        m_started = true;
+    }
+
+    double *coefficients = m_coefficients.data();
+    for (;; ++m_next)
+    {
+        const double time = m_next / m_outputRate;
+        const double position = m_clock.index(time);
+        const qint64 base = qint64(std::floor(position));
+        if (base + h >= m_inputCount)
+            break;
+        const qint64 first = base - h + 1;
+        if (first < m_historyStart)
+        {
+            // A refitted clock moved the grid back over dropped samples
+            continue;
+        }
+
+        kernel(position - base, coefficients);
+        for (qint32 c = 0; c < channels; ++c)
+        {
+            output.channels[c].append(dot(m_history[c].constData() + (first - m_historyStart), coefficients, m_taps));
+        }
+        output.times.append(time);
+    }
+
+    // Samples before the kernel of the next row are not needed again, with a margin for a refitted clock
+    const qint64 needed = qint64(std::floor(m_clock.index(m_next / m_outputRate))) - 2 * h;
+    if (needed - m_historyStart >= TRIM_SAMPLES)
+    {
+        const qint64 drop = qMin(needed, m_inputCount) - m_historyStart;
+        for (QVector<double> &history : m_history)
+        {
+            history.remove(0, drop);
+        }
+        m_historyStart += drop;
+    }
+}
+
+bool alignStreams(const QVector<RowBlock> &streams, double outputRate, RowBlock &aligned, const std::atomic_bool &cancel,
+                  QVector<DriftClock> *clocks)
+{
+    const qint32 streamCount = streams.size();
+    if (streamCount == 0 || outputRate <= 0)
+        return false;
+
+    // Each clock over the whole stream, far steadier than one fitted as the rows come
+    QVector<DriftClock> fitted(streamCount);
+    for (qint32 s = 0; s < streamCount; ++s)
+    {
+        fitted[s].add(0, streams[s].times);
+        if (!fitted[s].isValid())
+        {
+            qWarning() << "Stream" << s + 1 << "is too short to estimate its clock";
+            return false;
+        }
+    }
+    if (clocks)
+    {
+        *clocks = fitted;
+    }
+
+    QVector<RowBlock> resampled(streamCount);
+    QVector<qint32> order(streamCount);
+    for (qint32 s = 0; s < streamCount; ++s)
+    {
+        order[s] = s;
+    }
+    QtConcurrent::blockingMap(order, [&](qint32 s) {
+        const RowBlock &stream = streams[s];
+        SincResampler resampler;
+        resampler.configure(stream.channels.size(), fitted[s].rate(), outputRate);
+        resampler.setClock(fitted[s]);
+        resampled[s].clear(stream.channels.size());
+        for (qint32 first = 0; first < stream.rowCount() && !cancel; first += BLOCK_ROWS)
+        {
+            RowBlock block;
+            block.times = stream.times.mid(first, BLOCK_ROWS);
+            for (const QVector<double> &channel : stream.channels)
+            {
+                block.channels.append(channel.mid(first, BLOCK_ROWS));
+            }
+            resampler.process(block, resampled[s]);
+        }
+    });
+    if (cancel)
+        return false;
+
+    // Grid indices every stream covers
+    qint64 first = std::numeric_limits<qint64>::min();
+    qint64 last = std::numeric_limits<qint64>::max();
+    quint32 channelCount = 0;
+    for (const RowBlock &rows : std::as_const(resampled))
+    {
+        if (rows.rowCount() == 0)
+            return false;
+        first = qMax(first, qRound64(rows.times.first() * outputRate));
+        last = qMin(last, qRound64(rows.times.last() * outputRate));
+        channelCount += rows.channels.size();
+    }
+    if (last < first)
+    {
+        qWarning() << "The streams do not overlap in time";
+        return false;
+    }
+
+    const qint32 count = last - first + 1;
+    aligned.clear(channelCount);
+    aligned.times.resize(count);
+    for (qint32 i = 0; i < count; ++i)
+    {
+        aligned.times[i] = (first + i) / outputRate;
+    }
+    quint32 channel = 0;
+    for (const RowBlock &rows : std::as_const(resampled))
+    {
+        // Grid indices are epoch seconds times the rate, far past the range of an int
+        const qint64 offset = qRound64(rows.times.first() * outputRate);
+        for (const QVector<double> &column : rows.channels)
+        {
+            QVector<double> &out = aligned.channels[channel++];
+            out = column.mid(first - offset, count);
+            out.resize(count, qQNaN());
+        }
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QVector>
+#include <atomic>
+#include "recording.h"
+
+/**
+ * @brief Sample clock of a device, fitted to the host time stamps of its samples.
+ *
+ * Host times are arrival times, late by a jittery latency and bunched by the
+ * serial reads. A least-squares line of time against sample index averages
+ * that out and gives the actual rate of the board, drift included. It is
+ * kept as running means and co-moments relative to the first sample, which
+ * keep their precision over long sessions; adding a sample is O(1).
+ */
+class DriftClock
+{
+public:
+    void reset(void) { *this = DriftClock(); }
+
+    // Sample index has host time (s), NaN times are ignored
+    void add(qint64 index, double time);
+    void add(qint64 firstIndex, const QVector<double> &times);
+
+    // At least two samples a second apart, shorter fits are too noisy to use
+    bool isValid(void) const { return m_count >= 2 && m_cnt > 0 && m_span >= 1.0; }
+    double rate(void) const { return isValid() ? m_cnn / m_cnt : 0; } ///< Samples per second.
+    qint64 sampleCount(void) const { return m_count; }
+
+    // Fitted host time of a sample index and its inverse, valid clocks only
+    double time(double index) const { return m_origin + m_meanT + slope() * (index - m_firstIndex - m_meanN); }
+    double index(double time) const { return m_firstIndex + m_meanN + (time - m_origin - m_meanT) / slope(); }
+
+private:
+    double slope(void) const { return m_cnt / m_cnn; } // Seconds per sample
+
+    qint64 m_firstIndex = 0;
+    double m_origin = 0; // Time of the first sample
+    qint64 m_count = 0;
+    double m_meanN = 0;
+    double m_meanT = 0;
+    double m_cnn = 0; // Co-moments around the means
+    double m_cnt = 0;
+    double m_span = 0; // Seconds between the first and the last sample
+};
+
+/**
+ * @brief Windowed-sinc resampler of all channels of a stream onto a uniform time grid.
+ *
+ * Output rows are at the times k / outputRate, so streams resampled to the
+ * same rate share their grid and line up row for row. The input position of
+ * each output time comes from a DriftClock, either fitted as the rows
+ * arrive (live) or given already fitted over the whole recording (on load).
+ *
+ * The Kaiser-windowed sinc kernel is tabulated in phases between two input
+ * samples (polyphase); the kernel of an output row is interpolated between
+ * the two nearest phases once and applied to every channel, each channel a
+ * contiguous dot product. When the output rate is lower than the input rate
+ * the cut-off follows it down and the kernel widens to keep its quality.
+ *
+ * Input rows are processed in blocks of any size, only the samples the
+ * kernel still needs are kept. A missing sample repeats the previous one.
+ */
+class SincResampler
+{
+public:
+    // inputRate is the nominal rate of the input, which sets the cut-off
+    void configure(quint32 channelCount, double inputRate, double outputRate, quint32 halfTaps = 16);
+    // Uses clock for every position instead of fitting one to the input times
+    void setClock(const DriftClock &clock);
+    void reset(void);
+
+    bool isConfigured(void) const { return m_taps > 0; }
+    quint32 channelCount(void) const { return m_history.size(); }
+    double outputRate(void) const { return m_outputRate; }
+    const DriftClock &clock(void) const { return m_clock; }
+
+    // Appends the rows of the grid the input covers so far to output
+    void process(const RowBlock &rows, RowBlock &output);
+
+private:
+    void kernel(double fraction, double *coefficients) const;
+
+    double m_outputRate = 0;
+    double m_cutoff = 1; // Relative to the input Nyquist frequency
+    quint32 m_halfTaps = 0;
+    quint32 m_taps = 0;
+    QVector<double> m_table; // (PHASES + 1) rows of m_taps coefficients
+    QVector<double> m_coefficients; // Kernel of the current output row
+
+    DriftClock m_clock;
+    bool m_fixedClock = false;
+    qint64 m_inputCount = 0; // Input rows seen
+    qint64 m_historyStart = 0; // Input index of the first kept sample
+    QVector<QVector<double>> m_history; // Kept samples per channel
+    qint64 m_next = 0; // Grid index of the next output row
+    bool m_started = false;
+};
+
+/**
+ * @brief Resamples recordings made at the same time onto one grid and keeps their common span.
+ *
+ * Each stream gets its own DriftClock fitted over all its rows, so boards
+ * running slightly off their nominal rate (or off each other) are mapped to
+ * the host time base, then is resampled block by block; streams run in
+ * parallel on the thread pool. The output has the channels of all streams,
+ * in order, over the span every stream covers.
+ *
+ * @return false if a stream is too short for a clock, the streams do not overlap or cancel is set.
+ */
+bool alignStreams(const QVector<RowBlock> &streams, double outputRate, RowBlock &aligned, const std::atomic_bool &cancel,
+                  QVector<DriftClock> *clocks = nullptr);
+
+#endif // RESAMPLER_H
@@ -0,0 +1,160 @@
+#include "signalquality.h"
+#include <QDebug>
+#include <QtMath>
+#include <cmath>
+
+const double MAINS_FREQUENCIES[] = {50, 60};
+
+void SignalQualityMonitor::configure(quint32 channelCount, double sampleRate, const QualitySettings &settings)
+{
+    m_sampleRate = sampleRate;
+    m_settings = settings;
+    m_windowSize = sampleRate > 0 ? qMax(2, qRound(settings.windowSeconds * sampleRate)) : 0;
+
+    // Only the lines below Nyquist can be measured
+    m_lines.clear();
+    for (double frequency : MAINS_FREQUENCIES)
+    {
+        if ((settings.mainsFrequency == 0 || settings.mainsFrequency == frequency) && 2 * frequency < sampleRate)
+        {
+            // The Goertzel output is sum x[n] e^(jw(N - 1 - n)), for a constant that is sum e^(jwk)
+            Line line;
+            const double w = 2.0 * M_PI * frequency / sampleRate;
+            line.cosine = std::cos(w);
+            line.sine = std::sin(w);
+            line.coefficient = 2 * line.cosine;
+            for (quint32 k = 0; k < m_windowSize; ++k)
+            {
+                line.leakRe += std::cos(w * k);
+                line.leakIm += std::sin(w * k);
+            }
+            m_lines.append(line);
+        }
+    }
+
+    m_channels = QVector<ChannelState>(channelCount);
+    reset();
+}
+
+void SignalQualityMonitor::reset(void)
+{
+    for (ChannelState &state : m_channels)
+    {
+        state = ChannelState();
+    }
+}
+
+bool SignalQualityMonitor::process(const RowBlock &rows)
+{
+    if (!isConfigured())
+        return false;
+
+    bool changed = false;
+    const double jumpSize = m_settings.jumpFraction * m_settings.fullScale;
+    const qint32 lineCount = m_lines.size();
+    const quint32 channels = qMin<quint32>(m_channels.size(), rows.channels.size());
+    for (quint32 c = 0; c < channels; ++c)
+    {
+        ChannelState &state = m_channels[c];
+        const QVector<double> &values = rows.channels[c];
+        for (qint32 i = 0; i < values.size() && i < rows.rowCount(); ++i)
+        {
+            double value = values[i];
+            if (qIsNaN(value))
+            {
+                // The packet had no value for the channel, the last one is held
+                ++state.jumps;
+                if (qIsNaN(state.previous))
+                    continue;
+                value = state.previous;
+            }
+            else
+            {
+                if (value <= 0 || value >= m_settings.fullScale)
+                    ++state.clipped;
+                if (!qIsNaN(state.previous) && qAbs(value - state.previous) > jumpSize)
+                    ++state.jumps;
+            }
+            state.previous = value;
+
+            if (state.count == 0)
+                state.reference = value;
+            const double x = value - state.reference;
+            state.sum += x;
+            state.sumSquares += x * x;
+            for (qint32 l = 0; l < lineCount; ++l)
+            {
+                const double s = x + m_lines[l].coefficient * state.s1[l] - state.s2[l];
+                state.s2[l] = state.s1[l];
+                state.s1[l] = s;
+            }
+
+            if (++state.count == m_windowSize)
+            {
+                changed |= finishWindow(state);
+            }
+        }
+    }
+    return changed;
+}
+
+bool SignalQualityMonitor::finishWindow(ChannelState &state)
+{
+    const double n = state.count;
+    const double mean = state.sum / n;
+    const double variance = qMax(0.0, state.sumSquares / n - mean * mean);
+
+    // Power of a sine in the bin is 2 |X|^2 / N^2, once the window mean is taken out of X
+    double lineRatio = 0;
+    for (qint32 l = 0; l < m_lines.size(); ++l)
+    {
+        const Line &line = m_lines[l];
+        const double re = state.s1[l] - line.cosine * state.s2[l] - mean * line.leakRe;
+        const double im = line.sine * state.s2[l] - mean * line.leakIm;
+        const double power = 2 * (re * re + im * im) / (n * n);
+        if (variance > 0)
+            lineRatio = qMax(lineRatio, qMin(1.0, power / variance));
+    }
+
+    Verdict verdict;
+    verdict.rms = qSqrt(variance);
+    verdict.clippedFraction = state.clipped / n;
+    verdict.lineRatio = lineRatio;
+    verdict.jumps = state.jumps;
+    if (state.jumps >= m_settings.maxJumps)
+        verdict.status = ElectrodeOff;
+    else if (verdict.clippedFraction > m_settings.maxClippedFraction)
+        verdict.status = Clipping;
+    else if (variance < m_settings.varianceFloor)
+        verdict.status = Flat;
+    else if (lineRatio > m_settings.maxLineRatio)
+        verdict.status = LineNoise;
+    else
+        verdict.status = Good;
+
+    const bool changed = verdict.status != state.verdict.status;
+    const double previous = state.previous;
+    state = ChannelState();
+    state.previous = previous;
+    state.verdict = verdict;
+    return changed;
+}
+
+QString SignalQualityMonitor::statusName(Status status)
+{
+    switch (status)
+    {
+    case Good:
+        return "good";
+    case LineNoise:
+        return "line noise";
+    case Flat:
+        return "flat";
+    case Clipping:
+        return "clipping";
+    case ElectrodeOff:
+        return "electrode off";
+    default:
+        return "-";
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef SIGNALQUALITY_H
+#define SIGNALQUALITY_H
+
+#include <QVector>
+#include <QString>
+#include <QtNumeric>
+#include "recording.h"
+
+/**
+ * @brief Thresholds of SignalQualityMonitor, all checked once per window.
+ */
+struct QualitySettings
+{
+    double windowSeconds = 0.5; ///< Span of one verdict, a multiple of 100 ms holds whole 50 and 60 Hz periods.
+    double fullScale = 9999; ///< Largest value the decoder gives, samples at it or at 0 count as clipped.
+    double maxClippedFraction = 0.01; ///< Saturated above this fraction of clipped samples.
+    double varianceFloor = 1; ///< Flat line below this variance (value units squared).
+    double maxLineRatio = 0.5; ///< Line noise above this share of the variance at 50 or 60 Hz.
+    double jumpFraction = 0.5; ///< A step between two samples larger than this fraction of fullScale is a jump.
+    quint32 maxJumps = 3; ///< Electrode off from this many jumps or missing values per window.
+    quint8 mainsFrequency = 0; ///< Hz, 0 checks both 50 and 60.
+};
+
+/**
+ * @brief Per-channel signal quality of the raw stream, one verdict per window.
+ *
+ * Every sample updates running sums only: count, sum and sum of squares
+ * around the first sample of the window, clipped samples, jumps against the
+ * previous sample and a Goertzel recurrence at each mains frequency. At the
+ * end of a window the sums give the variance and the share of it in the
+ * Goertzel bin (with the leakage of the window mean taken out), and are
+ * cleared. A missing sample (NaN, as the decoder leaves an undecodable
+ * value) repeats the previous one and counts once with the jumps. Nothing
+ * is kept of the samples themselves.
+ */
+class SignalQualityMonitor
+{
+public:
+    enum Status
+    {
+        Unknown, // First window not complete yet
+        Good,
+        LineNoise,
+        Flat,
+        Clipping,
+        ElectrodeOff,
+    };
+
+    struct Verdict
+    {
+        Status status = Unknown;
+        double rms = 0; ///< Of the window, mean removed.
+        double clippedFraction = 0;
+        double lineRatio = 0; ///< Share of the variance in the strongest mains bin.
+        quint32 jumps = 0; ///< Jumps and missing values.
+    };
+
+    // Sets the parameters and clears the state, windows start with the next sample
+    void configure(quint32 channelCount, double sampleRate, const QualitySettings &settings);
+    void reset(void);
+
+    bool isConfigured(void) const { return m_windowSize > 0; }
+    quint32 channelCount(void) const { return m_channels.size(); }
+    double sampleRate(void) const { return m_sampleRate; }
+    const Verdict &verdict(quint32 channel) const { return m_channels[channel].verdict; }
+
+    // Runs the raw rows through the checks, returns true if a window ended and a verdict changed
+    bool process(const RowBlock &rows);
+
+    static QString statusName(Status status);
+
+private:
+    struct Line
+    {
+        double coefficient = 0; // 2 cos(w)
+        double cosine = 0;
+        double sine = 0;
+        double leakRe = 0; // Goertzel output of a constant 1 over the window
+        double leakIm = 0;
+    };
+
+    struct ChannelState
+    {
+        quint32 count = 0;
+        double reference = 0; // First value of the window, sums are taken around it
+        double sum = 0;
+        double sumSquares = 0;
+        double previous = qQNaN();
+        quint32 clipped = 0;
+        quint32 jumps = 0;
+        double s1[2] = {}; // Goertzel state per line
+        double s2[2] = {};
+        Verdict verdict;
+    };
+
+    bool finishWindow(ChannelState &state);
+
+    double m_sampleRate = 0;
+    quint32 m_windowSize = 0;
+    QualitySettings m_settings;
+    QVector<Line> m_lines;
+    QVector<ChannelState> m_channels;
+};
+
+#endif // SIGNALQUALITY_H
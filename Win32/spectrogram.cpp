@@ -0,0 +1,335 @@
+#include "spectrogram.h"
+#include <limits>
+
+// Dynamic range shown by the color map below the peak magnitude
+static const double SPECTROGRAM_RANGE_DB = 60.0;
+
+StftProcessor::StftProcessor(quint32 fftSize, quint32 hop)
+{
+    configure(fftSize, hop);
+}
+
+void StftProcessor::configure(quint32 fftSize, quint32 hop)
+{
+    if (!isPowerOfTwo(fftSize))
+    {
+        qWarning() << "Invalid FFT size:" << fftSize << "using 256";
+        fftSize = 256;
+    }
+    m_fftSize = fftSize;
+    m_hop = qBound<quint32>(1, hop, fftSize);
+
+    hannWindow(m_window, m_fftSize);
+    m_plan = &FftPlan::plan(m_fftSize);
+    m_frame.resize(m_fftSize);
+    m_re.resize(binCount());
+    m_im.resize(binCount());
+    m_ring.resize(m_fftSize);
+    reset();
+}
+
+void StftProcessor::reset(void)
+{
+    m_ring.fill(0);
+    m_head = 0;
+    m_filled = 0;
+    m_sinceLast = 0;
+}
+
+bool StftProcessor::push(double sample, QVector<double> &column)
+{
+    if (qIsNaN(sample))
+    {
+        // Nothing to repeat before the first sample
+        if (m_filled == 0)
+            return false;
+        sample = m_ring[(m_head + m_fftSize - 1) % m_fftSize];
+    }
+
+    m_ring[m_head] = sample;
+    m_head = (m_head + 1) % m_fftSize;
+    if (m_filled < m_fftSize) ++m_filled;
+    ++m_sinceLast;
+
+    if (m_filled < m_fftSize || m_sinceLast < m_hop)
+        return false;
+    m_sinceLast = 0;
+
+    // Remove the offset of the raw ADC values, it would swamp the low bins through leakage
+    double mean = 0;
+    for (quint32 i = 0; i < m_fftSize; ++i)
+    {
+        mean += m_ring[i];
+    }
+    mean /= m_fftSize;
+
+    // Oldest sample is at m_head
+    for (quint32 i = 0; i < m_fftSize; ++i)
+    {
+        m_frame[i] = (m_ring[(m_head + i) % m_fftSize] - mean) * m_window[i];
+    }
+    m_plan->realForward(m_frame.constData(), m_re.data(), m_im.data());
+
+    column.resize(binCount());
+    for (quint32 k = 0; k < binCount(); ++k)
+    {
+        column[k] = 20.0 * std::log10(std::sqrt(m_re[k] * m_re[k] + m_im[k] * m_im[k]) + 1e-12);
+    }
+    return true;
+}
+
+SpectrogramMap::SpectrogramMap(QCPAxis *keyAxis, QCPAxis *valueAxis) : QCPColorMap(keyAxis, valueAxis)
+{
+    setGradient(QCPColorGradient::gpJet);
+    setInterpolate(true);
+    setTightBoundary(false);
+}
+
+void SpectrogramMap::setGeometry(quint32 columns, quint32 bins, double maxFrequency)
+{
+    m_columns = columns;
+    m_bins = bins;
+    data()->setSize(columns, bins);
+    data()->setValueRange(QCPRange(0, maxFrequency));
+
+    m_values.resize(columns * bins);
+    m_ring = QImage(2 * columns, bins, QImage::Format_ARGB32_Premultiplied);
+    clear();
+}
+
+void SpectrogramMap::clear(void)
+{
+    m_values.fill(qQNaN());
+    m_ring.fill(Qt::transparent);
+    m_head = 0;
+    m_count = 0;
+    m_pending = 0;
+    m_columnInterval = 0;
+    mMapImageInvalidated = true;
+}
+
+void SpectrogramMap::pushColumn(const QVector<double> &magnitudes, double time)
+{
+    if (m_columns == 0)
+        return;
+
+    double *column = m_values.data() + m_head * m_bins;
+    const quint32 bins = qMin<quint32>(m_bins, magnitudes.size());
+    std::copy(magnitudes.constBegin(), magnitudes.constBegin() + bins, column);
+
+    if (m_count > 0)
+    {
+        double interval = time - m_lastTime;
+        m_columnInterval = m_columnInterval > 0 ? 0.9 * m_columnInterval + 0.1 * interval : interval;
+    }
+    m_lastTime = time;
+
+    m_head = (m_head + 1) % m_columns;
+    m_count = qMin(m_count + 1, m_columns);
+    m_pending = qMin(m_pending + 1, m_columns);
+    updateKeyRange();
+
+    // Only tells draw() to call updateMapImage, the map data itself is never touched
+    mMapImageInvalidated = true;
+}
+
+void SpectrogramMap::updateKeyRange(void)
+{
+    // Newest column at the right edge, columns assumed evenly spaced
+    double span = (m_columns - 1) * m_columnInterval;
+    data()->setKeyRange(QCPRange(m_lastTime - span, m_lastTime));
+}
+
+void SpectrogramMap::colorizeColumn(quint32 index)
+{
+    const double *column = m_values.constData() + index * m_bins;
+    for (quint32 bin = 0; bin < m_bins; ++bin)
+    {
+        QRgb color = qIsNaN(column[bin]) ? 0 : mGradient.color(column[bin], mDataRange);
+
+        // Scanlines count from the top, bins from the bottom
+        QRgb *line = reinterpret_cast<QRgb*>(m_ring.scanLine(m_bins - 1 - bin));
+        line[index] = color;
+        line[index + m_columns] = color;
+    }
+}
+
+void SpectrogramMap::updateMapImage()
+{
+    if (m_columns == 0)
+    {
+        QCPColorMap::updateMapImage();
+        return;
+    }
+
+    if (m_coloredGradient != mGradient || !(m_coloredRange == mDataRange))
+    {
+        // Color settings changed, every column needs new colors
+        for (quint32 i = 0; i < m_columns; ++i)
+        {
+            colorizeColumn(i);
+        }
+        m_coloredGradient = mGradient;
+        m_coloredRange = mDataRange;
+    }
+    else
+    {
+        for (quint32 k = 0; k < m_pending; ++k)
+        {
+            colorizeColumn((m_head + m_columns - m_pending + k) % m_columns);
+        }
+    }
+    m_pending = 0;
+
+    // Oldest column is the next one to be written, view the ring from there without copying
+    const uchar *oldest = m_ring.constBits() + m_head * sizeof(QRgb);
+    mMapImage = QImage(oldest, m_columns, m_bins, m_ring.bytesPerLine(), m_ring.format());
+    mMapImageInvalidated = false;
+}
+
+SpectrogramView::SpectrogramView(QCustomPlot *plot, QCPAxis *timeAxis)
+    : QObject(plot), m_plot(plot), m_timeAxis(timeAxis), m_peakDb(std::numeric_limits<double>::lowest())
+{
+}
+
+void SpectrogramView::setVisible(bool visible)
+{
+    if (visible && !m_axisRect)
+        createPane();
+    else if (!visible && m_axisRect)
+        removePane();
+    m_plot->replot();
+}
+
+void SpectrogramView::createPane(void)
+{
+    m_axisRect = new QCPAxisRect(m_plot);
+    m_plot->plotLayout()->addElement(m_plot->plotLayout()->rowCount(), 0, m_axisRect);
+
+    // Keep the left and right edges aligned with the time trace
+    m_marginGroup = new QCPMarginGroup(m_plot);
+    m_plot->axisRect()->setMarginGroup(QCP::msLeft | QCP::msRight, m_marginGroup);
+    m_axisRect->setMarginGroup(QCP::msLeft | QCP::msRight, m_marginGroup);
+
+    QCPAxis *bottom = m_axisRect->axis(QCPAxis::atBottom);
+    QCPAxis *left = m_axisRect->axis(QCPAxis::atLeft);
+    bottom->setTicker(m_timeAxis->ticker());
+    bottom->setRange(m_timeAxis->range());
+    connect(m_timeAxis, SIGNAL(rangeChanged(QCPRange)), bottom, SLOT(setRange(QCPRange)));
+    left->setLabel("Frequency (Hz)");
+    left->setRange(0, m_sampleRate / 2);
+
+    // Dragging or zooming the pane moves the time trace, which the pane follows
+    m_axisRect->setRangeDrag(Qt::Horizontal);
+    m_axisRect->setRangeZoom(Qt::Horizontal);
+    m_axisRect->setRangeDragAxes(m_timeAxis, nullptr);
+    m_axisRect->setRangeZoomAxes(m_timeAxis, nullptr);
+
+    m_map = new SpectrogramMap(bottom, left);
+    m_map->setGeometry(m_visibleColumns, m_stft.binCount(), m_sampleRate / 2);
+
+    m_medianCurve = new QCPCurve(bottom, left);
+    m_medianCurve->setName("Median frequency");
+    m_medianCurve->setPen(QPen(Qt::white, 2));
+
+    clear();
+}
+
+void SpectrogramView::removePane(void)
+{
+    m_plot->removePlottable(m_map);
+    m_plot->removePlottable(m_medianCurve);
+    m_plot->axisRect()->setMarginGroup(QCP::msLeft | QCP::msRight, nullptr);
+    m_plot->plotLayout()->remove(m_axisRect);
+    m_plot->plotLayout()->simplify();
+    delete m_marginGroup;
+
+    m_axisRect = nullptr;
+    m_marginGroup = nullptr;
+    m_map = nullptr;
+    m_medianCurve = nullptr;
+}
+
+void SpectrogramView::configure(quint32 fftSize, quint32 hop)
+{
+    m_stft.configure(fftSize, hop);
+    if (m_map)
+        m_map->setGeometry(m_visibleColumns, m_stft.binCount(), m_sampleRate / 2);
+    clear();
+}
+
+void SpectrogramView::setSampleRate(double sampleRate)
+{
+    // Ignore jitter of the host time stamps
+    if (sampleRate <= 0 || qAbs(sampleRate - m_sampleRate) < 0.05 * m_sampleRate)
+        return;
+
+    m_sampleRate = sampleRate;
+    if (m_axisRect)
+    {
+        m_map->data()->setValueRange(QCPRange(0, m_sampleRate / 2));
+        m_axisRect->axis(QCPAxis::atLeft)->setRange(0, m_sampleRate / 2);
+    }
+}
+
+void SpectrogramView::appendSamples(const double *values, const double *times, quint32 count)
+{
+    if (!m_axisRect)
+        return;
+
+    for (quint32 i = 0; i < count; ++i)
+    {
+        if (!m_stft.push(values[i], m_column))
+            continue;
+
+        double peak = *std::max_element(m_column.constBegin(), m_column.constEnd());
+        if (peak > m_peakDb + 3.0)
+        {
+            // Rare: recolors the whole ring once
+            m_peakDb = peak;
+            m_map->setDataRange(QCPRange(m_peakDb - SPECTROGRAM_RANGE_DB, m_peakDb));
+        }
+
+        m_map->pushColumn(m_column, times[i]);
+        m_medianCurve->addData(times[i], times[i], medianFrequency(m_column));
+    }
+
+    // Median frequency is kept for the visible columns only
+    if (count > 0)
+    {
+        double span = m_visibleColumns * m_stft.hop() / m_sampleRate;
+        m_medianCurve->data()->removeBefore(times[count - 1] - span);
+    }
+}
+
+double SpectrogramView::medianFrequency(const QVector<double> &magnitudes) const
+{
+    // Median of the power spectrum, DC bin excluded
+    QVector<double> power(magnitudes.size());
+    double total = 0;
+    for (qint32 k = 1; k < magnitudes.size(); ++k)
+    {
+        power[k] = std::pow(10.0, magnitudes[k] / 10.0);
+        total += power[k];
+    }
+
+    double cumulative = 0;
+    for (qint32 k = 1; k < magnitudes.size(); ++k)
+    {
+        cumulative += power[k];
+        if (cumulative >= total / 2)
+            return k * m_sampleRate / m_stft.fftSize();
+    }
+    return 0;
+}
+
+void SpectrogramView::clear(void)
+{
+    m_stft.reset();
+    m_peakDb = std::numeric_limits<double>::lowest();
+    if (m_axisRect)
+    {
+        m_map->clear();
+        m_medianCurve->data()->clear();
+    }
+}
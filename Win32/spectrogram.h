@@ -0,0 +1,148 @@
+#ifndef SPECTROGRAM_H
+#define SPECTROGRAM_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include "qcustomplot.h"
+#include "fft.h"
+
+/**
+ * @brief Incremental short-time Fourier transform of one channel.
+ *
+ * Samples are pushed as they arrive. Every hop samples, once a full frame of
+ * fftSize samples is available, one magnitude column (fftSize / 2 + 1 bins,
+ * in dB) is produced. No sample is ever transformed more than
+ * fftSize / hop times. A missing sample (NaN) repeats the previous one, as
+ * in the other stages, so it cannot turn the frames around it into NaN.
+ */
+class StftProcessor
+{
+public:
+    StftProcessor(quint32 fftSize = 256, quint32 hop = 64);
+
+    // Changes the frame parameters and drops the buffered samples
+    void configure(quint32 fftSize, quint32 hop);
+    void reset(void);
+
+    quint32 fftSize(void) const { return m_fftSize; }
+    quint32 hop(void) const { return m_hop; }
+    quint32 binCount(void) const { return m_fftSize / 2 + 1; }
+
+    // Pushes one sample, returns true if a new column was written to column
+    bool push(double sample, QVector<double> &column);
+
+private:
+    quint32 m_fftSize;
+    quint32 m_hop;
+    QVector<double> m_ring; // Last fftSize samples
+    quint32 m_head = 0; // Next write position in m_ring
+    quint32 m_filled = 0; // Number of valid samples in m_ring
+    quint32 m_sinceLast = 0; // Samples pushed since the last column
+    QVector<double> m_window;
+    const FftPlan *m_plan = nullptr;
+    QVector<double> m_frame;
+    QVector<double> m_re; // Spectrum of the frame
+    QVector<double> m_im;
+};
+
+/**
+ * @brief Color map fed column by column from a ring buffer.
+ *
+ * The colored image is twice as wide as the number of visible columns and
+ * every column is written twice (at i and i + columns), so the visible window
+ * is always one contiguous region of it. updateMapImage() only colorizes the
+ * columns pushed since the last draw and then points mMapImage at that region
+ * without copying; the whole image is only recolored when the gradient or the
+ * data range changes.
+ */
+class SpectrogramMap : public QCPColorMap
+{
+    Q_OBJECT
+
+public:
+    SpectrogramMap(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+    // Sets the number of visible columns and frequency bins, clears the map
+    void setGeometry(quint32 columns, quint32 bins, double maxFrequency);
+    void clear(void);
+
+    // Appends a column of magnitudes (in dB) at the given time
+    void pushColumn(const QVector<double> &magnitudes, double time);
+
+protected:
+    void updateMapImage() override;
+
+private:
+    void colorizeColumn(quint32 index);
+    void updateKeyRange(void);
+
+    quint32 m_columns = 0;
+    quint32 m_bins = 0;
+    QVector<double> m_values; // Column-major magnitudes, m_columns * m_bins
+    QImage m_ring; // 2 * m_columns wide
+    quint32 m_head = 0; // Next column to write
+    quint32 m_count = 0; // Number of columns written, up to m_columns
+    quint32 m_pending = 0; // Columns not yet colorized
+    double m_lastTime = 0;
+    double m_columnInterval = 0; // Running average of the time between columns
+
+    // Color settings the ring was colored with
+    QCPColorGradient m_coloredGradient;
+    QCPRange m_coloredRange;
+};
+
+/**
+ * @brief Spectrogram pane below the time trace of the main plot.
+ *
+ * Adds its own axis rect to the plot layout with the time axis slaved to the
+ * main x-axis. The median frequency of every column is drawn on top of the
+ * map, which is the usual fatigue indicator for EMG. The pane is owned by the
+ * plot layout and only exists while the view is visible.
+ */
+class SpectrogramView : public QObject
+{
+    Q_OBJECT
+
+public:
+    SpectrogramView(QCustomPlot *plot, QCPAxis *timeAxis);
+
+    void setVisible(bool visible);
+    bool isVisible(void) const { return m_axisRect != nullptr; }
+
+    void setChannel(quint8 channel) { m_channel = channel; clear(); }
+    quint8 channel(void) const { return m_channel; }
+
+    void configure(quint32 fftSize, quint32 hop);
+    quint32 fftSize(void) const { return m_stft.fftSize(); }
+    quint32 hop(void) const { return m_stft.hop(); }
+
+    // Sample rate used for the frequency axis and the median frequency
+    void setSampleRate(double sampleRate);
+
+    // Feeds new samples of the selected channel, times are the sample times in seconds
+    void appendSamples(const double *values, const double *times, quint32 count);
+
+    void clear(void);
+
+private:
+    void createPane(void);
+    void removePane(void);
+    double medianFrequency(const QVector<double> &magnitudes) const;
+
+    QCustomPlot *m_plot;
+    QPointer<QCPAxis> m_timeAxis;
+    QCPAxisRect *m_axisRect = nullptr;
+    QCPMarginGroup *m_marginGroup = nullptr;
+    SpectrogramMap *m_map = nullptr;
+    QCPCurve *m_medianCurve = nullptr; // A curve, so clearGraphs() on the main plot leaves it alone
+
+    StftProcessor m_stft;
+    QVector<double> m_column;
+    quint8 m_channel = 0;
+    double m_sampleRate = 1000;
+    quint32 m_visibleColumns = 512;
+    double m_peakDb; // Highest magnitude seen, top of the color range
+};
+
+#endif // SPECTROGRAM_H
@@ -0,0 +1,525 @@
+#include "textrecording.h"
+#include "clocktime.h"
+#include <QDebug>
+#include <QFile>
+#include <QtConcurrent>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+static const qint64 IMPORT_CHUNK_MIN = 1024 * 1024; // Bytes parsed by one task, at least
+static const qint64 IMPORT_CHUNK_MAX = 16 * 1024 * 1024; // and at most
+static const qint32 EXPORT_BLOCK_ROWS = 16384; // Rows formatted by one task
+static const qint32 MAX_VALUE_CHARS = 24; // Longest shortest-round-trip double, "-2.2250738585072014e-308"
+
+bool TextRecordingSource::open(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open file for reading:" << file.errorString();
+        return false;
+    }
+
+    m_fileName = fileName;
+    m_delimiter = fileName.endsWith(".csv", Qt::CaseInsensitive) ? ',' : '\t';
+
+    m_channelCount = parseHeader(file.readLine(), m_delimiter).size();
+    m_dataOffset = file.pos();
+    return m_channelCount > 0;
+}
+
+QStringList TextRecordingSource::parseHeader(const QByteArray &line, char delimiter)
+{
+    // "Time" followed by one column per channel
+    QStringList labels = QString::fromLatin1(line.trimmed()).split(QLatin1Char(delimiter));
+    labels.removeFirst();
+    for (QString &label : labels)
+    {
+        label = label.trimmed();
+    }
+    return labels;
+}
+
+// Parses a whole field as a double, surrounding spaces are allowed
+static inline bool parseValue(const char *begin, const char *end, double &value)
+{
+    while (begin < end && *begin == ' ')
+    {
+        ++begin;
+    }
+    while (end > begin && end[-1] == ' ')
+    {
+        --end;
+    }
+    if (begin < end && *begin == '+')
+    {
+        ++begin;
+    }
+
+    std::from_chars_result result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+bool TextRecordingSource::parseLine(const char *begin, const char *end, char delimiter, quint32 channelCount, double &time, double *values,
+                                    quint32 *invalidFields)
+{
+
+    // Strip the line break
+    while (end > begin && (end[-1] == '\n' || end[-1] == '\r'))
+    {
+        --end;
+    }
+
+    const char *field = begin;
+    const char *next = std::find(field, end, delimiter);
+    qint64 msecsOfDay;
+    if (!parseClockTime(field, next - field, &msecsOfDay))
+    {
+        return false;
+    }
+    time = clockTimeToKey(msecsOfDay);
+
+    quint32 invalid = 0;
+    for (quint32 c = 0; c < channelCount; ++c)
+    {
+        values[c] = qQNaN();
+        if (next == end)
+        {
+            ++invalid;
+            continue;
+        }
+        field = next + 1;
+        next = std::find(field, end, delimiter);
+
+        double value;
+        if (parseValue(field, next, value))
+        {
+            values[c] = value;
+        }
+        else
+        {
+            ++invalid;
+        }
+    }
+    if (invalidFields)
+    {
+        *invalidFields = invalid;
+    }
+    return true;
+}
+
+bool TextRecordingSource::buildIndex(RecordingIndex &index, const std::atomic_bool &cancel) const
+{
+    // The sidecar of an earlier scan spares parsing the whole file
+    if (index.load(m_fileName) && index.channelCount == m_channelCount)
+    {
+        qInfo() << "Index of" << m_fileName << "read from" << RecordingIndex::sidecarFileName(m_fileName);
+        return true;
+    }
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open file for reading:" << file.errorString();
+        return false;
+    }
+    file.seek(m_dataOffset);
+    index.reset(m_channelCount, RecordingIndex::DEFAULT_ROWS_PER_BLOCK);
+
+    QVector<double> values(m_channelCount);
+    QVector<double> minimum, maximum;
+    qint64 blockOffset = 0;
+    qint32 rows = 0;
+    double start = 0, end = 0;
+
+    while (!file.atEnd())
+    {
+        qint64 offset = file.pos();
+        QByteArray line = file.readLine();
+        double time;
+        if (!parseLine(line, m_delimiter, m_channelCount, time, values.data()))
+        {
+            continue;
+        }
+
+        if (rows == 0)
+        {
+            if (cancel)
+            {
+                return false;
+            }
+            blockOffset = offset;
+            start = time;
+            minimum.fill(std::numeric_limits<double>::infinity(), m_channelCount);
+            maximum.fill(-std::numeric_limits<double>::infinity(), m_channelCount);
+        }
+
+        end = time;
+        for (quint32 c = 0; c < m_channelCount; ++c)
+        {
+            // NaN compares false, so failed fields never enter the summary
+            if (values[c] < minimum[c]) minimum[c] = values[c];
+            if (values[c] > maximum[c]) maximum[c] = values[c];
+        }
+
+        if (++rows == qint32(index.rowsPerBlock))
+        {
+            index.appendBlock(blockOffset, rows, start, end, minimum.constData(), maximum.constData());
+            rows = 0;
+        }
+    }
+
+    if (rows > 0)
+    {
+        index.appendBlock(blockOffset, rows, start, end, minimum.constData(), maximum.constData());
+    }
+    index.buildPyramid();
+    index.save(m_fileName);
+    return true;
+}
+
+bool TextRecordingSource::readBlock(const RecordingIndex &index, qint32 block, RowBlock &rows) const
+{
+    if (block < 0 || block >= index.blockCount())
+    {
+        return false;
+    }
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(index.blockOffsets[block]))
+    {
+        qWarning() << "Unable to read block" << block << "of" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+
+    rows.clear(m_channelCount);
+    const qint32 count = index.blockRows[block];
+    rows.times.reserve(count);
+    for (quint32 c = 0; c < m_channelCount; ++c)
+    {
+        rows.channels[c].reserve(count);
+    }
+
+    QVector<double> values(m_channelCount);
+    while (rows.rowCount() < count && !file.atEnd())
+    {
+        double time;
+        if (!parseLine(file.readLine(), m_delimiter, m_channelCount, time, values.data()))
+        {
+            continue;
+        }
+        rows.times.append(time);
+        for (quint32 c = 0; c < m_channelCount; ++c)
+        {
+            rows.channels[c].append(values[c]);
+        }
+    }
+    return true;
+}
+
+namespace
+{
+    struct TextBlock
+    {
+        qint32 first;
+        qint32 count;
+        QByteArray text;
+    };
+}
+
+static void formatRows(TextBlock &block, const QList<QString> &times, const QVector<QList<double>> &channels,
+                       quint32 channelCount, char delimiter)
+{
+    // Columns hoisted out of the row loop, a missing channel is written as "nan"
+    QVector<const double*> columns(channelCount, nullptr);
+    QVector<qint32> sizes(channelCount, 0);
+    for (quint32 c = 0; c < channelCount && c < quint32(channels.size()); ++c)
+    {
+        columns[c] = channels[c].constData();
+        sizes[c] = channels[c].size();
+    }
+
+    const qint64 valuesSize = qint64(channelCount) * (1 + MAX_VALUE_CHARS) + 1;
+    block.text.resize(block.count * (CLOCK_TIME_SIZE + valuesSize));
+    char *out = block.text.data();
+
+    for (qint32 i = block.first; i < block.first + block.count; ++i)
+    {
+        // Grow for time stamps longer than usual
+        const QString &time = times[i];
+        qint64 used = out - block.text.constData();
+        if (block.text.size() - used < time.size() + valuesSize)
+        {
+            block.text.resize(block.text.size() * 2 + time.size() + valuesSize);
+            out = block.text.data() + used;
+        }
+        char *end = block.text.data() + block.text.size();
+
+        for (QChar ch : time)
+        {
+            *out++ = char(ch.unicode());
+        }
+        for (quint32 c = 0; c < channelCount; ++c)
+        {
+            *out++ = delimiter;
+            if (i < sizes[c])
+            {
+                out = std::to_chars(out, end, columns[c][i]).ptr;
+            }
+            else
+            {
+                memcpy(out, "nan", 3);
+                out += 3;
+            }
+        }
+        *out++ = '\n';
+    }
+
+    block.text.truncate(out - block.text.constData());
+}
+
+static void parseChunk(TextImport &chunk, const char *begin, const char *end, char delimiter,
+                       quint32 channelCount, const std::atomic_bool &cancel)
+{
+    chunk.rows.clear(channelCount);
+    QVector<double> values(channelCount);
+    qint32 lines = 0;
+
+    while (begin < end)
+    {
+        const char *lineEnd = static_cast<const char*>(memchr(begin, '\n', end - begin));
+        lineEnd = lineEnd ? lineEnd + 1 : end;
+
+        double time;
+        quint32 invalidFields;
+        if (TextRecordingSource::parseLine(begin, lineEnd, delimiter, channelCount, time, values.data(), &invalidFields))
+        {
+            if (invalidFields > 0)
+            {
+                chunk.invalidRows.append(chunk.rows.rowCount());
+            }
+            chunk.rows.times.append(time);
+            chunk.timeStrings.append(QString::fromLatin1(begin, CLOCK_TIME_SIZE));
+            for (quint32 c = 0; c < channelCount; ++c)
+            {
+                chunk.rows.channels[c].append(values[c]);
+            }
+        }
+        else if (lineEnd - begin > 2 || (*begin != '\n' && *begin != '\r'))
+        {
+            ++chunk.skippedLines;
+        }
+        begin = lineEnd;
+
+        if ((++lines & 0xFFF) == 0 && cancel)
+        {
+            return;
+        }
+    }
+}
+
+bool readTextRecording(const QString &fileName, TextImport &result, const std::atomic_bool &cancel,
+                       const std::function<void(int)> &progress)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open file for reading:" << file.errorString();
+        return false;
+    }
+
+    // The header decides the channels
+    const char delimiter = fileName.endsWith(".csv", Qt::CaseInsensitive) ? ',' : '\t';
+    result.labels = TextRecordingSource::parseHeader(file.readLine(), delimiter);
+    const quint32 channelCount = result.channelCount();
+    const qint64 dataOffset = file.pos();
+    result.rows.clear(channelCount);
+    result.timeStrings.clear();
+    result.invalidRows.clear();
+    result.skippedLines = 0;
+    if (channelCount == 0)
+    {
+        qWarning() << "No channels in the header of" << fileName;
+        return false;
+    }
+
+    const qint64 size = file.size();
+    if (dataOffset >= size)
+    {
+        return true;
+    }
+    const char *data = reinterpret_cast<const char*>(file.map(0, size));
+    if (!data)
+    {
+        qWarning() << "Unable to map" << fileName;
+        return false;
+    }
+    const char *begin = data + dataOffset;
+    const char *end = data + size;
+
+    // Chunks end on a line break, so no line is split between two tasks
+    const qint64 chunkSize = qBound(IMPORT_CHUNK_MIN, size / 64, IMPORT_CHUNK_MAX);
+    QList<QFuture<void>> tasks;
+    QList<TextImport*> chunks;
+    while (begin < end)
+    {
+        const char *chunkEnd = begin + qMin<qint64>(chunkSize, end - begin);
+        if (chunkEnd < end)
+        {
+            const char *lineBreak = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+            chunkEnd = lineBreak ? lineBreak + 1 : end;
+        }
+
+        TextImport *chunk = new TextImport;
+        chunks.append(chunk);
+        tasks.append(QtConcurrent::run([chunk, begin, chunkEnd, delimiter, channelCount, &cancel]() {
+            parseChunk(*chunk, begin, chunkEnd, delimiter, channelCount, cancel);
+        }));
+        begin = chunkEnd;
+    }
+
+    // Progress as the chunks complete in file order
+    qint64 rowCount = 0;
+    for (qint32 i = 0; i < chunks.size(); ++i)
+    {
+        tasks[i].waitForFinished();
+        rowCount += chunks[i]->rows.rowCount();
+        if (progress && !cancel)
+        {
+            progress(int((i + 1) * 100LL / chunks.size()));
+        }
+    }
+    file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+
+    if (!cancel)
+    {
+        // Columns allocated once at their final size, then filled chunk by chunk
+        result.rows.times.resize(rowCount);
+        for (quint32 c = 0; c < channelCount; ++c)
+        {
+            result.rows.channels[c].resize(rowCount);
+        }
+        result.timeStrings.reserve(rowCount);
+
+        qint64 first = 0;
+        for (TextImport *chunk : std::as_const(chunks))
+        {
+            const RowBlock &rows = chunk->rows;
+            std::copy(rows.times.constBegin(), rows.times.constEnd(), result.rows.times.begin() + first);
+            for (quint32 c = 0; c < channelCount; ++c)
+            {
+                std::copy(rows.channels[c].constBegin(), rows.channels[c].constEnd(), result.rows.channels[c].begin() + first);
+            }
+            result.timeStrings.append(chunk->timeStrings);
+            for (qint64 row : std::as_const(chunk->invalidRows))
+            {
+                result.invalidRows.append(first + row);
+            }
+            result.skippedLines += chunk->skippedLines;
+            first += rows.rowCount();
+        }
+    }
+
+    qDeleteAll(chunks);
+    if (cancel)
+    {
+        result.rows.clear(channelCount);
+        result.timeStrings.clear();
+        result.invalidRows.clear();
+        return false;
+    }
+    if (result.skippedLines > 0 || !result.invalidRows.isEmpty())
+    {
+        qWarning() << "Skipped" << result.skippedLines << "lines without a time stamp and found" << result.invalidRows.size()
+                   << "rows with invalid values in" << fileName;
+    }
+    return true;
+}
+
+bool writeTextRecording(const QString &fileName, const QList<QString> &times, const QVector<QList<double>> &channels,
+                        quint32 channelCount, const std::atomic_bool &cancel, const std::function<void(int)> &progress)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Unable to open file for writing:" << file.errorString();
+        return false;
+    }
+
+    // The delimiter is picked once for the whole file
+    const char delimiter = fileName.endsWith(".csv", Qt::CaseInsensitive) ? ',' : '\t';
+
+    QByteArray header = "Time";
+    for (quint32 c = 0; c < channelCount; ++c)
+    {
+        header += delimiter;
+        header += "EMG" + QByteArray::number(c + 1);
+    }
+    header += '\n';
+    if (file.write(header) != header.size())
+    {
+        qWarning() << "Write failed:" << file.errorString();
+        return false;
+    }
+
+    // One block per pool thread in every batch
+    const qint32 rowCount = times.size();
+    const qint32 blocksPerBatch = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    qint32 nextRow = 0;
+    auto takeBatch = [&]() {
+        QVector<TextBlock> batch;
+        for (qint32 b = 0; b < blocksPerBatch && nextRow < rowCount; ++b)
+        {
+            qint32 count = qMin(EXPORT_BLOCK_ROWS, rowCount - nextRow);
+            batch.append({nextRow, count, QByteArray()});
+            nextRow += count;
+        }
+        return batch;
+    };
+    auto format = [&](TextBlock &block) {
+        formatRows(block, times, channels, channelCount, delimiter);
+    };
+
+    // The next batch is formatted while the current one is written
+    QVector<TextBlock> batch = takeBatch();
+    QFuture<void> formatting = QtConcurrent::map(batch, format);
+    while (!batch.isEmpty())
+    {
+        formatting.waitForFinished();
+        QVector<TextBlock> formatted;
+        formatted.swap(batch);
+
+        batch = takeBatch();
+        if (!batch.isEmpty())
+        {
+            formatting = QtConcurrent::map(batch, format);
+        }
+
+        for (const TextBlock &block : std::as_const(formatted))
+        {
+            if (file.write(block.text) != block.text.size())
+            {
+                qWarning() << "Write failed:" << file.errorString();
+                formatting.waitForFinished();
+                return false;
+            }
+        }
+
+        if (cancel)
+        {
+            formatting.waitForFinished();
+            file.remove();
+            return false;
+        }
+        if (progress)
+        {
+            const TextBlock &last = formatted.last();
+            progress(int((last.first + last.count) * 100LL / rowCount));
+        }
+    }
+
+    file.close();
+    return true;
+}
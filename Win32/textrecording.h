@@ -0,0 +1,98 @@
+#ifndef TEXTRECORDING_H
+#define TEXTRECORDING_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include "recording.h"
+
+/**
+ * @brief Recording stored as the .txt/.csv text written by saveDataToFile.
+ *
+ * The first line is the header ("Time", "EMG1", ...), every further line holds
+ * a "hh:mm:ss.zzz" time stamp and one value per channel, separated by commas
+ * for .csv files and tabs otherwise. Block offsets are byte positions of the
+ * first line of each block, so a block is read with a single seek. The index
+ * is kept in a sidecar file after the first scan and reused as long as the
+ * recording is unchanged.
+ */
+class TextRecordingSource : public RecordingSource
+{
+public:
+    // Reads the header of fileName, returns false if it cannot be opened
+    bool open(const QString &fileName);
+
+    QString fileName(void) const override { return m_fileName; }
+    quint32 channelCount(void) const override { return m_channelCount; }
+    char delimiter(void) const { return m_delimiter; }
+    qint64 dataOffset(void) const { return m_dataOffset; }
+
+    bool buildIndex(RecordingIndex &index, const std::atomic_bool &cancel) const override;
+    bool readBlock(const RecordingIndex &index, qint32 block, RowBlock &rows) const override;
+
+    // Channel labels of a header line ("Time", then one label per channel)
+    static QStringList parseHeader(const QByteArray &line, char delimiter);
+
+    // Parses one data line, failed or missing fields are set to NaN and counted in invalidFields.
+    // Returns false if the time stamp is invalid
+    static bool parseLine(const char *begin, const char *end, char delimiter, quint32 channelCount, double &time, double *values,
+                          quint32 *invalidFields = nullptr);
+    static bool parseLine(const QByteArray &line, char delimiter, quint32 channelCount, double &time, double *values)
+    {
+        return parseLine(line.constData(), line.constData() + line.size(), delimiter, channelCount, time, values);
+    }
+
+private:
+    QString m_fileName;
+    quint32 m_channelCount = 0;
+    char m_delimiter = '\t';
+    qint64 m_dataOffset = 0; // Byte position of the first data line
+};
+
+/**
+ * @brief Text recording loaded into memory by readTextRecording().
+ */
+struct TextImport
+{
+    QStringList labels; ///< Channel labels from the header, one per channel.
+    RowBlock rows;
+    QList<QString> timeStrings; ///< Time stamp of every row as written in the file.
+    QVector<qint64> invalidRows; ///< Rows with at least one missing or invalid value (NaN in the channel).
+    qint64 skippedLines = 0; ///< Lines without a valid time stamp.
+
+    quint32 channelCount(void) const { return labels.size(); }
+};
+
+/**
+ * @brief Loads a whole .txt/.csv recording.
+ *
+ * The channels are those of the header line. The file is mapped and split
+ * into newline-aligned chunks that are parsed in parallel on the thread pool;
+ * the result columns are then allocated once and filled in file order. Values
+ * are parsed with std::from_chars and time stamps with parseClockTime(). A
+ * row with missing or invalid values keeps its place with NaN in those
+ * channels and is listed in invalidRows; extra fields are ignored.
+ *
+ * @param progress Called on the calling thread with the percentage of chunks parsed.
+ * @return false on error, on a file without channels, or when cancel is set.
+ */
+bool readTextRecording(const QString &fileName, TextImport &result, const std::atomic_bool &cancel,
+                       const std::function<void(int)> &progress = nullptr);
+
+/**
+ * @brief Writes rows as the .txt/.csv text read by TextRecordingSource.
+ *
+ * Rows are formatted with std::to_chars into large buffers, blocks of rows on
+ * the thread pool while the previous blocks are written, so the export is
+ * limited by the disk. Values missing from a channel are written as "nan".
+ * A cancelled export removes the partial file.
+ *
+ * @param times Time stamp of every row, as displayed ("hh:mm:ss.zzz").
+ * @param progress Called on the calling thread with the percentage of rows written.
+ * @return false if the file cannot be written or cancel is set.
+ */
+bool writeTextRecording(const QString &fileName, const QList<QString> &times, const QVector<QList<double>> &channels,
+                        quint32 channelCount, const std::atomic_bool &cancel, const std::function<void(int)> &progress = nullptr);
+
+#endif // TEXTRECORDING_H
@@ -0,0 +1,158 @@
+#include "tracerasterizer.h"
+#include <QtConcurrent>
+
+TraceGraph::TraceGraph(QCPAxis *keyAxis, QCPAxis *valueAxis, TraceRasterizer *rasterizer)
+    : QCPGraph(keyAxis, valueAxis), m_rasterizer(rasterizer)
+{
+}
+
+bool TraceGraph::isRasterEligible(void) const
+{
+    // Only plain polylines are rasterised, everything else keeps the QCPGraph path
+    return mKeyAxis && mValueAxis
+           && mLineStyle == lsLine
+           && mScatterStyle.isNone()
+           && mBrush.style() == Qt::NoBrush
+           && !mChannelFillGraph
+           && selection().isEmpty();
+}
+
+void TraceGraph::rasterize(QImage &image) const
+{
+    image.fill(Qt::transparent);
+    if (mDataContainer->isEmpty() || mKeyAxis.data()->range().size() <= 0)
+        return;
+
+    // Same line generation as QCPGraph::draw, including adaptive sampling
+    QVector<QPointF> lines;
+    getLines(&lines, QCPDataRange(0, dataCount()));
+
+    // The image covers the axis rect only, so shift widget coordinates into it
+    QCPPainter painter(&image);
+    painter.translate(-clipRect().topLeft());
+    painter.setPen(mPen);
+    painter.setBrush(Qt::NoBrush);
+    drawLinePlot(&painter, lines);
+}
+
+void TraceGraph::draw(QCPPainter *painter)
+{
+    // Exports need real vector output, so never composite images there
+    const bool exporting = painter->modes().testFlag(QCPPainter::pmVectorized)
+                           || painter->modes().testFlag(QCPPainter::pmNoCaching);
+
+    if (m_rasterizer && !exporting)
+    {
+        if (const QImage *image = m_rasterizer->imageFor(this))
+        {
+            painter->drawImage(clipRect().topLeft(), *image);
+            return;
+        }
+    }
+
+    QCPGraph::draw(painter);
+}
+
+TraceRasterizer::TraceRasterizer(QCustomPlot *plot) : QObject(plot), m_plot(plot)
+{
+    connect(m_plot, &QCustomPlot::beforeReplot, this, &TraceRasterizer::beginFrame);
+    connect(m_plot, &QCustomPlot::afterReplot, this, &TraceRasterizer::endFrame);
+}
+
+void TraceRasterizer::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    if (!enabled)
+    {
+        // Free the per-graph buffers, they are rebuilt on demand
+        m_images.clear();
+        m_rendered.clear();
+    }
+}
+
+const QImage *TraceRasterizer::imageFor(const TraceGraph *graph)
+{
+    if (!m_enabled || !m_inReplot)
+        return nullptr;
+
+    // The first graph drawn in a replot renders all channels at once
+    if (!m_frameRendered)
+    {
+        m_frameRendered = true;
+        renderFrame();
+    }
+
+    if (!m_rendered.contains(graph))
+        return nullptr;
+    return &m_images[graph];
+}
+
+void TraceRasterizer::beginFrame(void)
+{
+    m_inReplot = true;
+    m_frameRendered = false;
+    m_rendered.clear();
+}
+
+void TraceRasterizer::endFrame(void)
+{
+    m_inReplot = false;
+    m_rendered.clear();
+}
+
+void TraceRasterizer::renderFrame(void)
+{
+    QList<TraceGraph*> graphs;
+    for (int i = 0; i < m_plot->graphCount(); ++i)
+    {
+        TraceGraph *graph = qobject_cast<TraceGraph*>(m_plot->graph(i));
+        if (graph && graph->rasterizer() == this && graph->realVisibility() && graph->isRasterEligible())
+        {
+            graphs.append(graph);
+        }
+    }
+
+    // Not worth the thread hand-off for a single channel
+    if (graphs.size() < m_minParallelGraphs)
+        return;
+
+    // Keep buffers of current graphs only and resize them before any worker starts,
+    // so the hash is not modified while images are being written
+    const double ratio = m_plot->bufferDevicePixelRatio();
+    QHash<const TraceGraph*, QImage> images;
+    for (TraceGraph *graph : graphs)
+    {
+        QImage image = m_images.take(graph);
+        const QSize size = graph->keyAxis()->axisRect()->rect().size() * ratio;
+        if (image.size() != size || image.devicePixelRatio() != ratio)
+        {
+            image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+            image.setDevicePixelRatio(ratio);
+        }
+        images.insert(graph, image);
+    }
+    m_images.swap(images);
+
+    struct RasterJob
+    {
+        const TraceGraph *graph;
+        QImage *image;
+    };
+
+    QVector<RasterJob> jobs;
+    jobs.reserve(graphs.size());
+    for (TraceGraph *graph : graphs)
+    {
+        jobs.append({graph, &m_images[graph]});
+    }
+
+    // The GUI thread waits here, so graph data and axes are not modified while workers read them
+    QtConcurrent::blockingMap(jobs, [](RasterJob &job) {
+        job.graph->rasterize(*job.image);
+    });
+
+    for (TraceGraph *graph : graphs)
+    {
+        m_rendered.insert(graph);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TRACERASTERIZER_H
+#define TRACERASTERIZER_H
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QPointer>
+#include <QSet>
+#include "qcustomplot.h"
+
+class TraceRasterizer;
+
+/**
+ * @brief QCPGraph that can have its line rasterised off the GUI thread.
+ *
+ * When attached to an enabled TraceRasterizer, the first TraceGraph drawn in a
+ * replot asks the rasterizer to render every eligible channel in parallel into
+ * its own QImage. Each graph then only composites its image in draw(). Graphs
+ * that use features the raster path does not handle (selection, scatters,
+ * fills, step styles) and vectorised exports fall back to QCPGraph::draw.
+ */
+class TraceGraph : public QCPGraph
+{
+    Q_OBJECT
+
+public:
+    explicit TraceGraph(QCPAxis *keyAxis, QCPAxis *valueAxis, TraceRasterizer *rasterizer = nullptr);
+
+    void setRasterizer(TraceRasterizer *rasterizer) { m_rasterizer = rasterizer; }
+    TraceRasterizer *rasterizer() const { return m_rasterizer.data(); }
+
+    // True if the line of this graph can be rendered by the raster path
+    bool isRasterEligible(void) const;
+
+    // Renders the line of this graph into image (sized to the axis rect). Safe to call from a worker thread
+    void rasterize(QImage &image) const;
+
+protected:
+    void draw(QCPPainter *painter) override;
+
+private:
+    QPointer<TraceRasterizer> m_rasterizer;
+};
+
+/**
+ * @brief Renders the channel traces of a QCustomPlot on a worker pool.
+ *
+ * The rasterizer only produces images while a replot is in progress (between
+ * beforeReplot and afterReplot), so layer-only redraws never pick up stale
+ * images. Per-graph images are kept between frames and only reallocated when
+ * the axis rect or device pixel ratio changes.
+ */
+class TraceRasterizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TraceRasterizer(QCustomPlot *plot);
+
+    void setEnabled(bool enabled);
+    bool isEnabled(void) const { return m_enabled; }
+
+    // Minimum number of eligible graphs before work is spread over the pool
+    void setMinParallelGraphs(int count) { m_minParallelGraphs = qMax(1, count); }
+
+    // Returns the rendered image of graph for the current replot, or nullptr to use the serial path
+    const QImage *imageFor(const TraceGraph *graph);
+
+private slots:
+    void beginFrame(void);
+    void endFrame(void);
+
+private:
+    void renderFrame(void);
+
+    QCustomPlot *m_plot;
+    bool m_enabled = true;
+    bool m_inReplot = false;
+    bool m_frameRendered = false;
+    int m_minParallelGraphs = 2;
+    QHash<const TraceGraph*, QImage> m_images; // Reused between frames
+    QSet<const TraceGraph*> m_rendered; // Graphs with a valid image in the current replot
+};
+
+#endif // TRACERASTERIZER_H